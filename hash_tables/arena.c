@@ -0,0 +1,154 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file implements a bump allocator. Allocations are carved from the
+ * current chunk by moving an offset forward, and a new chunk is started when
+ * the current one is full. Individual allocations are never freed, cleaning
+ * up the arena releases all chunks at once.
+ */
+
+#include <stdalign.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+struct chunk {
+    /* Chunk that was filled before this one */
+    struct chunk *prev;
+    /* Number of usable bytes in data */
+    size_t size;
+    /* Number of bytes handed out from data */
+    size_t used;
+    /* The memory itself, aligned for any type */
+    max_align_t data[];
+};
+
+struct arena {
+    /* Chunk that allocations are currently taken from */
+    struct chunk *current;
+    /* Size of a regular chunk */
+    size_t chunk_size;
+    /* Total number of bytes handed out */
+    size_t used;
+};
+
+/* Round size up to a multiple of the strictest alignment. */
+static size_t align_up(size_t size) {
+    size_t align = alignof(max_align_t);
+    return (size + align - 1) / align * align;
+}
+
+/*
+ * Allocate a new chunk with at least size usable bytes.
+ *
+ * Returns a pointer to the chunk, or NULL on failure.
+ */
+static struct chunk *chunk_init(size_t size) {
+    struct chunk *c = malloc(sizeof(struct chunk) + size);
+    if (c == NULL) {
+        return NULL;
+    }
+    c->prev = NULL;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+/*
+ * Initialize an arena.
+ *
+ * chunk_size: Number of bytes in each chunk.
+ *
+ * Returns a pointer to the arena, or NULL on failure.
+ */
+struct arena *arena_init(size_t chunk_size) {
+    if (chunk_size == 0) {
+        return NULL;
+    }
+
+    struct arena *a = malloc(sizeof(struct arena));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->chunk_size = align_up(chunk_size);
+    a->current = chunk_init(a->chunk_size);
+    if (a->current == NULL) {
+        free(a);
+        return NULL;
+    }
+    a->used = 0;
+    return a;
+}
+
+/*
+ * Allocate memory from the arena. A request that does not fit the current
+ * chunk starts a new one. Oversized requests get their own chunk, which is
+ * put behind the current chunk so its free space is not lost.
+ *
+ * a: The arena.
+ * size: Number of bytes needed.
+ *
+ * Returns a pointer to the memory, or NULL on failure.
+ */
+void *arena_alloc(struct arena *a, size_t size) {
+    if (a == NULL) {
+        return NULL;
+    }
+    size = align_up(size);
+
+    struct chunk *c = a->current;
+    if (size > c->size - c->used) {
+        if (size > a->chunk_size / 4) {
+            struct chunk *big = chunk_init(size);
+            if (big == NULL) {
+                return NULL;
+            }
+            big->used = size;
+            big->prev = c->prev;
+            c->prev = big;
+            a->used += size;
+            return big->data;
+        }
+
+        c = chunk_init(a->chunk_size);
+        if (c == NULL) {
+            return NULL;
+        }
+        c->prev = a->current;
+        a->current = c;
+    }
+
+    void *mem = (char *)c->data + c->used;
+    c->used += size;
+    a->used += size;
+    return mem;
+}
+
+/*
+ * Returns the number of bytes handed out by the arena, including padding.
+ */
+size_t arena_used(const struct arena *a) {
+    if (a == NULL) {
+        return 0;
+    }
+    return a->used;
+}
+
+/*
+ * Free all chunks of the arena and the arena itself.
+ */
+void arena_cleanup(struct arena *a) {
+    if (a == NULL) {
+        return;
+    }
+
+    struct chunk *c = a->current;
+    while (c != NULL) {
+        struct chunk *prev = c->prev;
+        free(c);
+        c = prev;
+    }
+    free(a);
+}
@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Bump allocator. Memory is carved from large chunks and can only be given
+ * back all at once by cleaning up the arena. */
+
+/* Handle to the arena. */
+struct arena;
+
+/* Initialise an arena that allocates chunks of chunk_size bytes.
+ * Returns NULL on failure. */
+struct arena *arena_init(size_t chunk_size);
+
+/* Returns size bytes of memory aligned for any type, or NULL on failure.
+ * Requests larger than the chunk size get a chunk of their own. */
+void *arena_alloc(struct arena *a, size_t size);
+
+/* Returns the number of bytes allocated from the arena so far. */
+size_t arena_used(const struct arena *a);
+
+/* Frees all memory handed out by the arena, and the arena itself. */
+void arena_cleanup(struct arena *a);
+
+#endif /* ARENA_H */
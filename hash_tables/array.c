@@ -5,18 +5,130 @@
  * Description:
  * This file implements a dynamic array data structure for storing integers.
  * The array supports initialization, cleanup, element retrieval and appending 
- * elements. The array dynamically resizes as needed.
+ * elements. The array dynamically resizes as needed. The first few elements
+ * are stored inside the struct itself, so short arrays need no separate data
+ * block. Arrays can also live in an arena, in which case they are released
+ * together with the arena, or be embedded in a block of the caller.
+ * Compressed arrays hold a strictly increasing sequence, such as the line
+ * numbers of a word. They store the gaps between the values as varints:
+ * 7 bits per byte, with the high bit set on all but the last byte of a gap.
+ * An array can be written out as an image, a small header followed by its
+ * data, and a read-only view array can use such an image in place.
+ * Sorted arrays can be intersected, which answers queries for the lines that
+ * contain several words.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
-#include "array.h"
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "arena.h"
+#include "array_ext.h"
+
+/* Number of elements stored in the struct before the data spills to a
+ * separate block. */
+#define ARRAY_INLINE 4
+
+/* Number of elements array_intersect compares at once instead of halving
+ * the search range further. */
+#define SCAN_BLOCK 16
+
+/* Header of an array image, followed by n_bytes of data. */
+struct array_image {
+    uint32_t used;
+    uint32_t n_bytes;
+    int32_t last;
+    uint32_t compressed;
+};
 
 struct array {
+    /* Either the inline storage or a separate block */
     int *data;
-    size_t used;
-    size_t capacity;
+    uint32_t used;
+    /* Number of ints that fit in data */
+    uint32_t capacity;
+    /* Arena the struct and data come from, NULL if they are malloc'ed */
+    struct arena *arena;
+    /* Set if the struct lives in memory of the caller and must not be freed */
+    unsigned int embedded : 1;
+    /* Set if data holds varint encoded gaps instead of the values */
+    unsigned int compressed : 1;
+    /* Set if data is an image owned by someone else, which must not change */
+    unsigned int read_only : 1;
+    union {
+        /* Storage for the first elements of a regular array */
+        int small[ARRAY_INLINE];
+        /* A compressed array keeps its bookkeeping in the place of the first
+         * two inline elements */
+        struct {
+            /* Number of bytes of data in use */
+            uint32_t n_bytes;
+            /* Last value appended */
+            int last;
+            int small[ARRAY_INLINE - 2];
+        } packed;
+    };
 };
 
+/* 
+ * Return whether the data of an array is its inline storage.
+ */
+static int data_is_inline(const struct array *a) {
+    return a->data == (a->compressed ? a->packed.small : a->small);
+}
+
+/* 
+ * Return the number of bytes of the data of an array.
+ */
+static size_t data_size(const struct array *a) {
+    return a->compressed ? a->packed.n_bytes : a->used * sizeof(int);
+}
+
+/* 
+ * Set up the fields of a new array and allocate its data if it does not fit
+ * in the inline storage.
+ * Returns 0 on success, 1 on failure.
+ */
+static int array_setup(struct array *a, unsigned long initial_capacity,
+                       struct arena *arena, int embedded, int compressed) {
+    a->used = 0;
+    a->arena = arena;
+    a->embedded = embedded != 0;
+    a->compressed = compressed != 0;
+    a->read_only = 0;
+
+    if (compressed) {
+        a->packed.n_bytes = 0;
+        a->packed.last = 0;
+        a->data = a->packed.small;
+        a->capacity = ARRAY_INLINE - 2;
+        return 0;
+    }
+    if (initial_capacity <= ARRAY_INLINE) {
+        a->data = a->small;
+        a->capacity = ARRAY_INLINE;
+        return 0;
+    }
+    if (initial_capacity > UINT32_MAX) {
+        return 1;
+    }
+
+    if (arena != NULL) {
+        a->data = arena_alloc(arena, initial_capacity * sizeof(int));
+    } else {
+        a->data = malloc(initial_capacity * sizeof(int));
+    }
+    if (a->data == NULL) {
+        return 1;
+    }
+    a->capacity = (uint32_t)initial_capacity;
+    return 0;
+}
+
 /* 
  * Initialize a dynamic array.
  * -initial_capacity: The initial capacity of the array.
@@ -28,26 +140,77 @@ struct array *array_init(unsigned long initial_capacity) {
         return NULL;
     }
 
-    a->data = malloc(initial_capacity * sizeof(int));
-    if (a->data == NULL) {
+    if (array_setup(a, initial_capacity, NULL, 0, 0) != 0) {
         free(a);
         return NULL;
     }
+    return a;
+}
 
-    a->capacity = initial_capacity;
-    a->used = 0;
+/* 
+ * Initialize a dynamic array that is allocated from an arena.
+ * -arena: The arena to allocate the array and its data from.
+ * -initial_capacity: The initial capacity of the array.
+ * Returns a pointer to the initialized array, or NULL.
+ */
+struct array *array_init_arena(struct arena *arena, unsigned long initial_capacity) {
+    struct array *a = arena_alloc(arena, sizeof(struct array));
+    if (a == NULL) {
+        return NULL;
+    }
+
+    if (array_setup(a, initial_capacity, arena, 0, 0) != 0) {
+        return NULL;
+    }
+    return a;
+}
+
+/* 
+ * Return the number of bytes needed to embed an array in another block.
+ */
+size_t array_footprint(void) {
+    return sizeof(struct array);
+}
+
+/* 
+ * Initialize an empty array in memory provided by the caller.
+ * -mem: array_footprint() bytes, aligned for any type.
+ * -arena: Arena to allocate spilled data from, or NULL to use malloc.
+ * -compressed: 1 for a compressed array, 0 for a regular one.
+ * Returns a pointer to the initialized array.
+ */
+struct array *array_init_at(void *mem, struct arena *arena, int compressed) {
+    struct array *a = mem;
+    array_setup(a, ARRAY_INLINE, arena, 1, compressed);
+    return a;
+}
+
+/* 
+ * Initialize an empty compressed array.
+ * Returns a pointer to the initialized array, or NULL.
+ */
+struct array *array_init_compressed(void) {
+    struct array *a = malloc(sizeof(struct array));
+    if (a != NULL) {
+        array_setup(a, ARRAY_INLINE, NULL, 0, 1);
+    }
     return a;
 }
 
 /* 
- * Free the memory of a dynamic array.
+ * Free the memory of a dynamic array. Arrays from an arena are freed with it,
+ * for embedded arrays only spilled data is freed.
  */
 void array_cleanup(struct array *a) {
-    if (a == NULL) {
+    if (a == NULL || a->arena != NULL) {
         return;
     }
-    free(a->data);
-    free(a);
+    if (!data_is_inline(a) && !a->read_only) {
+        free(a->data);
+    }
+    if (!a->embedded) {
+        free(a);
+    }
 }
 
 /* 
@@ -62,7 +225,94 @@ int array_get(const struct array *a, unsigned long index) {
     if (a == NULL || index >= a->used) {
         return -1;
     }
-    return a->data[index];
+    if (!a->compressed) {
+        return a->data[index];
+    }
+
+    struct array_cursor c;
+    int elem = -1;
+    array_cursor_init(&c, a);
+    for (unsigned long i = 0; i <= index; i++) {
+        array_cursor_next(&c, &elem);
+    }
+    return elem;
+}
+
+/* 
+ * Retrieve the last element of the array.
+ * 
+ * a: The array to access.
+ * 
+ * Returns the last element, or -1 if the array is empty.
+ */
+int array_last(const struct array *a) {
+    if (a == NULL || a->used == 0) {
+        return -1;
+    }
+    return a->compressed ? a->packed.last : a->data[a->used - 1];
+}
+
+/* 
+ * Double the capacity of the data block. Inline and arena data is copied to
+ * a new block, heap data is reallocated.
+ * 
+ * Returns 0 if successful, 1 if not.
+ */
+static int array_grow(struct array *a) {
+    size_t new_capacity = (size_t)a->capacity * 2;
+    size_t in_use = data_size(a);
+    int *new_data;
+
+    if (new_capacity > UINT32_MAX) {
+        return 1;
+    }
+    if (a->arena != NULL || data_is_inline(a)) {
+        if (a->arena != NULL) {
+            new_data = arena_alloc(a->arena, new_capacity * sizeof(int));
+        } else {
+            new_data = malloc(new_capacity * sizeof(int));
+        }
+        if (new_data != NULL) {
+            memcpy(new_data, a->data, in_use);
+        }
+    } else {
+        new_data = realloc(a->data, new_capacity * sizeof(int));
+    }
+    if (new_data == NULL) {
+        return 1;
+    }
+    a->data = new_data;
+    a->capacity = (uint32_t)new_capacity;
+    return 0;
+}
+
+/* 
+ * Append an element to a compressed array by encoding its gap with the
+ * previous element. A varint of an int takes at most 5 bytes.
+ * 
+ * Returns 0 if the operation is successful, 1 if not.
+ */
+static int append_compressed(struct array *a, int elem) {
+    if (elem < 0 || (a->used > 0 && elem <= a->packed.last)) {
+        return 1;
+    }
+    while (a->packed.n_bytes + 5 > a->capacity * sizeof(int)) {
+        if (array_grow(a) != 0) {
+            return 1;
+        }
+    }
+
+    unsigned char *bytes = (unsigned char *)a->data;
+    unsigned int gap = (unsigned int)(a->used > 0 ? elem - a->packed.last : elem);
+    while (gap >= 0x80) {
+        bytes[a->packed.n_bytes++] = (unsigned char)(gap | 0x80);
+        gap >>= 7;
+    }
+    bytes[a->packed.n_bytes++] = (unsigned char)gap;
+
+    a->packed.last = elem;
+    a->used++;
+    return 0;
 }
 
 /* 
@@ -74,18 +324,20 @@ int array_get(const struct array *a, unsigned long index) {
  * Returns 0 if the operation is successful, 1 if not.
  */
 int array_append(struct array *a, int elem) {
-    if (a == NULL) {
+    if (a == NULL || a->read_only) {
         return 1;
     }
+    if (a->compressed) {
+        return append_compressed(a, elem);
+    }
 
+    if (a->used == UINT32_MAX) {
+        return 1;
+    }
     if (a->used >= a->capacity) {
-        size_t new_capacity = a->capacity * 2;
-        int *new_data = realloc(a->data, new_capacity * sizeof(int));
-        if (new_data == NULL) {
+        if (array_grow(a) != 0) {
             return 1;
         }
-        a->data = new_data;
-        a->capacity = new_capacity;
     }
 
     a->data[a->used] = elem;
@@ -108,3 +360,334 @@ unsigned long array_size(const struct array *a) {
 
     return a->used;
 }
+
+/* 
+ * Return the number of bytes of the element data outside the struct.
+ */
+size_t array_memory(const struct array *a) {
+    if (a->read_only) {
+        return data_size(a);
+    }
+    if (data_is_inline(a)) {
+        return 0;
+    }
+    return a->capacity * sizeof(int);
+}
+
+/* 
+ * Return the number of bytes array_image_write writes for an array.
+ */
+size_t array_image_size(const struct array *a) {
+    return sizeof(struct array_image) + data_size(a);
+}
+
+/* 
+ * Write the image of an array: a header with the element count, the number
+ * of data bytes, the last element and whether the data is compressed,
+ * followed by the data as it is stored in the array.
+ * 
+ * a: The array.
+ * dst: array_image_size(a) bytes, aligned to 4 bytes.
+ */
+void array_image_write(const struct array *a, void *dst) {
+    struct array_image header;
+    header.used = a->used;
+    header.n_bytes = (uint32_t)data_size(a);
+    header.last = a->used > 0 ? array_last(a) : 0;
+    header.compressed = (uint32_t)a->compressed;
+
+    memcpy(dst, &header, sizeof(header));
+    memcpy((unsigned char *)dst + sizeof(header), a->data, header.n_bytes);
+}
+
+/* 
+ * Check that size bytes hold a complete image: the data fits, a regular
+ * array has 4 bytes per element and the gaps of a compressed array decode to
+ * exactly its data, with strictly increasing values that end at its last
+ * value.
+ * 
+ * Returns 0 if the image is valid, 1 otherwise.
+ */
+int array_image_check(const void *image, size_t size) {
+    struct array_image header;
+    if (size < sizeof(header)) {
+        return 1;
+    }
+    memcpy(&header, image, sizeof(header));
+    if (header.n_bytes > size - sizeof(header) || header.compressed > 1) {
+        return 1;
+    }
+    if (!header.compressed) {
+        return header.n_bytes != (uint64_t)header.used * sizeof(int);
+    }
+
+    const unsigned char *bytes = (const unsigned char *)image + sizeof(header);
+    size_t offset = 0;
+    int64_t last = -1;
+    for (uint32_t i = 0; i < header.used; i++) {
+        uint64_t gap = 0;
+        unsigned int shift = 0;
+        unsigned char byte;
+        do {
+            if (offset == header.n_bytes || shift > 28) {
+                return 1;
+            }
+            byte = bytes[offset++];
+            gap |= (uint64_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        int64_t value = i == 0 ? (int64_t)gap : last + (int64_t)gap;
+        if ((i > 0 && gap == 0) || value > INT32_MAX) {
+            return 1;
+        }
+        last = value;
+    }
+    return offset != header.n_bytes || (header.used > 0 && last != header.last);
+}
+
+/* 
+ * Initialize a read-only array in memory of the caller that uses an image in
+ * place. The image has to stay valid as long as the view is used, cleaning
+ * up the view does nothing.
+ * 
+ * mem: array_footprint() bytes, aligned for any type.
+ * image: An image written by array_image_write, aligned to 4 bytes.
+ * 
+ * Returns a pointer to the view.
+ */
+struct array *array_view_at(void *mem, const void *image) {
+    struct array *a = mem;
+    struct array_image header;
+    memcpy(&header, image, sizeof(header));
+    array_setup(a, 0, NULL, 1, header.compressed != 0);
+    /* The data is never written through a read-only array. */
+    a->data = (int *)(uintptr_t)((const unsigned char *)image + sizeof(header));
+    a->used = header.used;
+    a->capacity = header.compressed ? (uint32_t)(header.n_bytes / sizeof(int)) : header.used;
+    a->read_only = 1;
+    if (header.compressed) {
+        a->packed.n_bytes = header.n_bytes;
+        a->packed.last = header.last;
+    }
+    return a;
+}
+
+/* 
+ * Create a read-only array that uses an image in place. The image has to
+ * stay valid until the view is cleaned up, which only frees the struct.
+ * 
+ * image: An image written by array_image_write, aligned to 4 bytes.
+ * 
+ * Returns a pointer to the view, or NULL on failure.
+ */
+struct array *array_view(const void *image) {
+    void *mem = malloc(sizeof(struct array));
+    if (mem == NULL) {
+        return NULL;
+    }
+
+    struct array *a = array_view_at(mem, image);
+    a->embedded = 0;
+    return a;
+}
+
+/* 
+ * Start iterating over the elements of an array.
+ * 
+ * c: The cursor to set up.
+ * a: The array to iterate over, which must not change during iteration.
+ */
+void array_cursor_init(struct array_cursor *c, const struct array *a) {
+    c->a = a;
+    c->index = 0;
+    c->offset = 0;
+    c->last = 0;
+}
+
+/* 
+ * Read the next element of the array. Compressed arrays are decoded one gap
+ * at a time, so a full iteration is linear in their size.
+ * 
+ * c: The cursor.
+ * elem: Set to the next element.
+ * 
+ * Returns 1 if an element was read, 0 at the end of the array.
+ */
+int array_cursor_next(struct array_cursor *c, int *elem) {
+    const struct array *a = c->a;
+    if (a == NULL || c->index >= a->used) {
+        return 0;
+    }
+
+    if (!a->compressed) {
+        *elem = a->data[c->index++];
+        return 1;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)a->data;
+    unsigned int gap = 0;
+    unsigned int shift = 0;
+    unsigned char byte;
+    do {
+        byte = bytes[c->offset++];
+        gap |= (unsigned int)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    c->last = c->index == 0 ? (int)gap : c->last + (int)gap;
+    c->index++;
+    *elem = c->last;
+    return 1;
+}
+
+/* 
+ * Count the elements of a sorted block that are smaller than target, four at
+ * a time with SSE2.
+ * 
+ * Returns the number of elements smaller than target.
+ */
+static size_t count_less(const int *data, size_t n, int target) {
+    size_t count = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i t = _mm_set1_epi32(target);
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, t)));
+        count += (size_t)__builtin_popcount((unsigned int)mask);
+    }
+#endif
+    for (; i < n; i++) {
+        count += data[i] < target;
+    }
+    return count;
+}
+
+/* 
+ * Find the first element of a sorted array that is not smaller than target,
+ * starting at lo. The distance is doubled until it passes target, then the
+ * range is halved down to SCAN_BLOCK elements, which are counted at once.
+ * 
+ * Returns the index of that element, or n if there is none.
+ */
+static size_t gallop(const int *data, size_t n, size_t lo, int target) {
+    size_t hi = lo;
+    size_t step = 1;
+    while (hi < n && data[hi] < target) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    hi = hi < n ? hi : n;
+
+    while (hi - lo > SCAN_BLOCK) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (data[mid] < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo + count_less(data + lo, hi - lo, target);
+}
+
+/* 
+ * Keep the candidates that occur in a, which is sorted. Arrays with plain
+ * data are searched by galloping, compressed arrays can only be decoded in
+ * order and are merged with the candidates instead.
+ * 
+ * Returns the number of candidates kept, at the start of cand.
+ */
+static size_t keep_common(int *cand, size_t n, const struct array *a) {
+    size_t kept = 0;
+
+    if (!a->compressed) {
+        size_t pos = 0;
+        for (size_t i = 0; i < n; i++) {
+            pos = gallop(a->data, a->used, pos, cand[i]);
+            if (pos == a->used) {
+                break;
+            }
+            if (a->data[pos] == cand[i]) {
+                cand[kept++] = cand[i];
+            }
+        }
+        return kept;
+    }
+
+    struct array_cursor c;
+    int elem = 0;
+    int more;
+    array_cursor_init(&c, a);
+    more = array_cursor_next(&c, &elem);
+    for (size_t i = 0; i < n && more; i++) {
+        while (more && elem < cand[i]) {
+            more = array_cursor_next(&c, &elem);
+        }
+        if (more && elem == cand[i]) {
+            cand[kept++] = cand[i];
+        }
+    }
+    return kept;
+}
+
+/* 
+ * Intersect sorted arrays. The smallest array gives the candidates, which
+ * are then checked against the other arrays from small to large, so the
+ * candidates only shrink and the large arrays are mostly skipped.
+ * 
+ * arrays: The arrays, each sorted in ascending order.
+ * n: Number of arrays, at least 1.
+ * 
+ * Returns a new array with the values that are in all arrays, in ascending
+ * order and each only once, or NULL on failure.
+ */
+struct array *array_intersect(const struct array *const arrays[], size_t n) {
+    if (arrays == NULL || n == 0) {
+        return NULL;
+    }
+
+    const struct array **sorted = malloc(n * sizeof(const struct array *));
+    if (sorted == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        size_t j = i;
+        for (; j > 0 && sorted[j - 1]->used > arrays[i]->used; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = arrays[i];
+    }
+
+    /* The candidates are the distinct values of the smallest array. */
+    int *cand = malloc((sorted[0]->used > 0 ? sorted[0]->used : 1) * sizeof(int));
+    size_t n_cand = 0;
+    if (cand == NULL) {
+        free(sorted);
+        return NULL;
+    }
+    struct array_cursor c;
+    int elem;
+    array_cursor_init(&c, sorted[0]);
+    while (array_cursor_next(&c, &elem)) {
+        if (n_cand == 0 || cand[n_cand - 1] != elem) {
+            cand[n_cand++] = elem;
+        }
+    }
+
+    for (size_t i = 1; i < n && n_cand > 0; i++) {
+        n_cand = keep_common(cand, n_cand, sorted[i]);
+    }
+    free(sorted);
+
+    struct array *result = array_init(n_cand);
+    for (size_t i = 0; result != NULL && i < n_cand; i++) {
+        if (array_append(result, cand[i]) != 0) {
+            array_cleanup(result);
+            result = NULL;
+        }
+    }
+    free(cand);
+    return result;
+}
@@ -0,0 +1,96 @@
+#ifndef ARRAY_EXT_H
+#define ARRAY_EXT_H
+
+/* Extensions to the resizing array interface. array.h itself is kept as
+ * handed out, these functions work on the same struct array handle. */
+
+#include <stddef.h>
+
+#include "array.h"
+
+struct arena;
+
+/* Initialise an array whose struct and data are allocated from arena.
+ * Growing takes a new block from the arena, the old block is only released
+ * together with the arena. array_cleanup does nothing for these arrays.
+ * Return NULL on failure. */
+struct array *array_init_arena(struct arena *arena, unsigned long initial_capacity);
+
+/* Return the number of bytes an array needs when it is embedded in a larger
+ * block with array_init_at. */
+size_t array_footprint(void);
+
+/* Initialise an empty array in mem, which must be array_footprint() bytes and
+ * aligned for any type. The first elements are stored in mem itself, when the
+ * array grows beyond that its data spills to the arena, or to the heap if
+ * arena is NULL. array_cleanup then only frees the spilled data. If compressed
+ * is 1 the array is compressed as with array_init_compressed. */
+struct array *array_init_at(void *mem, struct arena *arena, int compressed);
+
+/* Initialise an empty compressed array. It only accepts a strictly increasing
+ * sequence of non-negative integers, such as line numbers, and stores the gaps
+ * between them as varints. array_append returns 1 for any other value.
+ * array_get has to decode from the start, iterate with a cursor instead.
+ * Return NULL on failure. */
+struct array *array_init_compressed(void);
+
+/* Return the last element of the array, or -1 if the array is empty. Unlike
+ * array_get this does not need to decode a compressed array. */
+int array_last(const struct array *a);
+
+/* Return the number of bytes of element data a holds outside its struct: the
+ * allocated data block, 0 while the elements fit in the struct, or for views
+ * the data of their image. Blocks an arena array grew out of are not counted,
+ * they are only released with the arena. */
+size_t array_memory(const struct array *a);
+
+/* Return the number of bytes of the image of a, see array_image_write. */
+size_t array_image_size(const struct array *a);
+
+/* Write an image of a to dst, which must have room for array_image_size(a)
+ * bytes and be aligned to 4 bytes. The image holds the data as stored in the
+ * array, so compressed arrays stay compressed, and it can be used in place by
+ * array_view, also after storing it in a file and mapping that back. */
+void array_image_write(const struct array *a, void *dst);
+
+/* Create a read-only array that reads its elements straight from an image
+ * written by array_image_write. The image must stay valid as long as the
+ * array is used. array_append fails on the view and array_cleanup only frees
+ * the view itself. Return NULL on failure. */
+struct array *array_view(const void *image);
+
+/* Initialise a view like array_view in mem, which must be array_footprint()
+ * bytes and aligned for any type. array_cleanup does nothing for it, so many
+ * views can share one block. Return a pointer to the view. */
+struct array *array_view_at(void *mem, const void *image);
+
+/* Check that the size bytes at image, aligned to 4 bytes, hold a complete and
+ * consistent image, so an image from an untrusted file can be viewed without
+ * reading outside of it. Return 0 if it is valid and 1 otherwise. */
+int array_image_check(const void *image, size_t size);
+
+/* Cursor for iterating over the elements of any array. The fields are only
+ * public so cursors can live on the stack. */
+struct array_cursor {
+    const struct array *a;
+    unsigned long index;
+    size_t offset;
+    int last;
+};
+
+/* Start iterating over the elements of a, which must not be changed while
+ * the cursor is used. */
+void array_cursor_init(struct array_cursor *c, const struct array *a);
+
+/* Store the next element of the array in elem. Return 1 if there was one and
+ * 0 at the end of the array. */
+int array_cursor_next(struct array_cursor *c, int *elem);
+
+/* Return a new array with the values that occur in all n arrays, which must
+ * each be sorted in ascending order, such as the line numbers of words. The
+ * values are in ascending order and each appears only once. The intersection
+ * starts from the smallest array and searches the others by galloping, or
+ * merges them for compressed arrays. Return NULL on failure or if n is 0. */
+struct array *array_intersect(const struct array *const arrays[], size_t n);
+
+#endif /* ARRAY_EXT_H */
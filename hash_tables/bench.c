@@ -0,0 +1,355 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file is a micro-benchmark for the hash table. For every combination of
+ * start size, maximum load factor and hash function it builds a fresh table
+ * a number of times and measures four operations separately: inserting new
+ * keys, looking up present keys, looking up absent keys and deleting keys.
+ * The first repetitions are warmups and are not recorded. Every phase is
+ * timed in batches of BATCH_OPS operations on the monotonic clock. Even
+ * batches are timed as a whole, so the clock itself costs a fraction of a
+ * nanosecond per operation, and the nanoseconds per operation of these
+ * batches form the distribution the median is taken from. Averaging a slow
+ * operation with the rest of its batch would hide it, so odd batches time
+ * every operation on its own, minus the measured cost of reading the clock,
+ * and the 99th percentile is taken from those single operations. The mean
+ * covers all operations.
+ * Lookups and deletes visit the keys in a new random order every repetition.
+ * The results are written to stdout as CSV, one line per configuration and
+ * operation.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+/* Number of operations timed together. */
+#define BATCH_OPS 64
+
+/* Letters that make a key unique, enough for 26^5 keys. */
+#define KEY_ID_LETTERS 5
+#define MAX_KEYS (26UL * 26 * 26 * 26 * 26)
+
+/* Maximum number of random letters after the unique part of a key. */
+#define KEY_MAX_EXTRA 8
+
+#define DEFAULT_KEYS 20000
+#define DEFAULT_REPS 11
+#define DEFAULT_WARMUPS 2
+
+#define START_TESTS 2
+#define MAX_TESTS 3
+#define HASH_TESTS 4
+
+/* The operations that are measured, in the order they run. */
+enum bench_op { OP_INSERT, OP_HIT, OP_MISS, OP_DELETE, N_OPS };
+
+static const char *op_names[N_OPS] = { "insert", "hit", "miss", "delete" };
+
+/* Samples of one operation: nanoseconds per operation of the batches timed
+ * as a whole, and nanoseconds of the single operations timed on their own. */
+struct samples {
+    double *ns;
+    size_t n;
+    double *op_ns;
+    size_t n_ops;
+};
+
+/* Nanoseconds a pair of clock readings takes, subtracted from the time of
+ * a single operation. */
+static double clock_overhead;
+
+/* Keeps the compiler from dropping lookups whose result is not used. */
+static volatile unsigned long sink;
+
+/* Return the time on the monotonic clock in nanoseconds. */
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Return the next number of a xorshift64 generator. */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/*
+ * Create the keys: id in base 26 with KEY_ID_LETTERS letters, which makes
+ * every key unique, followed by up to KEY_MAX_EXTRA random letters.
+ *
+ * Returns an array of n keys, or NULL on failure.
+ */
+static char **make_keys(size_t first_id, size_t n, uint64_t *state) {
+    char **keys = malloc(n * sizeof(char *));
+    if (keys == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = malloc(KEY_ID_LETTERS + KEY_MAX_EXTRA + 1);
+        if (keys[i] == NULL) {
+            for (size_t j = 0; j < i; j++) {
+                free(keys[j]);
+            }
+            free(keys);
+            return NULL;
+        }
+        size_t id = first_id + i;
+        for (int c = 0; c < KEY_ID_LETTERS; c++) {
+            keys[i][c] = (char)('a' + id % 26);
+            id /= 26;
+        }
+        size_t extra = (size_t)(next_random(state) % (KEY_MAX_EXTRA + 1));
+        for (size_t c = 0; c < extra; c++) {
+            keys[i][KEY_ID_LETTERS + c] = (char)('a' + next_random(state) % 26);
+        }
+        keys[i][KEY_ID_LETTERS + extra] = '\0';
+    }
+    return keys;
+}
+
+/* Free keys made by make_keys. */
+static void free_keys(char **keys, size_t n) {
+    if (keys == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+}
+
+/* Put the keys in a random order. */
+static void shuffle(char **keys, size_t n, uint64_t *state) {
+    for (size_t i = n; i > 1; i--) {
+        size_t j = (size_t)(next_random(state) % i);
+        char *tmp = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = tmp;
+    }
+}
+
+/* Compare two doubles for qsort. */
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Measure clock_overhead: the median time between two clock readings that
+ * directly follow each other.
+ */
+static void measure_clock(void) {
+    double gaps[1001];
+    for (int i = 0; i < 1001; i++) {
+        double begin = now_ns();
+        gaps[i] = now_ns() - begin;
+    }
+    qsort(gaps, 1001, sizeof(double), compare_double);
+    clock_overhead = gaps[500];
+}
+
+/*
+ * Run one operation on one key.
+ *
+ * Returns 0 on success, 1 if an insert or delete failed.
+ */
+static int run_one(struct table *t, enum bench_op op, const char *key, int value) {
+    switch (op) {
+    case OP_INSERT:
+        return table_insert(t, key, value);
+    case OP_HIT:
+    case OP_MISS:
+        sink += table_lookup(t, key) != NULL;
+        return 0;
+    case OP_DELETE:
+        return table_delete(t, key) != 0;
+    case N_OPS:
+        break;
+    }
+    return 0;
+}
+
+/*
+ * Run one operation on all keys in batches, even batches timed as a whole
+ * and odd batches operation by operation. If record is set, the times are
+ * added to the samples and the time of all operations to total_ns.
+ *
+ * Returns 0 on success, 1 if an insert or delete failed.
+ */
+static int run_op(struct table *t, enum bench_op op, char **keys, size_t n,
+                  struct samples *s, double *total_ns, int record) {
+    for (size_t start = 0; start < n; start += BATCH_OPS) {
+        size_t count = n - start < BATCH_OPS ? n - start : BATCH_OPS;
+        int failed = 0;
+
+        if ((start / BATCH_OPS) % 2 == 0) {
+            double begin = now_ns();
+            for (size_t i = start; i < start + count; i++) {
+                failed |= run_one(t, op, keys[i], (int)i);
+            }
+            double end = now_ns();
+            if (record) {
+                s->ns[s->n++] = (end - begin) / (double)count;
+                *total_ns += end - begin;
+            }
+        } else {
+            for (size_t i = start; i < start + count; i++) {
+                double begin = now_ns();
+                failed |= run_one(t, op, keys[i], (int)i);
+                double ns = now_ns() - begin - clock_overhead;
+                if (record) {
+                    s->op_ns[s->n_ops++] = ns > 0 ? ns : 0;
+                    *total_ns += ns > 0 ? ns : 0;
+                }
+            }
+        }
+        if (failed) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Return the p-th percentile of n sorted samples, by the nearest rank. */
+static double percentile(const double *ns, size_t n, double p) {
+    size_t rank = (size_t)(p / 100.0 * (double)n + 0.999999);
+    rank = rank < 1 ? 1 : rank;
+    return ns[rank - 1];
+}
+
+/*
+ * Benchmark one configuration and print a CSV line per operation.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int bench_config(unsigned long start_size, double max_load,
+                        unsigned long (*hash_func)(const unsigned char *),
+                        const char *hash_name, char **hits, char **misses,
+                        size_t n, int reps, int warmups, uint64_t *state) {
+    size_t batches = (n + BATCH_OPS - 1) / BATCH_OPS;
+    struct samples samples[N_OPS];
+    double total_ns[N_OPS] = { 0 };
+    int failed = 0;
+
+    for (int op = 0; op < N_OPS; op++) {
+        samples[op].ns = malloc(batches * (size_t)reps * sizeof(double));
+        samples[op].n = 0;
+        samples[op].op_ns = malloc(n * (size_t)reps * sizeof(double));
+        samples[op].n_ops = 0;
+        failed |= samples[op].ns == NULL || samples[op].op_ns == NULL;
+    }
+
+    for (int rep = 0; rep < warmups + reps && !failed; rep++) {
+        int record = rep >= warmups;
+        struct table *t = table_init(start_size, max_load, hash_func);
+        if (t == NULL) {
+            failed = 1;
+            break;
+        }
+
+        for (int op = 0; op < N_OPS && !failed; op++) {
+            char **keys = op == OP_MISS ? misses : hits;
+            if (op != OP_INSERT) {
+                shuffle(keys, n, state);
+            }
+            failed = run_op(t, (enum bench_op)op, keys, n, &samples[op], &total_ns[op],
+                            record);
+        }
+        table_cleanup(t);
+    }
+
+    for (int op = 0; op < N_OPS && !failed; op++) {
+        struct samples *s = &samples[op];
+        qsort(s->ns, s->n, sizeof(double), compare_double);
+        /* With a single batch there are no single operation samples. */
+        if (s->n_ops > 0) {
+            qsort(s->op_ns, s->n_ops, sizeof(double), compare_double);
+        }
+        printf("%s,%lu,%.2f,%s,%zu,%d,%.2f,%.2f,%.2f,%.2f\n",
+               hash_name, start_size, max_load, op_names[op], n, reps,
+               percentile(s->ns, s->n, 50),
+               s->n_ops > 0 ? percentile(s->op_ns, s->n_ops, 99) : percentile(s->ns, s->n, 99),
+               total_ns[op] / ((double)n * reps), s->ns[0]);
+    }
+    fflush(stdout);
+
+    for (int op = 0; op < N_OPS; op++) {
+        free(samples[op].ns);
+        free(samples[op].op_ns);
+    }
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = DEFAULT_KEYS;
+    int reps = DEFAULT_REPS;
+    int warmups = DEFAULT_WARMUPS;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc && atol(argv[i + 1]) > 0
+            && (unsigned long)atol(argv[i + 1]) <= MAX_KEYS / 2) {
+            n = (size_t)atol(argv[++i]);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            reps = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-w") && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            warmups = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-n keys] [-r repetitions] [-w warmups]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Here you can edit the benchmarked configurations, like in main.c. */
+    unsigned long start_sizes[START_TESTS] = { 16, 65536 };
+    double max_loads[MAX_TESTS] = { 0.5, 1.0, 2.0 };
+    unsigned long (*hash_funcs[HASH_TESTS])(const unsigned char *) = {
+        hash_too_simple, hash_fnv1a, hash_wy64, hash_murmur3
+    };
+    const char *hash_names[HASH_TESTS] = { "too_simple", "fnv1a", "wy64", "murmur3" };
+
+    measure_clock();
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    char **hits = make_keys(0, n, &state);
+    char **misses = make_keys(n, n, &state);
+    if (hits == NULL || misses == NULL) {
+        free_keys(hits, n);
+        free_keys(misses, n);
+        fprintf(stderr, "Could not create the keys\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("hash,start_size,max_load,op,keys,reps,median_ns,p99_ns,mean_ns,min_ns\n");
+    int failed = 0;
+    for (int k = 0; k < HASH_TESTS && !failed; k++) {
+        for (int i = 0; i < START_TESTS && !failed; i++) {
+            for (int j = 0; j < MAX_TESTS && !failed; j++) {
+                failed = bench_config(start_sizes[i], max_loads[j], hash_funcs[k],
+                                      hash_names[k], hits, misses, n, reps, warmups,
+                                      &state);
+            }
+        }
+    }
+
+    free_keys(hits, n);
+    free_keys(misses, n);
+    if (failed) {
+        fprintf(stderr, "The benchmark failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
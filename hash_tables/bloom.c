@@ -0,0 +1,126 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file implements a split block Bloom filter, the variant used by
+ * Parquet (https://github.com/apache/parquet-format/blob/master/BloomFilter.md).
+ * The filter is an array of blocks of eight 32 bit words. The high half of
+ * the hash of a key picks the block, and the low half is multiplied with a
+ * different odd constant for every word, whose top 5 bits pick the bit that
+ * is set in that word. A key therefore sets 8 bits in one block and a check
+ * reads one block, which the compiler can do with a few vector instructions.
+ * With 16 bits per key about 1 in 400 absent keys passes the filter.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bloom.h"
+#include "hash_func.h"
+
+/* Words per block, a block is 32 bytes. */
+#define BLOCK_WORDS 8
+
+/* Filter bits per key the filter is sized for. */
+#define BITS_PER_KEY 16
+
+struct bloom {
+    uint32_t (*blocks)[BLOCK_WORDS];
+    unsigned long n_blocks;
+    /* Number of keys the filter was sized for */
+    unsigned long capacity;
+};
+
+/* Multipliers that pick the bit of every word. */
+static const uint32_t salts[BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/*
+ * Initialise an empty filter with BITS_PER_KEY bits for every key.
+ *
+ * Returns a pointer to the filter, or NULL on failure.
+ */
+struct bloom *bloom_init(unsigned long keys) {
+    struct bloom *b = malloc(sizeof(struct bloom));
+    if (b == NULL) {
+        return NULL;
+    }
+    b->n_blocks = keys * BITS_PER_KEY / (BLOCK_WORDS * 32) + 1;
+    b->capacity = keys;
+    b->blocks = aligned_alloc(sizeof(*b->blocks), b->n_blocks * sizeof(*b->blocks));
+    if (b->blocks == NULL) {
+        free(b);
+        return NULL;
+    }
+    memset(b->blocks, 0, b->n_blocks * sizeof(*b->blocks));
+    return b;
+}
+
+/*
+ * Returns the hash of a key.
+ */
+uint64_t bloom_hash(const char *key) {
+    return hash_wy64((const unsigned char *)key);
+}
+
+/* Return the block of a hash, by mapping its high half onto the blocks. */
+static unsigned long block_index(const struct bloom *b, uint64_t hash) {
+    return (unsigned long)(((hash >> 32) * b->n_blocks) >> 32);
+}
+
+/*
+ * Set the 8 bits of a hash in its block.
+ */
+void bloom_add(struct bloom *b, uint64_t hash) {
+    uint32_t *block = b->blocks[block_index(b, hash)];
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+        block[i] |= (uint32_t)1 << (((uint32_t)hash * salts[i]) >> 27);
+    }
+}
+
+/*
+ * Check whether all 8 bits of a hash are set in its block.
+ */
+int bloom_maybe_contains(const struct bloom *b, uint64_t hash) {
+    const uint32_t *block = b->blocks[block_index(b, hash)];
+    uint32_t missing = 0;
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+        missing |= ~block[i] & ((uint32_t)1 << (((uint32_t)hash * salts[i]) >> 27));
+    }
+    return missing == 0;
+}
+
+/*
+ * Prefetch the block of a hash.
+ */
+void bloom_prefetch(const struct bloom *b, uint64_t hash) {
+    __builtin_prefetch(b->blocks[block_index(b, hash)]);
+}
+
+/*
+ * Returns the number of keys the filter was sized for.
+ */
+unsigned long bloom_capacity(const struct bloom *b) {
+    return b->capacity;
+}
+
+/*
+ * Returns the number of bytes of the filter.
+ */
+size_t bloom_memory(const struct bloom *b) {
+    return sizeof(struct bloom) + b->n_blocks * sizeof(*b->blocks);
+}
+
+/*
+ * Free the filter.
+ */
+void bloom_cleanup(struct bloom *b) {
+    if (b == NULL) {
+        return;
+    }
+    free(b->blocks);
+    free(b);
+}
@@ -0,0 +1,45 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+/* Blocked Bloom filter, kept next to a hash table with the TABLE_BLOOM option
+ * to answer most lookups of absent keys without touching the table. All bits
+ * of a key lie in one block of 32 bytes, so a check costs a single cache
+ * miss. Keys can not be removed, a filter with too many stale keys has to be
+ * rebuilt. The filter hashes keys with its own hash function, so it also
+ * works for tables with a weak one. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Handle to the filter. */
+struct bloom;
+
+/* Initialise an empty filter sized for the given number of keys. Adding
+ * more keys works, but raises the false positive rate. Returns NULL on
+ * failure. */
+struct bloom *bloom_init(unsigned long keys);
+
+/* Returns the hash of key that the other functions take. */
+uint64_t bloom_hash(const char *key);
+
+/* Adds a key by its hash. */
+void bloom_add(struct bloom *b, uint64_t hash);
+
+/* Returns 0 if the key with this hash was never added, and 1 if it may have
+ * been. */
+int bloom_maybe_contains(const struct bloom *b, uint64_t hash);
+
+/* Prefetches the block of a hash, for a bloom_maybe_contains of it shortly
+ * after. */
+void bloom_prefetch(const struct bloom *b, uint64_t hash);
+
+/* Returns the number of keys the filter was sized for. */
+unsigned long bloom_capacity(const struct bloom *b);
+
+/* Returns the number of bytes of the filter. */
+size_t bloom_memory(const struct bloom *b);
+
+/* Frees the filter. */
+void bloom_cleanup(struct bloom *b);
+
+#endif /* BLOOM_H */
@@ -0,0 +1,116 @@
+#include <check.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "array_ext.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+/* Tests */
+
+/* test alignment and chunk overflow, including oversized requests */
+START_TEST(test_arena_alloc) {
+    struct arena *a = arena_init(256);
+    ck_assert_ptr_nonnull(a);
+
+    for (size_t size = 1; size < 100; size++) {
+        char *mem = arena_alloc(a, size);
+        ck_assert_ptr_nonnull(mem);
+        ck_assert_uint_eq((uintptr_t) mem % sizeof(double), 0);
+        memset(mem, 'x', size);
+    }
+    char *big = arena_alloc(a, 4096);
+    ck_assert_ptr_nonnull(big);
+    memset(big, 'y', 4096);
+    ck_assert_uint_ge(arena_used(a), 4096);
+
+    arena_cleanup(a);
+}
+END_TEST
+
+/* test that arena arrays keep their values when they grow */
+START_TEST(test_arena_array) {
+    struct arena *a = arena_init(256);
+    ck_assert_ptr_nonnull(a);
+
+    struct array *arr = array_init_arena(a, 2);
+    ck_assert_ptr_nonnull(arr);
+    for (int i = 0; i < 100; i++) {
+        ck_assert_int_eq(array_append(arr, i * 3), 0);
+    }
+    ck_assert_uint_eq(array_size(arr), 100);
+    for (int i = 0; i < 100; i++) {
+        ck_assert_int_eq(array_get(arr, (unsigned long) i), i * 3);
+    }
+    /* Does nothing, the array goes with the arena. */
+    array_cleanup(arr);
+
+    arena_cleanup(a);
+}
+END_TEST
+
+/* test a table that allocates from its arena */
+START_TEST(test_arena_table) {
+    struct table *t;
+    t = table_init_mode(2, 0.6, hash_too_simple, TABLE_CHAINING | TABLE_ARENA);
+    ck_assert_ptr_nonnull(t);
+
+    char key[8];
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 26, i);
+        ck_assert_int_eq(table_insert(t, key, i), 0);
+        ck_assert_int_eq(table_insert(t, key, i + 1), 0);
+    }
+    for (int i = 0; i < 200; i += 2) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 26, i);
+        ck_assert_int_eq(table_delete(t, key), 0);
+    }
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 26, i);
+        if (i % 2 == 0) {
+            ck_assert_ptr_null(table_lookup(t, key));
+        } else {
+            ck_assert_int_eq(array_get(table_lookup(t, key), 1), i + 1);
+        }
+    }
+
+    table_cleanup(t);
+}
+END_TEST
+
+Suite *arena_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Arena");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_arena_alloc);
+    tcase_add_test(tc_core, test_arena_array);
+    tcase_add_test(tc_core, test_arena_table);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = arena_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,8 +1,10 @@
 #include <check.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "array.h"
+#include "array_ext.h"
 
 // For older versions of the check library
 #ifndef ck_assert_ptr_nonnull
@@ -65,6 +67,158 @@ START_TEST(test_add_resize) {
 }
 END_TEST
 
+/* test an array embedded in a caller block that spills past its inline
+ * storage */
+START_TEST(test_embedded) {
+    void *mem = malloc(array_footprint());
+    ck_assert_ptr_nonnull(mem);
+
+    struct array *a = array_init_at(mem, NULL, 0);
+    ck_assert_ptr_nonnull(a);
+    ck_assert_uint_eq(array_size(a), 0);
+
+    for (int i = 0; i < 50; i++) {
+        ck_assert_int_eq(array_append(a, i * 2), 0);
+    }
+    ck_assert_uint_eq(array_size(a), 50);
+    for (int i = 0; i < 50; i++) {
+        ck_assert_int_eq(array_get(a, (unsigned long) i), i * 2);
+    }
+
+    /* Only frees the spilled data, the block is still ours. */
+    array_cleanup(a);
+    free(mem);
+}
+END_TEST
+
+/* test compressed arrays, with gaps of one and of several varint bytes */
+START_TEST(test_compressed) {
+    int values[] = { 0, 1, 2, 130, 131, 20000, 20001, 3000000, 2000000000 };
+    unsigned long n = sizeof(values) / sizeof(values[0]);
+
+    struct array *a = array_init_compressed();
+    ck_assert_ptr_nonnull(a);
+    for (unsigned long i = 0; i < n; i++) {
+        ck_assert_int_eq(array_append(a, values[i]), 0);
+    }
+    /* Not increasing */
+    ck_assert_int_eq(array_append(a, 5), 1);
+    ck_assert_int_eq(array_append(a, 2000000000), 1);
+    ck_assert_uint_eq(array_size(a), n);
+
+    for (unsigned long i = 0; i < n; i++) {
+        ck_assert_int_eq(array_get(a, i), values[i]);
+    }
+    ck_assert_int_eq(array_get(a, n), -1);
+
+    struct array_cursor c;
+    int elem;
+    unsigned long count = 0;
+    array_cursor_init(&c, a);
+    while (array_cursor_next(&c, &elem)) {
+        ck_assert_int_eq(elem, values[count]);
+        count++;
+    }
+    ck_assert_uint_eq(count, n);
+
+    array_cleanup(a);
+}
+END_TEST
+
+/* test images, their checks and views of them in memory of the caller */
+START_TEST(test_image_view) {
+    int values[] = { 3, 200, 201, 70000 };
+    uint32_t image[64];
+    _Alignas(max_align_t) unsigned char mem[128];
+    ck_assert_uint_le(array_footprint(), sizeof(mem));
+
+    for (int compressed = 0; compressed < 2; compressed++) {
+        struct array *a = compressed ? array_init_compressed() : array_init(1);
+        ck_assert_ptr_nonnull(a);
+        for (int i = 0; i < 4; i++) {
+            ck_assert_int_eq(array_append(a, values[i]), 0);
+        }
+        size_t size = array_image_size(a);
+        ck_assert_uint_le(size, sizeof(image));
+        array_image_write(a, image);
+        array_cleanup(a);
+
+        ck_assert_int_eq(array_image_check(image, size), 0);
+        ck_assert_int_eq(array_image_check(image, size - 1), 1);
+        struct array *view = array_view_at(mem, image);
+        ck_assert_uint_eq(array_size(view), 4);
+        ck_assert_int_eq(array_get(view, 3), 70000);
+        ck_assert_int_eq(array_last(view), 70000);
+        ck_assert_int_eq(array_append(view, 80000), 1);
+        array_cleanup(view);
+
+        /* A varint that runs past the data, or a count that does not match */
+        unsigned char *bytes = (unsigned char *)image;
+        bytes[size - 1] |= 0x80;
+        ck_assert_int_eq(array_image_check(image, size), !compressed ? 0 : 1);
+        image[0]++;
+        ck_assert_int_eq(array_image_check(image, size), 1);
+    }
+}
+END_TEST
+
+/* test intersections of plain and compressed arrays of different sizes */
+START_TEST(test_intersect) {
+    struct array *multiples[3];
+    for (int m = 0; m < 3; m++) {
+        /* multiples of 2, 3 and 5, the last one compressed */
+        multiples[m] = m == 2 ? array_init_compressed() : array_init(0);
+        ck_assert_ptr_nonnull(multiples[m]);
+        int step = m == 0 ? 2 : m == 1 ? 3 : 5;
+        for (int v = 0; v < 10000; v += step) {
+            ck_assert_int_eq(array_append(multiples[m], v), 0);
+        }
+    }
+
+    const struct array *arrays[3] = { multiples[0], multiples[1], multiples[2] };
+    struct array *r = array_intersect(arrays, 3);
+    ck_assert_ptr_nonnull(r);
+    ck_assert_uint_eq(array_size(r), 334);
+    for (unsigned long i = 0; i < array_size(r); i++) {
+        ck_assert_int_eq(array_get(r, i), (int)i * 30);
+    }
+    array_cleanup(r);
+
+    /* A single array with repeated values gives its distinct values */
+    struct array *repeated = array_init(0);
+    int values[] = { 1, 1, 4, 9, 9, 9, 10000 };
+    for (unsigned long i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        ck_assert_int_eq(array_append(repeated, values[i]), 0);
+    }
+    const struct array *single[1] = { repeated };
+    r = array_intersect(single, 1);
+    ck_assert_uint_eq(array_size(r), 4);
+    ck_assert_int_eq(array_get(r, 1), 4);
+    ck_assert_int_eq(array_last(r), 10000);
+    array_cleanup(r);
+
+    /* Values past the end of the candidates and no common values */
+    const struct array *pair[2] = { repeated, multiples[1] };
+    r = array_intersect(pair, 2);
+    ck_assert_uint_eq(array_size(r), 1);
+    ck_assert_int_eq(array_get(r, 0), 9);
+    array_cleanup(r);
+
+    struct array *empty = array_init(0);
+    const struct array *none[2] = { multiples[0], empty };
+    r = array_intersect(none, 2);
+    ck_assert_uint_eq(array_size(r), 0);
+    array_cleanup(r);
+    ck_assert_ptr_null(array_intersect(none, 0));
+
+    array_cleanup(empty);
+    array_cleanup(repeated);
+    for (int m = 0; m < 3; m++) {
+        array_cleanup(multiples[m]);
+    }
+}
+END_TEST
+
 Suite *array_suite(void) {
     Suite *s;
     TCase *tc_core;
@@ -77,6 +231,10 @@ Suite *array_suite(void) {
     tcase_add_test(tc_core, test_init);
     tcase_add_test(tc_core, test_add_basic);
     tcase_add_test(tc_core, test_add_resize);
+    tcase_add_test(tc_core, test_embedded);
+    tcase_add_test(tc_core, test_compressed);
+    tcase_add_test(tc_core, test_image_view);
+    tcase_add_test(tc_core, test_intersect);
 
     suite_add_tcase(s, tc_core);
     return s;
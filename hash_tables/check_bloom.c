@@ -0,0 +1,150 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "array_ext.h"
+#include "bloom.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+/* Tests */
+
+/* test that the filter has no false negatives and few false positives */
+START_TEST(test_bloom_filter) {
+    struct bloom *b = bloom_init(10000);
+    ck_assert_ptr_nonnull(b);
+    char key[32];
+
+    for (int i = 0; i < 10000; i++) {
+        sprintf(key, "key%d", i);
+        bloom_add(b, bloom_hash(key));
+    }
+    for (int i = 0; i < 10000; i++) {
+        sprintf(key, "key%d", i);
+        ck_assert_int_eq(bloom_maybe_contains(b, bloom_hash(key)), 1);
+    }
+    int false_positives = 0;
+    for (int i = 0; i < 100000; i++) {
+        sprintf(key, "absent%d", i);
+        false_positives += bloom_maybe_contains(b, bloom_hash(key));
+    }
+    ck_assert_int_lt(false_positives, 1000);
+    ck_assert_uint_eq(bloom_capacity(b), 10000);
+    ck_assert_uint_ge(bloom_memory(b), 10000 * 2);
+    bloom_cleanup(b);
+}
+END_TEST
+
+/* test tables with a filter for every backend, while they grow */
+START_TEST(test_bloom_tables) {
+    int modes[] = { TABLE_CHAINING, TABLE_CHAINING | TABLE_ARENA | TABLE_COMPRESSED,
+                    TABLE_CHAINING | TABLE_INCREMENTAL_RESIZE, TABLE_ROBIN_HOOD,
+                    TABLE_SWISS, TABLE_CUCKOO };
+    char key[32];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(4, 0.75, hash_too_simple, modes[m] | TABLE_BLOOM);
+        ck_assert_ptr_nonnull(t);
+        for (int i = 0; i < 2000; i++) {
+            sprintf(key, "key%d", i % 1000);
+            ck_assert_int_eq(table_insert(t, key, i), 0);
+        }
+        ck_assert_int_eq(table_count_lookups(t, 1), 0);
+        for (int i = 0; i < 1000; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(array_get(table_lookup(t, key), 1), i + 1000);
+        }
+        for (int i = 0; i < 1000; i++) {
+            sprintf(key, "absent%d", i);
+            ck_assert_ptr_null(table_lookup(t, key));
+        }
+
+        const char *batch[] = { "key1", "absent", NULL, "key999" };
+        struct array *out[4];
+        ck_assert_int_eq(table_lookup_batch(t, batch, 4, out), 0);
+        ck_assert_ptr_eq(out[0], table_lookup(t, "key1"));
+        ck_assert_ptr_null(out[1]);
+        ck_assert_ptr_null(out[2]);
+        ck_assert_int_eq(array_get(out[3], 0), 999);
+
+        struct table_stats stats;
+        ck_assert_int_eq(table_stats(t, &stats), 0);
+        ck_assert_uint_eq(stats.misses, 1001);
+        ck_assert_uint_ge(stats.bloom_rejects, 980);
+        table_cleanup(t);
+    }
+    ck_assert_ptr_null(table_init_mode(4, 0.75, hash_fnv1a, TABLE_SWISS | TABLE_ARENA));
+}
+END_TEST
+
+/* test that deleted keys are not found and the filter survives rebuilds */
+START_TEST(test_bloom_delete) {
+    int modes[] = { TABLE_CHAINING, TABLE_ROBIN_HOOD, TABLE_SWISS, TABLE_CUCKOO };
+    char key[32];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(4, 0.75, hash_fnv1a, modes[m] | TABLE_BLOOM);
+        ck_assert_ptr_nonnull(t);
+        for (int i = 0; i < 1000; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(table_insert(t, key, i), 0);
+        }
+        for (int i = 0; i < 900; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(table_delete(t, key), 0);
+        }
+        for (int i = 0; i < 1000; i++) {
+            sprintf(key, "key%d", i);
+            if (i < 900) {
+                ck_assert_ptr_null(table_lookup(t, key));
+            } else {
+                ck_assert_int_eq(array_get(table_lookup(t, key), 0), i);
+            }
+        }
+        ck_assert_int_eq(table_compact(t), 0);
+        ck_assert_int_eq(table_insert(t, "key5", 5), 0);
+        ck_assert_int_eq(array_get(table_lookup(t, "key5"), 0), 5);
+        ck_assert_int_eq(array_get(table_lookup(t, "key950"), 0), 950);
+
+        ck_assert_int_eq(table_freeze(t), 0);
+        ck_assert_int_eq(array_get(table_lookup(t, "key950"), 0), 950);
+        ck_assert_ptr_null(table_lookup(t, "key6"));
+        table_cleanup(t);
+    }
+}
+END_TEST
+
+Suite *bloom_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Bloom filter");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_bloom_filter);
+    tcase_add_test(tc_core, test_bloom_tables);
+    tcase_add_test(tc_core, test_bloom_delete);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = bloom_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
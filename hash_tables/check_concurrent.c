@@ -0,0 +1,192 @@
+#include <check.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "concurrent_table.h"
+#include "hash_func.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+#define WRITERS 4
+#define READERS 4
+#define KEYS_PER_WRITER 2000
+#define VALUES_PER_KEY 3
+
+struct worker {
+    struct ctable *t;
+    int id;
+    /* Set by the writers when they are done */
+    int *done;
+    pthread_mutex_t *lock;
+};
+
+/* Insert keys w<id>_<i> with values 0..VALUES_PER_KEY-1, deleting and
+ * reinserting some of them on the way. */
+static void *write_keys(void *arg) {
+    struct worker *w = arg;
+    char key[32];
+
+    for (int v = 0; v < VALUES_PER_KEY; v++) {
+        for (int i = 0; i < KEYS_PER_WRITER; i++) {
+            sprintf(key, "w%d_%d", w->id, i);
+            ck_assert_int_eq(ctable_insert(w->t, key, v), 0);
+        }
+    }
+    for (int i = 0; i < KEYS_PER_WRITER; i += 10) {
+        sprintf(key, "w%d_%d", w->id, i);
+        ck_assert_int_eq(ctable_delete(w->t, key), 0);
+        for (int v = 0; v < VALUES_PER_KEY; v++) {
+            ck_assert_int_eq(ctable_insert(w->t, key, v), 0);
+        }
+    }
+
+    pthread_mutex_lock(w->lock);
+    (*w->done)++;
+    pthread_mutex_unlock(w->lock);
+    return NULL;
+}
+
+/* Look keys up while the writers run. Every key that is found must have the
+ * values 0, 1, ... in order, and the shared keys must always be present. */
+static void *read_keys(void *arg) {
+    struct worker *w = arg;
+    char key[32];
+    int values[VALUES_PER_KEY];
+    int finished = 0;
+
+    for (unsigned int round = 0; !finished; round++) {
+        pthread_mutex_lock(w->lock);
+        finished = *w->done == WRITERS;
+        pthread_mutex_unlock(w->lock);
+
+        ck_assert_uint_eq(ctable_lookup(w->t, "shared", values, VALUES_PER_KEY), 1);
+        ck_assert_int_eq(values[0], 42);
+
+        sprintf(key, "w%u_%u", round % WRITERS, (round * 7919) % KEYS_PER_WRITER);
+        size_t n = ctable_lookup(w->t, key, values, VALUES_PER_KEY);
+        ck_assert_uint_le(n, VALUES_PER_KEY);
+        for (size_t i = 0; i < n; i++) {
+            ck_assert_int_eq(values[i], (int)i);
+        }
+    }
+    return NULL;
+}
+
+/* Tests */
+
+/* test the single threaded behaviour */
+START_TEST(test_concurrent_basic) {
+    struct ctable *t = ctable_init(1, 0.6, hash_too_simple);
+    ck_assert_ptr_nonnull(t);
+    int values[4];
+
+    ck_assert_uint_eq(ctable_lookup(t, "abc", values, 4), 0);
+    ck_assert_int_eq(ctable_insert(t, "abc", 3), 0);
+    ck_assert_int_eq(ctable_insert(t, "cba", 5), 0);
+    for (int i = 0; i < 10; i++) {
+        ck_assert_int_eq(ctable_insert(t, "abc", i), 0);
+    }
+
+    ck_assert_uint_eq(ctable_lookup(t, "abc", values, 4), 11);
+    ck_assert_int_eq(values[0], 3);
+    ck_assert_int_eq(values[3], 2);
+    ck_assert_uint_eq(ctable_lookup(t, "cba", NULL, 0), 1);
+
+    ck_assert_int_eq(ctable_delete(t, "abc"), 0);
+    ck_assert_int_eq(ctable_delete(t, "abc"), 1);
+    ck_assert_int_eq(ctable_delete(NULL, "abc"), -1);
+    ck_assert_uint_eq(ctable_lookup(t, "abc", values, 4), 0);
+    ck_assert_uint_eq(ctable_lookup(t, "cba", values, 4), 1);
+    ck_assert(ctable_load_factor(t) > 0);
+
+    ctable_cleanup(t);
+}
+END_TEST
+
+/* test that many keys cause resizes and all stay reachable */
+START_TEST(test_concurrent_resize) {
+    struct ctable *t = ctable_init(64, 0.5, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    char key[32];
+    int value;
+
+    for (int i = 0; i < 10000; i++) {
+        sprintf(key, "key%d", i);
+        ck_assert_int_eq(ctable_insert(t, key, i), 0);
+    }
+    ck_assert(ctable_load_factor(t) <= 0.5);
+    for (int i = 0; i < 10000; i++) {
+        sprintf(key, "key%d", i);
+        ck_assert_uint_eq(ctable_lookup(t, key, &value, 1), 1);
+        ck_assert_int_eq(value, i);
+    }
+    ctable_cleanup(t);
+}
+END_TEST
+
+/* test readers running during inserts, deletes and resizes */
+START_TEST(test_concurrent_threads) {
+    struct ctable *t = ctable_init(2, 0.75, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(ctable_insert(t, "shared", 42), 0);
+
+    pthread_t threads[WRITERS + READERS];
+    struct worker workers[WRITERS + READERS];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    int done = 0;
+
+    for (int i = 0; i < WRITERS + READERS; i++) {
+        workers[i] = (struct worker){ t, i, &done, &lock };
+        ck_assert_int_eq(pthread_create(&threads[i], NULL,
+                                        i < WRITERS ? write_keys : read_keys, &workers[i]), 0);
+    }
+    for (int i = 0; i < WRITERS + READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    char key[32];
+    int values[VALUES_PER_KEY];
+    for (int w = 0; w < WRITERS; w++) {
+        for (int i = 0; i < KEYS_PER_WRITER; i++) {
+            sprintf(key, "w%d_%d", w, i);
+            ck_assert_uint_eq(ctable_lookup(t, key, values, VALUES_PER_KEY), VALUES_PER_KEY);
+            ck_assert_int_eq(values[VALUES_PER_KEY - 1], VALUES_PER_KEY - 1);
+        }
+    }
+    ctable_cleanup(t);
+}
+END_TEST
+
+Suite *concurrent_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Concurrent table");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_concurrent_basic);
+    tcase_add_test(tc_core, test_concurrent_resize);
+    tcase_add_test(tc_core, test_concurrent_threads);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = concurrent_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
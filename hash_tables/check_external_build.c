@@ -0,0 +1,172 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_ext.h"
+#include "external_build.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+#include "index_build.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+#define INDEX_FILE "check_external_build.idx"
+
+/* Compare the values of a key with those of the same key in the table in
+ * ctx, counting the keys in the table's place in keys. */
+struct compare {
+    const struct table *reference;
+    unsigned long keys;
+};
+
+static int compare_key(void *ctx, const char *key, struct array *values) {
+    struct compare *c = ctx;
+    struct array *expected = table_lookup(c->reference, key);
+    ck_assert_ptr_nonnull(expected);
+    ck_assert_uint_eq(array_size(values), array_size(expected));
+
+    struct array_cursor a, b;
+    int x, y;
+    array_cursor_init(&a, values);
+    array_cursor_init(&b, expected);
+    while (array_cursor_next(&a, &x)) {
+        ck_assert_int_eq(array_cursor_next(&b, &y), 1);
+        ck_assert_int_eq(x, y);
+    }
+    c->keys++;
+    return 0;
+}
+
+/* Write the word for number n, in letters since words have no digits, to
+ * word. */
+static void number_word(int n, char *word) {
+    *word++ = 'w';
+    do {
+        *word++ = (char)('a' + n % 26);
+        n /= 26;
+    } while (n > 0);
+    *word = '\0';
+}
+
+/* Return the number of keys in a table. */
+static unsigned long table_keys(const struct table *t) {
+    struct table_stats stats;
+    ck_assert_int_eq(table_stats(t, &stats), 0);
+    return stats.keys;
+}
+
+/* Make a text of lines lines of words, with words that occur on many lines,
+ * on few lines and more than once on the same line. The caller frees it. */
+static unsigned char *make_text(int lines, size_t *size) {
+    unsigned char *text = malloc((size_t)lines * 128);
+    ck_assert_ptr_nonnull(text);
+    char a[16], b[16], c[16];
+    size_t n = 0;
+    for (int i = 0; i < lines; i++) {
+        number_word(i % 7, a);
+        number_word((i * 31) % 5003, b);
+        number_word(i, c);
+        n += (size_t)sprintf((char *)text + n, "The %s %s and %s, %s. THE\n", a, b, c, a);
+    }
+    *size = n;
+    return text;
+}
+
+/* Tests */
+
+/* test that a build with many runs gives the same index as index_build */
+START_TEST(test_external_many_runs) {
+    size_t size;
+    unsigned char *text = make_text(20000, &size);
+    struct table *expected = index_build(text, size, 1, 1024, 0.6, hash_fnv1a, TABLE_CHAINING);
+    ck_assert_ptr_nonnull(expected);
+
+    ck_assert_int_eq(index_build_external(text, size, INDEX_FILE, EXTERNAL_MIN_BUDGET,
+                                          hash_fnv1a), 0);
+    struct table *t = table_load(INDEX_FILE, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    struct compare c = { expected, 0 };
+    ck_assert_int_eq(table_foreach(t, compare_key, &c), 0);
+    ck_assert_uint_eq(c.keys, table_keys(expected));
+    ck_assert_uint_eq(array_size(table_lookup(t, "the")), 20000);
+    ck_assert_ptr_null(table_lookup(t, "wzzzz"));
+
+    /* The runs are removed again */
+    FILE *run = fopen(INDEX_FILE ".run0", "r");
+    ck_assert_ptr_null(run);
+
+    table_cleanup(t);
+    table_cleanup(expected);
+    free(text);
+    remove(INDEX_FILE);
+}
+END_TEST
+
+/* test a text that fits in a single run and an empty text */
+START_TEST(test_external_small) {
+    const char *text = "one two\nthree one\n\ntwo two\n";
+    ck_assert_int_eq(index_build_external((const unsigned char *)text, strlen(text),
+                                          INDEX_FILE, 1024 * 1024, hash_too_simple), 0);
+    struct table *t = table_load(INDEX_FILE, hash_too_simple);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_uint_eq(table_keys(t), 3);
+    ck_assert_uint_eq(array_size(table_lookup(t, "one")), 2);
+    ck_assert_int_eq(array_get(table_lookup(t, "one"), 1), 2);
+    ck_assert_uint_eq(array_size(table_lookup(t, "two")), 2);
+    ck_assert_int_eq(array_get(table_lookup(t, "two"), 1), 4);
+    table_cleanup(t);
+
+    ck_assert_int_eq(index_build_external((const unsigned char *)"", 0, INDEX_FILE,
+                                          EXTERNAL_MIN_BUDGET, hash_too_simple), 0);
+    t = table_load(INDEX_FILE, hash_too_simple);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_uint_eq(table_keys(t), 0);
+    table_cleanup(t);
+    remove(INDEX_FILE);
+}
+END_TEST
+
+/* test budgets that are too small and files that can not be written */
+START_TEST(test_external_invalid) {
+    const char *text = "one two\n";
+    ck_assert_int_eq(index_build_external((const unsigned char *)text, strlen(text),
+                                          INDEX_FILE, EXTERNAL_MIN_BUDGET - 1, hash_fnv1a), 1);
+    ck_assert_int_eq(index_build_external((const unsigned char *)text, strlen(text),
+                                          "does/not/exist.idx", EXTERNAL_MIN_BUDGET,
+                                          hash_fnv1a), 1);
+}
+END_TEST
+
+Suite *external_build_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("External build");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_external_many_runs);
+    tcase_add_test(tc_core, test_external_small);
+    tcase_add_test(tc_core, test_external_invalid);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = external_build_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "array_ext.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+#define INDEX_FILE "check_frozen.idx"
+
+/* Count the keys of a table and check that their values are 1000 times the
+ * number in the key, plus 170000 for every earlier occurrence. */
+static int check_key(void *ctx, const char *key, struct array *values) {
+    int number = atoi(key + 3);
+    for (unsigned long i = 0; i < array_size(values); i++) {
+        ck_assert_int_eq(array_get(values, i), (number + 170 * (int)i) * 1000);
+    }
+    (*(unsigned long *)ctx)++;
+    return 0;
+}
+
+/* Tests */
+
+/* test freezing tables of every backend */
+START_TEST(test_frozen_backends) {
+    int modes[] = { TABLE_CHAINING, TABLE_CHAINING | TABLE_ARENA | TABLE_COMPRESSED,
+                    TABLE_CHAINING | TABLE_INCREMENTAL_RESIZE, TABLE_ROBIN_HOOD,
+                    TABLE_SWISS, TABLE_CUCKOO };
+    char key[32];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(8, 0.6, hash_too_simple, modes[m]);
+        ck_assert_ptr_nonnull(t);
+        for (int i = 0; i < 500; i++) {
+            sprintf(key, "key%d", i % 170);
+            ck_assert_int_eq(table_insert(t, key, i * 1000), 0);
+        }
+        ck_assert_int_eq(table_freeze(t), 0);
+
+        unsigned long keys = 0;
+        ck_assert_int_eq(table_foreach(t, check_key, &keys), 0);
+        ck_assert_uint_eq(keys, 170);
+        for (int i = 0; i < 170; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(array_get(table_lookup(t, key), 0), i * 1000);
+        }
+        ck_assert_uint_eq(array_size(table_lookup(t, "key3")), 3);
+        ck_assert_ptr_null(table_lookup(t, "key170"));
+        ck_assert_ptr_null(table_lookup(t, ""));
+        ck_assert(table_load_factor(t) > 0.9);
+
+        const char *batch[] = { "key1", "nope", "key169" };
+        struct array *out[3];
+        ck_assert_int_eq(table_lookup_batch(t, batch, 3, out), 0);
+        ck_assert_ptr_eq(out[0], table_lookup(t, "key1"));
+        ck_assert_ptr_null(out[1]);
+        ck_assert_int_eq(array_get(out[2], 0), 169000);
+        table_cleanup(t);
+    }
+}
+END_TEST
+
+/* test that frozen tables are read-only and can not be frozen again */
+START_TEST(test_frozen_read_only) {
+    struct table *t = table_init(4, 0.6, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(table_insert(t, "abc", 1), 0);
+    ck_assert_int_eq(table_freeze(t), 0);
+
+    ck_assert_int_eq(table_insert(t, "abc", 2), 1);
+    ck_assert_int_eq(table_insert(t, "def", 2), 1);
+    ck_assert_int_eq(table_delete(t, "abc"), -1);
+    ck_assert_int_eq(array_append(table_lookup(t, "abc"), 2), 1);
+    ck_assert_uint_eq(array_size(table_lookup(t, "abc")), 1);
+    ck_assert_int_eq(table_freeze(t), 1);
+    ck_assert_int_eq(table_freeze(NULL), 1);
+    table_cleanup(t);
+}
+END_TEST
+
+/* test freezing empty tables and saving frozen tables */
+START_TEST(test_frozen_empty_and_save) {
+    struct table *t = table_init(4, 0.6, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(table_freeze(t), 0);
+    ck_assert_ptr_null(table_lookup(t, "abc"));
+    ck_assert(table_load_factor(t) < 0.5);
+    table_cleanup(t);
+
+    t = table_init(4, 0.6, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    char key[32];
+    for (int i = 0; i < 3000; i++) {
+        sprintf(key, "key%d", i % 170);
+        ck_assert_int_eq(table_insert(t, key, i * 1000), 0);
+    }
+    ck_assert_int_eq(table_freeze(t), 0);
+    ck_assert_int_eq(table_save(t, INDEX_FILE), 0);
+    table_cleanup(t);
+
+    t = table_load(INDEX_FILE, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    unsigned long keys = 0;
+    ck_assert_int_eq(table_foreach(t, check_key, &keys), 0);
+    ck_assert_uint_eq(keys, 170);
+    ck_assert_int_eq(table_freeze(t), 1);
+    table_cleanup(t);
+    remove(INDEX_FILE);
+}
+END_TEST
+
+Suite *frozen_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Frozen table");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_frozen_backends);
+    tcase_add_test(tc_core, test_frozen_read_only);
+    tcase_add_test(tc_core, test_frozen_empty_and_save);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = frozen_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
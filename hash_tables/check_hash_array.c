@@ -4,7 +4,7 @@
 
 #include "array.h"
 #include "hash_func.h"
-#include "hash_table.h"
+#include "hash_table_ext.h"
 
 // For older versions of the check library
 #ifndef ck_assert_ptr_nonnull
@@ -93,6 +93,184 @@ START_TEST(test_array_with_resize) {
 }
 END_TEST
 
+START_TEST(test_array_compressed) {
+    struct table *t;
+    t = table_init_mode(2, 0.6, hash_too_simple, TABLE_CHAINING | TABLE_COMPRESSED);
+    ck_assert_ptr_nonnull(t);
+
+    for (int i = 1; i <= 100; i++) {
+        ck_assert_int_eq(table_insert(t, "abc", i * i), 0);
+    }
+    ck_assert_int_eq(table_insert(t, "def", 22), 0);
+    /* Values of a key have to increase */
+    ck_assert_int_eq(table_insert(t, "def", 22), 1);
+    ck_assert_int_eq(table_insert(t, "def", 3), 1);
+
+    ck_assert_uint_eq(array_size(table_lookup(t, "abc")), 100);
+    ck_assert_int_eq(array_get(table_lookup(t, "abc"), 0), 1);
+    ck_assert_int_eq(array_get(table_lookup(t, "abc"), 99), 10000);
+    ck_assert_uint_eq(array_size(table_lookup(t, "def")), 1);
+    ck_assert_int_eq(array_get(table_lookup(t, "def"), 0), 22);
+
+    table_cleanup(t);
+}
+END_TEST
+
+START_TEST(test_array_unique_tail) {
+    int modes[] = { TABLE_CHAINING, TABLE_ROBIN_HOOD, TABLE_SWISS,
+                    TABLE_CHAINING | TABLE_COMPRESSED };
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t;
+        t = table_init_mode(2, 0.6, hash_too_simple, modes[m]);
+        ck_assert_ptr_nonnull(t);
+
+        ck_assert_int_eq(table_insert_unique_tail(t, "abc", 1), 0);
+        ck_assert_int_eq(table_insert_unique_tail(t, "abc", 1), 0);
+        ck_assert_int_eq(table_insert_unique_tail(t, "def", 1), 0);
+        ck_assert_int_eq(table_insert_unique_tail(t, "abc", 4), 0);
+        ck_assert_int_eq(table_insert_unique_tail(t, "abc", 4), 0);
+        ck_assert_int_eq(table_insert_unique_tail(t, "abc", 7), 0);
+
+        ck_assert_uint_eq(array_size(table_lookup(t, "abc")), 3);
+        ck_assert_int_eq(array_get(table_lookup(t, "abc"), 0), 1);
+        ck_assert_int_eq(array_get(table_lookup(t, "abc"), 1), 4);
+        ck_assert_int_eq(array_get(table_lookup(t, "abc"), 2), 7);
+        ck_assert_uint_eq(array_size(table_lookup(t, "def")), 1);
+
+        table_cleanup(t);
+    }
+}
+END_TEST
+
+/* test merging tables, which visits every key with table_foreach */
+START_TEST(test_array_merge) {
+    int modes[] = { TABLE_CHAINING, TABLE_ROBIN_HOOD, TABLE_SWISS, TABLE_CUCKOO,
+                    TABLE_CHAINING | TABLE_INCREMENTAL_RESIZE | TABLE_COMPRESSED };
+    char key[8];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *dst = table_init_mode(2, 0.6, hash_too_simple, modes[m]);
+        struct table *src = table_init_mode(2, 0.6, hash_too_simple, modes[m]);
+        ck_assert_ptr_nonnull(dst);
+        ck_assert_ptr_nonnull(src);
+
+        for (int i = 0; i < 50; i++) {
+            sprintf(key, "k%d", i);
+            ck_assert_int_eq(table_insert(dst, key, i), 0);
+            sprintf(key, "k%d", i + 25);
+            ck_assert_int_eq(table_insert(src, key, i), 0);
+            ck_assert_int_eq(table_insert(src, key, i + 1), 0);
+        }
+        ck_assert_int_eq(table_merge(dst, src, 100), 0);
+        /* Merging is no lookup */
+        struct table_stats stats;
+        ck_assert_int_eq(table_stats(dst, &stats), 0);
+        ck_assert_uint_eq(stats.hits + stats.misses, 0);
+
+        for (int i = 0; i < 75; i++) {
+            sprintf(key, "k%d", i);
+            struct array *values = table_lookup(dst, key);
+            ck_assert_ptr_nonnull(values);
+            unsigned long first = i < 50;
+            ck_assert_uint_eq(array_size(values), first + (i >= 25 ? 2 : 0));
+            if (first) {
+                ck_assert_int_eq(array_get(values, 0), i);
+            }
+            if (i >= 25) {
+                ck_assert_int_eq(array_get(values, first), i - 25 + 100);
+                ck_assert_int_eq(array_get(values, first + 1), i - 25 + 101);
+            }
+        }
+
+        table_cleanup(dst);
+        table_cleanup(src);
+    }
+}
+END_TEST
+
+/* test that a batch lookup finds the same values as single lookups */
+START_TEST(test_array_lookup_batch) {
+    int modes[] = { TABLE_CHAINING, TABLE_ROBIN_HOOD, TABLE_SWISS, TABLE_CUCKOO,
+                    TABLE_CHAINING | TABLE_INCREMENTAL_RESIZE };
+    char keys[100][8];
+    const char *batch[101];
+    struct array *out[101];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(2, 0.6, hash_too_simple, modes[m]);
+        ck_assert_ptr_nonnull(t);
+
+        for (int i = 0; i < 100; i++) {
+            sprintf(keys[i], "k%d", i);
+            batch[i] = keys[i];
+            if (i % 3 != 0) {
+                ck_assert_int_eq(table_insert(t, keys[i], i), 0);
+            }
+        }
+        batch[100] = NULL;
+
+        ck_assert_int_eq(table_lookup_batch(t, batch, 101, out), 0);
+        for (int i = 0; i < 100; i++) {
+            if (i % 3 == 0) {
+                ck_assert_ptr_null(out[i]);
+            } else {
+                ck_assert_ptr_nonnull(out[i]);
+                ck_assert_int_eq(array_get(out[i], 0), i);
+            }
+        }
+        ck_assert_ptr_null(out[100]);
+        ck_assert_int_eq(table_lookup_batch(t, NULL, 0, NULL), 0);
+        ck_assert_int_eq(table_lookup_batch(NULL, batch, 1, out), 1);
+
+        table_cleanup(t);
+    }
+}
+END_TEST
+
+/* test AND lookups of several keys, also on a frozen table */
+START_TEST(test_array_lookup_and) {
+    int modes[] = { TABLE_CHAINING, TABLE_CHAINING | TABLE_COMPRESSED, TABLE_ROBIN_HOOD,
+                    TABLE_CUCKOO };
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(4, 0.6, hash_fnv1a, modes[m]);
+        ck_assert_ptr_nonnull(t);
+        for (int line = 0; line < 3000; line++) {
+            ck_assert_int_eq(table_insert(t, "every", line), 0);
+            if (line % 2 == 0) {
+                ck_assert_int_eq(table_insert(t, "even", line), 0);
+            }
+            if (line % 7 == 0) {
+                ck_assert_int_eq(table_insert(t, "seventh", line), 0);
+            }
+        }
+
+        for (int frozen = 0; frozen < 2; frozen++) {
+            const char *query[] = { "every", "seventh", "even" };
+            struct array *r = table_lookup_and(t, query, 3);
+            ck_assert_ptr_nonnull(r);
+            ck_assert_uint_eq(array_size(r), 215);
+            for (unsigned long i = 0; i < array_size(r); i++) {
+                ck_assert_int_eq(array_get(r, i), (int)i * 14);
+            }
+            array_cleanup(r);
+
+            const char *missing[] = { "even", "absent" };
+            r = table_lookup_and(t, missing, 2);
+            ck_assert_ptr_nonnull(r);
+            ck_assert_uint_eq(array_size(r), 0);
+            array_cleanup(r);
+            ck_assert_ptr_null(table_lookup_and(t, query, 0));
+            ck_assert_ptr_null(table_lookup_and(NULL, query, 1));
+
+            ck_assert_int_eq(table_freeze(t), frozen);
+        }
+        table_cleanup(t);
+    }
+}
+END_TEST
+
 Suite *hash_table_suite(void) {
     Suite *s;
     TCase *tc_core;
@@ -104,6 +282,11 @@ Suite *hash_table_suite(void) {
     /* Regular tests. */
     tcase_add_test(tc_core, test_array_add);
     tcase_add_test(tc_core, test_array_with_resize);
+    tcase_add_test(tc_core, test_array_compressed);
+    tcase_add_test(tc_core, test_array_unique_tail);
+    tcase_add_test(tc_core, test_array_merge);
+    tcase_add_test(tc_core, test_array_lookup_batch);
+    tcase_add_test(tc_core, test_array_lookup_and);
 
     suite_add_tcase(s, tc_core);
     return s;
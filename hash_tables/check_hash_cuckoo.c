@@ -0,0 +1,154 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "array.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+/* Tests */
+
+/* test add and append with colliding hashes */
+START_TEST(test_cuckoo_add) {
+    struct table *t;
+    t = table_init_mode(8, 0.6, hash_too_simple, TABLE_CUCKOO);
+    ck_assert_ptr_nonnull(t);
+
+    ck_assert_int_eq(table_insert(t, "abc", 3), 0);
+    ck_assert_int_eq(table_insert(t, "ade", 5), 0);
+    ck_assert_int_eq(table_insert(t, "bcd", 7), 0);
+    ck_assert_int_eq(table_insert(t, "abc", 11), 0);
+
+    ck_assert_int_eq(array_get(table_lookup(t, "abc"), 0), 3);
+    ck_assert_int_eq(array_get(table_lookup(t, "abc"), 1), 11);
+    ck_assert_int_eq(array_get(table_lookup(t, "ade"), 0), 5);
+    ck_assert_int_eq(array_get(table_lookup(t, "bcd"), 0), 7);
+    ck_assert_ptr_null(table_lookup(t, "afg"));
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test growing from a single bucket, including a load factor cuckoo hashing
+ * cannot reach */
+START_TEST(test_cuckoo_resize) {
+    struct table *t;
+    double max_load_factor = 1.0;
+    t = table_init_mode(1, max_load_factor, hash_too_simple, TABLE_CUCKOO);
+    ck_assert_ptr_nonnull(t);
+
+    ck_assert_msg((int) table_load_factor(t) == 0,
+                  "Load factor of empty hash table should be 0.");
+    char key[8];
+    for (int i = 0; i < 10; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ck_assert_int_eq(table_insert(t, key, i), 0);
+        ck_assert_msg(table_load_factor(t) <= 0.9,
+                      "The load factor is clamped to 0.9.");
+    }
+    for (int i = 0; i < 10; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ck_assert_int_eq(array_get(table_lookup(t, key), 0), i);
+    }
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test that a hash function with few distinct values still fills the table
+ * well, because the buckets also depend on the second hash */
+START_TEST(test_cuckoo_weak_hash) {
+    struct table *t;
+    t = table_init_mode(16, 0.9, hash_too_simple, TABLE_CUCKOO);
+    ck_assert_ptr_nonnull(t);
+
+    char key[16];
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "s%d", i);
+        ck_assert_int_eq(table_insert(t, key, i), 0);
+    }
+    ck_assert_msg(table_load_factor(t) > 0.4,
+                  "Keys with equal hashes should not force the table to grow.");
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "s%d", i);
+        ck_assert_int_eq(array_get(table_lookup(t, key), 0), i);
+    }
+    ck_assert_ptr_null(table_lookup(t, "s20000"));
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test deleting and reinserting many keys, with a compaction in between */
+START_TEST(test_cuckoo_delete) {
+    struct table *t;
+    t = table_init_mode(4, 0.9, hash_fnv1a, TABLE_CUCKOO);
+    ck_assert_ptr_nonnull(t);
+
+    char key[8];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 7, i);
+        ck_assert_int_eq(table_insert(t, key, i), 0);
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 7, i);
+        ck_assert_int_eq(table_delete(t, key), 0);
+        ck_assert_int_eq(table_delete(t, key), 1);
+    }
+    double load_factor = table_load_factor(t);
+    ck_assert_int_eq(table_compact(t), 0);
+    ck_assert(table_load_factor(t) >= load_factor);
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 7, i);
+        if (i % 3 == 0) {
+            ck_assert_ptr_null(table_lookup(t, key));
+            ck_assert_int_eq(table_insert(t, key, -i), 0);
+        } else {
+            ck_assert_int_eq(array_get(table_lookup(t, key), 0), i);
+        }
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 7, i);
+        ck_assert_int_eq(array_get(table_lookup(t, key), 0), -i);
+    }
+
+    table_cleanup(t);
+}
+END_TEST
+
+Suite *hash_table_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Hash Table");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_cuckoo_add);
+    tcase_add_test(tc_core, test_cuckoo_resize);
+    tcase_add_test(tc_core, test_cuckoo_weak_hash);
+    tcase_add_test(tc_core, test_cuckoo_delete);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = hash_table_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
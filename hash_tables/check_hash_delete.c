@@ -2,9 +2,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "array.h"
+#include "array_ext.h"
 #include "hash_func.h"
-#include "hash_table.h"
+#include "hash_table_ext.h"
 
 // For older versions of the check library
 #ifndef ck_assert_ptr_nonnull
@@ -128,6 +128,116 @@ START_TEST(test_delete_first) {
 }
 END_TEST
 
+/* Let an incremental shrink that is still going on finish, deletes of
+ * absent keys move buckets as well. */
+static void finish_shrink(struct table *t) {
+    for (int i = 0; i < 16; i++) {
+        ck_assert_int_eq(table_delete(t, "absent"), 1);
+    }
+}
+
+/* test that deletes shrink a table down to its start capacity */
+START_TEST(test_delete_shrink) {
+    int modes[] = { TABLE_CHAINING, TABLE_CHAINING | TABLE_INCREMENTAL_RESIZE };
+    char key[32];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(8, 0.5, hash_fnv1a, modes[m]);
+        ck_assert_ptr_nonnull(t);
+        for (int i = 0; i < 1000; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(table_insert(t, key, i), 0);
+        }
+        struct table_stats stats;
+        ck_assert_int_eq(table_stats(t, &stats), 0);
+        ck_assert_uint_ge(stats.buckets, 2048);
+
+        for (int i = 0; i < 990; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(table_delete(t, key), 0);
+            ck_assert(table_load_factor(t) <= 0.5);
+        }
+        finish_shrink(t);
+        ck_assert_int_eq(table_stats(t, &stats), 0);
+        ck_assert_uint_eq(stats.keys, 10);
+        ck_assert_uint_le(stats.buckets, 80);
+        ck_assert(table_load_factor(t) >= 0.125);
+        for (int i = 990; i < 1000; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(array_get(table_lookup(t, key), 0), i);
+        }
+
+        for (int i = 990; i < 1000; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(table_delete(t, key), 0);
+        }
+        finish_shrink(t);
+        ck_assert_int_eq(table_stats(t, &stats), 0);
+        ck_assert_uint_eq(stats.buckets, 8);
+
+        ck_assert_int_eq(table_set_min_load_factor(t, 0.25), 1);
+        ck_assert_int_eq(table_set_min_load_factor(t, -1), 1);
+        ck_assert_int_eq(table_set_min_load_factor(t, 0), 0);
+        table_cleanup(t);
+    }
+}
+END_TEST
+
+/* test compacting tables of every backend after mass deletes */
+START_TEST(test_delete_compact) {
+    int modes[] = { TABLE_CHAINING, TABLE_CHAINING | TABLE_ARENA | TABLE_COMPRESSED,
+                    TABLE_CHAINING | TABLE_INCREMENTAL_RESIZE, TABLE_ROBIN_HOOD,
+                    TABLE_SWISS, TABLE_CUCKOO };
+    char key[32];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(8, 0.5, hash_fnv1a, modes[m]);
+        ck_assert_ptr_nonnull(t);
+        table_set_min_load_factor(t, 0);
+        for (int i = 0; i < 3000; i++) {
+            sprintf(key, "key%d", i % 1000);
+            ck_assert_int_eq(table_insert(t, key, i), 0);
+        }
+        for (int i = 0; i < 900; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(table_delete(t, key), 0);
+        }
+        ck_assert(table_load_factor(t) < 0.1);
+
+        struct table_stats before, after;
+        ck_assert_int_eq(table_stats(t, &before), 0);
+        ck_assert_int_eq(table_compact(t), 0);
+        ck_assert_int_eq(table_stats(t, &after), 0);
+        ck_assert(table_load_factor(t) > 0.25);
+        ck_assert(table_load_factor(t) <= 0.5);
+        ck_assert_uint_lt(after.table_bytes, before.table_bytes);
+        ck_assert_uint_eq(after.keys, 100);
+
+        for (int i = 900; i < 1000; i++) {
+            sprintf(key, "key%d", i);
+            struct array *values = table_lookup(t, key);
+            ck_assert_uint_eq(array_size(values), 3);
+            ck_assert_int_eq(array_get(values, 2), i + 2000);
+        }
+        sprintf(key, "key%d", 0);
+        ck_assert_ptr_null(table_lookup(t, key));
+        ck_assert_int_eq(table_insert(t, "new", 1), 0);
+        ck_assert_int_eq(table_insert(t, "key950", 3950), 0);
+        ck_assert_int_eq(array_get(table_lookup(t, "key950"), 3), 3950);
+        table_cleanup(t);
+    }
+
+    struct table *t = table_init(8, 0.5, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(table_compact(t), 0);
+    ck_assert_int_eq(table_insert(t, "abc", 1), 0);
+    ck_assert_int_eq(table_freeze(t), 0);
+    ck_assert_int_eq(table_compact(t), 1);
+    ck_assert_int_eq(table_compact(NULL), 1);
+    table_cleanup(t);
+}
+END_TEST
+
 Suite *hash_table_suite(void) {
     Suite *s;
     TCase *tc_core;
@@ -139,6 +249,8 @@ Suite *hash_table_suite(void) {
     tcase_add_test(tc_core, test_delete_last);
     tcase_add_test(tc_core, test_delete_middle);
     tcase_add_test(tc_core, test_delete_first);
+    tcase_add_test(tc_core, test_delete_shrink);
+    tcase_add_test(tc_core, test_delete_compact);
 
     suite_add_tcase(s, tc_core);
     return s;
@@ -0,0 +1,68 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hash_func.h"
+
+/* Tests */
+
+/* test against the reference values of the published algorithms */
+START_TEST(test_known_values) {
+    ck_assert_uint_eq(hash_fnv1a((const unsigned char *) ""), 0xcbf29ce484222325UL);
+    ck_assert_uint_eq(hash_fnv1a((const unsigned char *) "a"), 0xaf63dc4c8601ec8cUL);
+    ck_assert_uint_eq(hash_fnv1a((const unsigned char *) "foobar"), 0x85944171f73967e8UL);
+
+    ck_assert_uint_eq(hash_murmur3((const unsigned char *) ""), 0);
+    ck_assert_uint_eq(hash_murmur3((const unsigned char *) "hello"), 0x248bfa47UL);
+}
+END_TEST
+
+/* test that keys of every length path are hashed differently, and that keys
+ * with the same first letter do not collide like with hash_too_simple */
+START_TEST(test_lengths_differ) {
+    unsigned long (*hash_funcs[])(const unsigned char *) = {
+        hash_fnv1a, hash_wy64, hash_murmur3
+    };
+    const char *keys[] = { "", "s", "sp", "spe", "spec", "specie", "species",
+                           "speciesx", "specification", "specifications",
+                           "species of the same genus", "species of the same genera" };
+    size_t n_keys = sizeof(keys) / sizeof(keys[0]);
+
+    for (size_t f = 0; f < sizeof(hash_funcs) / sizeof(hash_funcs[0]); f++) {
+        for (size_t i = 0; i < n_keys; i++) {
+            unsigned long h = hash_funcs[f]((const unsigned char *) keys[i]);
+            ck_assert_uint_eq(h, hash_funcs[f]((const unsigned char *) keys[i]));
+            for (size_t j = i + 1; j < n_keys; j++) {
+                ck_assert_msg(h != hash_funcs[f]((const unsigned char *) keys[j]),
+                              "hash %zu: \"%s\" and \"%s\" collide", f, keys[i], keys[j]);
+            }
+        }
+    }
+}
+END_TEST
+
+Suite *hash_func_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Hash Functions");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_known_values);
+    tcase_add_test(tc_core, test_lengths_differ);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = hash_func_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
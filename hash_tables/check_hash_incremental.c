@@ -0,0 +1,152 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "array.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+#define INCREMENTAL (TABLE_CHAINING | TABLE_INCREMENTAL_RESIZE)
+
+/* Tests */
+
+/* test that the option is only accepted for chaining */
+START_TEST(test_incremental_init) {
+    struct table *t;
+    t = table_init_mode(2, 0.6, hash_too_simple, INCREMENTAL);
+    ck_assert_ptr_nonnull(t);
+    table_cleanup(t);
+
+    t = table_init_mode(2, 0.6, hash_too_simple, TABLE_ROBIN_HOOD | TABLE_INCREMENTAL_RESIZE);
+    ck_assert_ptr_null(t);
+}
+END_TEST
+
+/* test that keys stay reachable while buckets are being moved */
+START_TEST(test_incremental_resize) {
+    struct table *t;
+    double max_load_factor = 0.6;
+    t = table_init_mode(2, max_load_factor, hash_too_simple, INCREMENTAL);
+    ck_assert_ptr_nonnull(t);
+
+    char key[8];
+    for (int i = 0; i < 300; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 26, i);
+        ck_assert_int_eq(table_insert(t, key, i), 0);
+        ck_assert_msg(table_load_factor(t) <= max_load_factor,
+                      "Load factor cannot be higher than max load factor.");
+
+        /* Every key inserted so far must be found, wherever it is. */
+        for (int j = 0; j <= i; j += 17) {
+            snprintf(key, sizeof(key), "%c%d", 'a' + j % 26, j);
+            ck_assert_int_eq(array_get(table_lookup(t, key), 0), j);
+        }
+    }
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test appending to and deleting keys that are still in the old array */
+START_TEST(test_incremental_delete) {
+    struct table *t;
+    t = table_init_mode(64, 0.5, hash_too_simple, INCREMENTAL);
+    ck_assert_ptr_nonnull(t);
+
+    char key[8];
+    for (int i = 0; i < 33; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 26, i);
+        ck_assert_int_eq(table_insert(t, key, i), 0);
+    }
+    /* The last insert started a resize, most buckets have not moved yet. */
+    ck_assert_int_eq(table_insert(t, "z25", 100), 0);
+    ck_assert_int_eq(array_get(table_lookup(t, "z25"), 1), 100);
+
+    for (int i = 0; i < 33; i += 2) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 26, i);
+        ck_assert_int_eq(table_delete(t, key), 0);
+        ck_assert_int_eq(table_delete(t, key), 1);
+    }
+    for (int i = 0; i < 33; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 26, i);
+        if (i % 2 == 0) {
+            ck_assert_ptr_null(table_lookup(t, key));
+        } else {
+            ck_assert_int_eq(array_get(table_lookup(t, key), 0), i);
+        }
+    }
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test that keys stay reachable while deletes shrink the table */
+START_TEST(test_incremental_shrink) {
+    struct table *t;
+    t = table_init_mode(8, 0.5, hash_fnv1a, INCREMENTAL);
+    ck_assert_ptr_nonnull(t);
+
+    char key[8];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ck_assert_int_eq(table_insert(t, key, i), 0);
+    }
+    for (int i = 0; i < 990; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ck_assert_int_eq(table_delete(t, key), 0);
+
+        /* The keys left must be found, in the old or in the new array. */
+        for (int j = i + 1; j < 1000; j += 7) {
+            snprintf(key, sizeof(key), "k%d", j);
+            ck_assert_int_eq(array_get(table_lookup(t, key), 0), j);
+        }
+    }
+    ck_assert(table_load_factor(t) >= 0.125);
+
+    /* Every shrink ended before the next one started, so no delete moved
+     * many more than 2 / min load factor = 16 old buckets, instead of half
+     * of the 2048 buckets the table grew to. */
+    struct table_stats stats;
+    ck_assert_int_eq(table_stats(t, &stats), 0);
+    ck_assert_uint_gt(stats.resizes, 8);
+    ck_assert_uint_le(stats.max_moved_buckets, 32);
+
+    table_cleanup(t);
+}
+END_TEST
+
+Suite *hash_table_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Hash Table");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_incremental_init);
+    tcase_add_test(tc_core, test_incremental_resize);
+    tcase_add_test(tc_core, test_incremental_delete);
+    tcase_add_test(tc_core, test_incremental_shrink);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = hash_table_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
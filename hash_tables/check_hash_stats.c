@@ -0,0 +1,166 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "array_ext.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+/* Hash function that sends every key to the same bucket. */
+static unsigned long hash_constant(const unsigned char *key) {
+    (void)key;
+    return 7;
+}
+
+/* Tests */
+
+/* test the chain statistics and probe counters of a chained table */
+START_TEST(test_stats_chains) {
+    struct table *t = table_init(4, 100.0, hash_constant);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(table_insert(t, "a", 1), 0);
+    ck_assert_int_eq(table_insert(t, "b", 2), 0);
+    ck_assert_int_eq(table_insert(t, "c", 3), 0);
+
+    /* Lookups are only counted once counting is on. */
+    ck_assert_ptr_nonnull(table_lookup(t, "c"));
+    ck_assert_int_eq(table_count_lookups(t, 1), 0);
+    ck_assert_int_eq(table_count_lookups(NULL, 1), 1);
+
+    /* The chain is c, b, a: the newest key is in front. */
+    ck_assert_ptr_nonnull(table_lookup(t, "c"));
+    ck_assert_ptr_nonnull(table_lookup(t, "a"));
+    ck_assert_ptr_null(table_lookup(t, "d"));
+    const char *batch[] = { "b", "e" };
+    struct array *out[2];
+    ck_assert_int_eq(table_lookup_batch(t, batch, 2, out), 0);
+
+    struct table_stats stats;
+    ck_assert_int_eq(table_stats(t, &stats), 0);
+    ck_assert_uint_eq(stats.keys, 3);
+    ck_assert_uint_eq(stats.buckets, 4);
+    ck_assert_uint_eq(stats.used_buckets, 1);
+    ck_assert_uint_eq(stats.chains[0], 3);
+    ck_assert_uint_eq(stats.chains[3], 1);
+    ck_assert_uint_eq(stats.max_chain, 3);
+    ck_assert_uint_eq(stats.hits, 3);
+    ck_assert_uint_eq(stats.misses, 2);
+    ck_assert(stats.avg_hit_probes > 1.99 && stats.avg_hit_probes < 2.01);
+    ck_assert(stats.avg_miss_probes > 2.99 && stats.avg_miss_probes < 3.01);
+    ck_assert_uint_eq(stats.max_hit_probes, 3);
+    ck_assert_uint_eq(stats.max_miss_probes, 3);
+    ck_assert_uint_eq(stats.resizes, 0);
+    ck_assert_uint_eq(stats.key_bytes, 6);
+    ck_assert(stats.node_bytes > 0);
+    ck_assert_uint_eq(stats.value_bytes, 0);
+
+    ck_assert_int_eq(table_count_lookups(t, 0), 0);
+    ck_assert_ptr_nonnull(table_lookup(t, "a"));
+    ck_assert_int_eq(table_stats(t, &stats), 0);
+    ck_assert_uint_eq(stats.hits, 3);
+
+    ck_assert_int_eq(table_stats(NULL, &stats), 1);
+    ck_assert_int_eq(table_stats(t, NULL), 1);
+    table_cleanup(t);
+}
+END_TEST
+
+/* test the resize counter and the memory of growing value arrays */
+START_TEST(test_stats_resize) {
+    int modes[] = { TABLE_CHAINING, TABLE_CHAINING | TABLE_INCREMENTAL_RESIZE };
+    char key[32];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(2, 0.5, hash_fnv1a, modes[m]);
+        ck_assert_ptr_nonnull(t);
+        for (int i = 0; i < 100; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(table_insert(t, key, i), 0);
+        }
+        for (int i = 0; i < 100; i++) {
+            ck_assert_int_eq(table_insert(t, "key0", i), 0);
+        }
+
+        struct table_stats stats;
+        ck_assert_int_eq(table_stats(t, &stats), 0);
+        ck_assert_uint_eq(stats.keys, 100);
+        ck_assert_uint_ge(stats.resizes, 7);
+        ck_assert(stats.resize_seconds >= 0);
+        ck_assert_uint_ge(stats.buckets, 256);
+        ck_assert_uint_ge(stats.value_bytes, 101 * sizeof(int));
+        ck_assert_uint_ge(stats.table_bytes, stats.buckets * sizeof(void *));
+        ck_assert_uint_eq(stats.hits + stats.misses, 0);
+        table_cleanup(t);
+    }
+}
+END_TEST
+
+/* test the statistics of the other backends */
+START_TEST(test_stats_backends) {
+    int modes[] = { TABLE_ROBIN_HOOD, TABLE_SWISS, TABLE_CUCKOO, TABLE_FROZEN };
+    char key[32];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(8, 0.6, hash_fnv1a,
+                                          modes[m] == TABLE_FROZEN ? TABLE_CHAINING : modes[m]);
+        ck_assert_ptr_nonnull(t);
+        for (int i = 0; i < 50; i++) {
+            sprintf(key, "key%d", i);
+            ck_assert_int_eq(table_insert(t, key, i), 0);
+        }
+        if (modes[m] == TABLE_FROZEN) {
+            ck_assert_int_eq(table_freeze(t), 0);
+        }
+            ck_assert_int_eq(table_count_lookups(t, 1), 0);
+        ck_assert_ptr_nonnull(table_lookup(t, "key1"));
+        ck_assert_ptr_null(table_lookup(t, "key50"));
+
+        struct table_stats stats;
+        ck_assert_int_eq(table_stats(t, &stats), 0);
+        ck_assert_uint_eq(stats.keys, 50);
+        ck_assert_uint_eq(stats.buckets, 0);
+        ck_assert_uint_eq(stats.hits, 1);
+        ck_assert_uint_eq(stats.misses, 1);
+        ck_assert_uint_eq(stats.max_hit_probes, modes[m] == TABLE_FROZEN);
+        ck_assert_uint_eq(stats.key_bytes, 10 * 5 + 40 * 6);
+        ck_assert(stats.table_bytes > 0);
+        ck_assert(stats.node_bytes > 0);
+        table_cleanup(t);
+    }
+}
+END_TEST
+
+Suite *hash_stats_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Hash table statistics");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_stats_chains);
+    tcase_add_test(tc_core, test_stats_resize);
+    tcase_add_test(tc_core, test_stats_backends);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = hash_stats_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "array.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+/* Tests */
+
+/* test add and append with colliding hashes */
+START_TEST(test_swiss_add) {
+    struct table *t;
+    t = table_init_mode(8, 0.6, hash_too_simple, TABLE_SWISS);
+    ck_assert_ptr_nonnull(t);
+
+    ck_assert_int_eq(table_insert(t, "abc", 3), 0);
+    ck_assert_int_eq(table_insert(t, "ade", 5), 0);
+    ck_assert_int_eq(table_insert(t, "bcd", 7), 0);
+    ck_assert_int_eq(table_insert(t, "abc", 11), 0);
+
+    ck_assert_int_eq(array_get(table_lookup(t, "abc"), 0), 3);
+    ck_assert_int_eq(array_get(table_lookup(t, "abc"), 1), 11);
+    ck_assert_int_eq(array_get(table_lookup(t, "ade"), 0), 5);
+    ck_assert_int_eq(array_get(table_lookup(t, "bcd"), 0), 7);
+    ck_assert_ptr_null(table_lookup(t, "afg"));
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test growing from a single group, including a load factor open addressing
+ * cannot reach */
+START_TEST(test_swiss_resize) {
+    struct table *t;
+    double max_load_factor = 1.0;
+    t = table_init_mode(2, max_load_factor, hash_too_simple, TABLE_SWISS);
+    ck_assert_ptr_nonnull(t);
+
+    ck_assert_msg((int) table_load_factor(t) == 0,
+                  "Load factor of empty hash table should be 0.");
+    ck_assert_int_eq(table_insert(t, "ba", 4), 0);
+    ck_assert_int_eq(table_insert(t, "cd", 9), 0);
+    ck_assert_int_eq(table_insert(t, "fe", 22), 0);
+    ck_assert_int_eq(table_insert(t, "gh", 17), 0);
+    ck_assert_msg(table_load_factor(t) < max_load_factor,
+                  "Open addressing needs at least one free slot.");
+
+    ck_assert_int_eq(array_get(table_lookup(t, "ba"), 0), 4);
+    ck_assert_int_eq(array_get(table_lookup(t, "cd"), 0), 9);
+    ck_assert_int_eq(array_get(table_lookup(t, "fe"), 0), 22);
+    ck_assert_int_eq(array_get(table_lookup(t, "gh"), 0), 17);
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test that deleting keys with the same tag keeps the others reachable */
+START_TEST(test_swiss_delete) {
+    struct table *t;
+    t = table_init_mode(16, 0.6, hash_too_simple, TABLE_SWISS);
+    ck_assert_ptr_nonnull(t);
+
+    ck_assert_int_eq(table_insert(t, "abc", 3), 0);
+    ck_assert_int_eq(table_insert(t, "ade", 5), 0);
+    ck_assert_int_eq(table_insert(t, "bcd", 7), 0);
+    ck_assert_int_eq(table_insert(t, "afg", 11), 0);
+
+    ck_assert_int_eq(table_delete(t, "ade"), 0);
+    ck_assert_int_eq(table_delete(t, "ade"), 1);
+
+    ck_assert_int_eq(array_get(table_lookup(t, "abc"), 0), 3);
+    ck_assert_int_eq(array_get(table_lookup(t, "bcd"), 0), 7);
+    ck_assert_int_eq(array_get(table_lookup(t, "afg"), 0), 11);
+    ck_assert_ptr_null(table_lookup(t, "ade"));
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test many keys with equal tags, so probing has to cross full groups */
+START_TEST(test_swiss_many) {
+    struct table *t;
+    t = table_init_mode(4, 0.8, hash_too_simple, TABLE_SWISS);
+    ck_assert_ptr_nonnull(t);
+
+    char key[8];
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 7, i);
+        ck_assert_int_eq(table_insert(t, key, i), 0);
+    }
+    for (int i = 0; i < 500; i += 3) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 7, i);
+        ck_assert_int_eq(table_delete(t, key), 0);
+    }
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "%c%d", 'a' + i % 7, i);
+        if (i % 3 == 0) {
+            ck_assert_ptr_null(table_lookup(t, key));
+        } else {
+            ck_assert_int_eq(array_get(table_lookup(t, key), 0), i);
+        }
+    }
+
+    table_cleanup(t);
+}
+END_TEST
+
+/* test that deleted slots are reused without losing keys */
+START_TEST(test_swiss_reinsert) {
+    struct table *t;
+    t = table_init_mode(16, 0.875, hash_too_simple, TABLE_SWISS);
+    ck_assert_ptr_nonnull(t);
+
+    char key[8];
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 40; i++) {
+            snprintf(key, sizeof(key), "k%d", i);
+            ck_assert_int_eq(table_insert(t, key, round), 0);
+        }
+        for (int i = 0; i < 40; i++) {
+            snprintf(key, sizeof(key), "k%d", i);
+            ck_assert_int_eq(array_get(table_lookup(t, key), 0), round);
+            ck_assert_int_eq(table_delete(t, key), 0);
+        }
+        ck_assert_msg((int) table_load_factor(t) == 0,
+                      "All keys were deleted.");
+    }
+
+    table_cleanup(t);
+}
+END_TEST
+
+Suite *hash_table_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Hash Table");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_swiss_add);
+    tcase_add_test(tc_core, test_swiss_resize);
+    tcase_add_test(tc_core, test_swiss_delete);
+    tcase_add_test(tc_core, test_swiss_many);
+    tcase_add_test(tc_core, test_swiss_reinsert);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = hash_table_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
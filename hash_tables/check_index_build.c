@@ -0,0 +1,151 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_ext.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+#include "index_build.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+#define TEXT_LINES 2000
+
+/* Counts the keys of the table in ctx and compares their values with those
+ * of the reference table. */
+struct compare {
+    const struct table *reference;
+    unsigned long keys;
+};
+
+static int compare_key(void *ctx, const char *key, struct array *values) {
+    struct compare *c = ctx;
+    struct array *expected = table_lookup(c->reference, key);
+    ck_assert_ptr_nonnull(expected);
+    ck_assert_uint_eq(array_size(values), array_size(expected));
+
+    struct array_cursor a, b;
+    int x, y;
+    array_cursor_init(&a, values);
+    array_cursor_init(&b, expected);
+    while (array_cursor_next(&a, &x)) {
+        ck_assert_int_eq(array_cursor_next(&b, &y), 1);
+        ck_assert_int_eq(x, y);
+    }
+    c->keys++;
+    return 0;
+}
+
+static unsigned long count_keys(const struct table *t) {
+    struct compare c = { t, 0 };
+    ck_assert_int_eq(table_foreach(t, compare_key, &c), 0);
+    return c.keys;
+}
+
+/* Fill text with lines of pseudo random words from a small vocabulary, with
+ * some empty lines and no newline at the end. Returns the text size. */
+static size_t make_text(char *text) {
+    const char *words[] = { "the", "Origin", "of", "species", "by", "means",
+                            "natural", "selection", "x", "preservation" };
+    size_t size = 0;
+    unsigned int state = 12345;
+
+    for (int line = 0; line < TEXT_LINES; line++) {
+        state = state * 1103515245u + 12345u;
+        unsigned int n_words = (state >> 16) % 7;
+        for (unsigned int w = 0; w < n_words; w++) {
+            state = state * 1103515245u + 12345u;
+            size += (size_t)sprintf(text + size, "%s%s", words[(state >> 16) % 10],
+                                    w + 1 < n_words ? ", " : "");
+        }
+        if (line + 1 < TEXT_LINES) {
+            text[size++] = '\n';
+        }
+    }
+    return size;
+}
+
+/* Tests */
+
+/* test that every thread count gives the same index as a single thread */
+START_TEST(test_build_threads) {
+    static char text[TEXT_LINES * 100];
+    size_t size = make_text(text);
+    const int modes[] = { TABLE_CHAINING, TABLE_CHAINING | TABLE_ARENA | TABLE_COMPRESSED,
+                          TABLE_ROBIN_HOOD, TABLE_SWISS, TABLE_CUCKOO };
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *single = index_build((const unsigned char *)text, size, 1, 16, 0.6,
+                                           hash_fnv1a, modes[m]);
+        ck_assert_ptr_nonnull(single);
+        unsigned long keys = count_keys(single);
+        ck_assert_uint_eq(keys, 10);
+        ck_assert_int_eq(array_last(table_lookup(single, "origin")) <= TEXT_LINES, 1);
+
+        for (int threads = 2; threads <= 9; threads++) {
+            struct table *t = index_build((const unsigned char *)text, size, threads, 16, 0.6,
+                                          hash_fnv1a, modes[m]);
+            ck_assert_ptr_nonnull(t);
+            struct compare c = { single, 0 };
+            ck_assert_int_eq(table_foreach(t, compare_key, &c), 0);
+            ck_assert_uint_eq(c.keys, keys);
+            table_cleanup(t);
+        }
+        table_cleanup(single);
+    }
+}
+END_TEST
+
+/* test texts with fewer lines than threads, and an empty text */
+START_TEST(test_build_small) {
+    const char text[] = "a b\n\nb c a";
+    struct table *t = index_build((const unsigned char *)text, sizeof(text) - 1, 8, 4, 0.6,
+                                  hash_too_simple, TABLE_CHAINING);
+    ck_assert_ptr_nonnull(t);
+
+    struct array *a = table_lookup(t, "a");
+    ck_assert_uint_eq(array_size(a), 2);
+    ck_assert_int_eq(array_get(a, 0), 1);
+    ck_assert_int_eq(array_get(a, 1), 3);
+    ck_assert_int_eq(array_get(table_lookup(t, "c"), 0), 3);
+    table_cleanup(t);
+
+    t = index_build(NULL, 0, 4, 4, 0.6, hash_too_simple, TABLE_CHAINING);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_ptr_null(table_lookup(t, "a"));
+    table_cleanup(t);
+}
+END_TEST
+
+Suite *index_build_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Index build");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_build_threads);
+    tcase_add_test(tc_core, test_build_small);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = index_build_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,244 @@
+#include <check.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_ext.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+#define INDEX_FILE "check_index_file.idx"
+
+/* Compare the values of a key with those of the same key in the table in
+ * ctx, counting the keys in the table's place in keys. */
+struct compare {
+    const struct table *reference;
+    unsigned long keys;
+};
+
+static int compare_key(void *ctx, const char *key, struct array *values) {
+    struct compare *c = ctx;
+    struct array *expected = table_lookup(c->reference, key);
+    ck_assert_ptr_nonnull(expected);
+    ck_assert_uint_eq(array_size(values), array_size(expected));
+    ck_assert_int_eq(array_last(values), array_last(expected));
+
+    struct array_cursor a, b;
+    int x, y;
+    array_cursor_init(&a, values);
+    array_cursor_init(&b, expected);
+    while (array_cursor_next(&a, &x)) {
+        ck_assert_int_eq(array_cursor_next(&b, &y), 1);
+        ck_assert_int_eq(x, y);
+    }
+    c->keys++;
+    return 0;
+}
+
+/* Accept any key, for walks over a file that only stop at damage. */
+static int any_key(void *ctx, const char *key, struct array *values) {
+    (void)ctx;
+    (void)key;
+    (void)values;
+    return 0;
+}
+
+/* Tests */
+
+/* test saving and loading tables of every backend */
+START_TEST(test_index_round_trip) {
+    int modes[] = { TABLE_CHAINING, TABLE_CHAINING | TABLE_ARENA | TABLE_COMPRESSED,
+                    TABLE_ROBIN_HOOD, TABLE_SWISS, TABLE_CUCKOO };
+    char key[32];
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct table *t = table_init_mode(8, 0.6, hash_too_simple, modes[m]);
+        ck_assert_ptr_nonnull(t);
+        for (int i = 0; i < 500; i++) {
+            sprintf(key, "key%d", i % 170);
+            ck_assert_int_eq(table_insert(t, key, i * 1000), 0);
+        }
+        ck_assert_int_eq(table_save(t, INDEX_FILE), 0);
+
+        struct table *loaded = table_load(INDEX_FILE, hash_too_simple);
+        ck_assert_ptr_nonnull(loaded);
+        struct compare c = { t, 0 };
+        ck_assert_int_eq(table_foreach(loaded, compare_key, &c), 0);
+        ck_assert_uint_eq(c.keys, 170);
+
+        ck_assert_int_eq(array_get(table_lookup(loaded, "key3"), 2), 343000);
+        ck_assert_ptr_null(table_lookup(loaded, "key170"));
+        ck_assert(table_load_factor(loaded) <= 0.5);
+
+        const char *batch[] = { "key1", "nope", "key169" };
+        struct array *out[3];
+        ck_assert_int_eq(table_lookup_batch(loaded, batch, 3, out), 0);
+        ck_assert_ptr_eq(out[0], table_lookup(loaded, "key1"));
+        ck_assert_ptr_null(out[1]);
+        ck_assert_int_eq(array_get(out[2], 0), 169000);
+
+        table_cleanup(loaded);
+        table_cleanup(t);
+    }
+    remove(INDEX_FILE);
+}
+END_TEST
+
+/* test that loaded tables are read-only */
+START_TEST(test_index_read_only) {
+    struct table *t = table_init(4, 0.6, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(table_insert(t, "abc", 1), 0);
+    ck_assert_int_eq(table_save(t, INDEX_FILE), 0);
+    table_cleanup(t);
+
+    t = table_load(INDEX_FILE, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(table_insert(t, "abc", 2), 1);
+    ck_assert_int_eq(table_insert(t, "def", 2), 1);
+    ck_assert_int_eq(table_delete(t, "abc"), -1);
+    ck_assert_int_eq(array_append(table_lookup(t, "abc"), 2), 1);
+    ck_assert_uint_eq(array_size(table_lookup(t, "abc")), 1);
+    table_cleanup(t);
+    remove(INDEX_FILE);
+}
+END_TEST
+
+/* test empty tables, other hash functions and files that are no index */
+START_TEST(test_index_invalid) {
+    struct table *t = table_init(4, 0.6, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(table_save(t, INDEX_FILE), 0);
+    table_cleanup(t);
+
+    ck_assert_ptr_null(table_load(INDEX_FILE, hash_too_simple));
+    t = table_load(INDEX_FILE, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_ptr_null(table_lookup(t, "abc"));
+    table_cleanup(t);
+
+    FILE *f = fopen(INDEX_FILE, "w");
+    ck_assert_ptr_nonnull(f);
+    fputs("not an index file, but long enough to hold a header of 64 bytes....", f);
+    fclose(f);
+    ck_assert_ptr_null(table_load(INDEX_FILE, hash_fnv1a));
+    ck_assert_ptr_null(table_load("does_not_exist.idx", hash_fnv1a));
+    remove(INDEX_FILE);
+}
+END_TEST
+
+/* Write file with size bytes of data. */
+static void write_file(const char *file, const unsigned char *data, size_t size) {
+    FILE *f = fopen(file, "wb");
+    ck_assert_ptr_nonnull(f);
+    ck_assert_uint_eq(fwrite(data, 1, size, f), size);
+    fclose(f);
+}
+
+/* test that files with damaged records are rejected when they are opened */
+START_TEST(test_index_corrupt) {
+    struct table *t = table_init_mode(4, 0.6, hash_fnv1a, TABLE_CHAINING | TABLE_COMPRESSED);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(table_insert(t, "abc", 1), 0);
+    ck_assert_int_eq(table_insert(t, "abc", 300), 0);
+    ck_assert_int_eq(table_save(t, INDEX_FILE), 0);
+    table_cleanup(t);
+
+    FILE *f = fopen(INDEX_FILE, "rb");
+    ck_assert_ptr_nonnull(f);
+    unsigned char good[4096];
+    size_t size = fread(good, 1, sizeof(good), f);
+    fclose(f);
+    ck_assert_uint_lt(size, sizeof(good));
+
+    /* The header holds the number of slots and the offset of the slots at
+     * bytes 24 and 32, a slot holds a hash and the offset of its record. */
+    uint64_t n_slots, slots_offset, record = 0, *slot = NULL;
+    unsigned char bad[4096];
+    memcpy(&n_slots, good + 24, 8);
+    memcpy(&slots_offset, good + 32, 8);
+    for (uint64_t i = 0; i < n_slots && record == 0; i++) {
+        memcpy(&record, good + slots_offset + 16 * i + 8, 8);
+        slot = (uint64_t *)(void *)(bad + slots_offset + 16 * i + 8);
+    }
+    ck_assert_uint_ne(record, 0);
+
+    /* Record offset past the records, caught by the checks at open */
+    memcpy(bad, good, size);
+    uint64_t past = slots_offset + 8;
+    memcpy(slot, &past, 8);
+    write_file(INDEX_FILE, bad, size);
+    ck_assert_ptr_null(table_load(INDEX_FILE, hash_fnv1a));
+
+    /* Header with a changed number of keys, caught by its checksum */
+    memcpy(bad, good, size);
+    bad[16]++;
+    write_file(INDEX_FILE, bad, size);
+    ck_assert_ptr_null(table_load(INDEX_FILE, hash_fnv1a));
+
+    /* Key without its NUL, at the record after the key and image sizes.
+     * Records are only checked by lookups, which do not find the key. */
+    memcpy(bad, good, size);
+    bad[record + 8 + 3] = 'd';
+    write_file(INDEX_FILE, bad, size);
+    t = table_load(INDEX_FILE, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_ptr_null(table_lookup(t, "abc"));
+    table_cleanup(t);
+
+    /* Image with more data than its record, n_bytes follows the count */
+    memcpy(bad, good, size);
+    bad[record + 16 + 4] = 0xff;
+    write_file(INDEX_FILE, bad, size);
+    t = table_load(INDEX_FILE, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_ptr_null(table_lookup(t, "abc"));
+    ck_assert_int_ne(table_foreach(t, any_key, NULL), 0);
+    table_cleanup(t);
+
+    /* The undamaged file still opens */
+    write_file(INDEX_FILE, good, size);
+    t = table_load(INDEX_FILE, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(array_get(table_lookup(t, "abc"), 1), 300);
+    table_cleanup(t);
+    remove(INDEX_FILE);
+}
+END_TEST
+
+Suite *index_file_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Index file");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_index_round_trip);
+    tcase_add_test(tc_core, test_index_read_only);
+    tcase_add_test(tc_core, test_index_invalid);
+    tcase_add_test(tc_core, test_index_corrupt);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = index_file_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
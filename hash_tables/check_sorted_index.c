@@ -0,0 +1,206 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "hash_func.h"
+#include "hash_table_ext.h"
+#include "sorted_index.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+/* Keys visited by collect, in order. */
+struct visited {
+    char keys[64][16];
+    int values[64];
+    int n;
+};
+
+/* Record a visited key and its first value. */
+static int collect(void *ctx, const char *key, struct array *values) {
+    struct visited *v = ctx;
+    ck_assert_int_lt(v->n, 64);
+    snprintf(v->keys[v->n], sizeof(v->keys[0]), "%s", key);
+    v->values[v->n] = array_get(values, 0);
+    v->n++;
+    return 0;
+}
+
+/* Stop after the first key. */
+static int stop(void *ctx, const char *key, struct array *values) {
+    (void)ctx;
+    (void)key;
+    (void)values;
+    return 7;
+}
+
+/* Keys that share long prefixes, and a byte above 127 */
+static const char *keys[] = { "evolution", "evolve", "evolved", "eve", "ev", "abcdefgh",
+                              "abcdefghz", "abcdefgh1", "zebra", "\xe9t\xe9", "a" };
+#define N_KEYS (sizeof(keys) / sizeof(keys[0]))
+
+#define INDEX_FILE "check_sorted_index.idx"
+
+/* Return a table with all keys, saved to a file and loaded again if load is
+ * set, so the index uses the order stored in the file. */
+static struct table *keys_table(unsigned long (*hash_func)(const unsigned char *), int mode,
+                                int load) {
+    struct table *t = table_init_mode(4, 0.6, hash_func, mode);
+    ck_assert_ptr_nonnull(t);
+    for (int i = 0; i < (int)N_KEYS; i++) {
+        ck_assert_int_eq(table_insert(t, keys[i], i), 0);
+    }
+    if (load) {
+        ck_assert_int_eq(table_save(t, INDEX_FILE), 0);
+        table_cleanup(t);
+        t = table_load(INDEX_FILE, hash_func);
+        ck_assert_ptr_nonnull(t);
+        remove(INDEX_FILE);
+    }
+    unsigned long n_keys;
+    ck_assert_int_eq(table_key_order(t, &n_keys), load);
+    return t;
+}
+
+/* Check prefix and range queries on the index of a table with all keys. */
+static void check_queries(const struct table *t) {
+    struct sorted_index *s = sorted_index_build(t);
+    ck_assert_ptr_nonnull(s);
+
+    struct visited v = { .n = 0 };
+    ck_assert_int_eq(sorted_index_prefix(s, "evol", collect, &v), 0);
+    ck_assert_int_eq(v.n, 3);
+    ck_assert_str_eq(v.keys[0], "evolution");
+    ck_assert_str_eq(v.keys[1], "evolve");
+    ck_assert_str_eq(v.keys[2], "evolved");
+
+    v.n = 0;
+    ck_assert_int_eq(sorted_index_prefix(s, "abcdefgh", collect, &v), 0);
+    ck_assert_int_eq(v.n, 3);
+    ck_assert_str_eq(v.keys[0], "abcdefgh");
+    ck_assert_str_eq(v.keys[1], "abcdefgh1");
+
+    v.n = 0;
+    ck_assert_int_eq(sorted_index_prefix(s, "evolz", collect, &v), 0);
+    ck_assert_int_eq(sorted_index_prefix(s, "zz", collect, &v), 0);
+    ck_assert_int_eq(v.n, 0);
+    ck_assert_int_eq(sorted_index_prefix(s, "", collect, &v), 0);
+    ck_assert_int_eq(v.n, (int)N_KEYS);
+
+    v.n = 0;
+    ck_assert_int_eq(sorted_index_range(s, "b", "evolve", collect, &v), 0);
+    ck_assert_int_eq(v.n, 3);
+    ck_assert_str_eq(v.keys[0], "ev");
+    ck_assert_str_eq(v.keys[2], "evolution");
+
+    v.n = 0;
+    ck_assert_int_eq(sorted_index_range(s, "evolved", NULL, collect, &v), 0);
+    ck_assert_int_eq(v.n, 3);
+    ck_assert_int_eq(sorted_index_range(s, "z", "b", collect, &v), 0);
+    ck_assert_int_eq(v.n, 3);
+
+    ck_assert_int_eq(sorted_index_prefix(s, "e", stop, NULL), 7);
+    ck_assert_int_eq(sorted_index_range(s, NULL, NULL, stop, NULL), 7);
+
+    sorted_index_cleanup(s);
+}
+
+/* Tests */
+
+/* test that all keys are visited in strcmp order, for every backend */
+START_TEST(test_sorted_order) {
+    int modes[] = { TABLE_CHAINING, TABLE_ROBIN_HOOD, TABLE_SWISS, TABLE_CUCKOO, TABLE_FROZEN,
+                    TABLE_MAPPED };
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        int base = modes[m] == TABLE_FROZEN || modes[m] == TABLE_MAPPED ? TABLE_CHAINING
+                                                                         : modes[m];
+        struct table *t = keys_table(hash_too_simple, base, modes[m] == TABLE_MAPPED);
+        if (modes[m] == TABLE_FROZEN) {
+            ck_assert_int_eq(table_freeze(t), 0);
+        }
+
+        struct sorted_index *s = sorted_index_build(t);
+        ck_assert_ptr_nonnull(s);
+        ck_assert_uint_eq(sorted_index_size(s), N_KEYS);
+
+        struct visited v = { .n = 0 };
+        ck_assert_int_eq(sorted_index_range(s, NULL, NULL, collect, &v), 0);
+        ck_assert_int_eq(v.n, (int)N_KEYS);
+        for (int i = 1; i < v.n; i++) {
+            ck_assert_int_lt(strcmp(v.keys[i - 1], v.keys[i]), 0);
+        }
+        for (int i = 0; i < v.n; i++) {
+            ck_assert_str_eq(keys[v.values[i]], v.keys[i]);
+        }
+        ck_assert_str_eq(v.keys[0], "a");
+        ck_assert_str_eq(v.keys[N_KEYS - 1], "\xe9t\xe9");
+
+        sorted_index_cleanup(s);
+        table_cleanup(t);
+    }
+}
+END_TEST
+
+/* test prefix and range queries, on a table and on the order in its file */
+START_TEST(test_sorted_queries) {
+    for (int load = 0; load < 2; load++) {
+        struct table *t = keys_table(hash_fnv1a, TABLE_CHAINING, load);
+        check_queries(t);
+        table_cleanup(t);
+    }
+
+    struct table *t = table_init(8, 0.6, hash_fnv1a);
+    struct sorted_index *s = sorted_index_build(t);
+    ck_assert_ptr_nonnull(s);
+    ck_assert_uint_eq(sorted_index_size(s), 0);
+    ck_assert_int_eq(sorted_index_prefix(s, "", stop, NULL), 0);
+    sorted_index_cleanup(s);
+
+    ck_assert_int_eq(table_save(t, INDEX_FILE), 0);
+    table_cleanup(t);
+    t = table_load(INDEX_FILE, hash_fnv1a);
+    ck_assert_ptr_nonnull(t);
+    remove(INDEX_FILE);
+    s = sorted_index_build(t);
+    ck_assert_ptr_nonnull(s);
+    ck_assert_uint_eq(sorted_index_size(s), 0);
+    ck_assert_int_eq(sorted_index_range(s, NULL, NULL, stop, NULL), 0);
+    sorted_index_cleanup(s);
+    table_cleanup(t);
+    ck_assert_ptr_null(sorted_index_build(NULL));
+}
+END_TEST
+
+Suite *sorted_index_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Sorted index");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_sorted_order);
+    tcase_add_test(tc_core, test_sorted_queries);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = sorted_index_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
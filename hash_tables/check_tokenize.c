@@ -0,0 +1,156 @@
+#include <check.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tokenize.h"
+
+#define MAX_WORDS 16
+
+struct collected {
+    char words[MAX_WORDS][128];
+    unsigned long lines[MAX_WORDS];
+    size_t n;
+};
+
+static int collect(void *ctx, const char *word, size_t len, unsigned long line_number) {
+    struct collected *c = ctx;
+    ck_assert_uint_eq(strlen(word), len);
+    ck_assert_uint_lt(c->n, MAX_WORDS);
+    memcpy(c->words[c->n], word, len + 1);
+    c->lines[c->n] = line_number;
+    c->n++;
+    return 0;
+}
+
+static int stop_at_second(void *ctx, const char *word, size_t len, unsigned long line_number) {
+    (void)word;
+    (void)len;
+    (void)line_number;
+    int *count = ctx;
+    return ++*count == 2 ? 7 : 0;
+}
+
+/* Tests */
+
+/* test lowercasing, delimiters and line numbers */
+START_TEST(test_tokenize_lines) {
+    const char text[] = "The Origin,of\n\nspecies--BY\tmeans\xe9of\nx";
+    struct collected c = { .n = 0 };
+
+    /* Without the NUL byte, the text does not end with a delimiter. */
+    ck_assert_int_eq(tokenize((const unsigned char *)text, sizeof(text) - 1, 5, collect, &c), 0);
+
+    const char *words[] = { "the", "origin", "of", "species", "by", "means", "of", "x" };
+    unsigned long lines[] = { 5, 5, 5, 7, 7, 7, 7, 8 };
+    ck_assert_uint_eq(c.n, 8);
+    for (size_t i = 0; i < c.n; i++) {
+        ck_assert_str_eq(c.words[i], words[i]);
+        ck_assert_uint_eq(c.lines[i], lines[i]);
+    }
+}
+END_TEST
+
+/* test words longer than the initial word buffer */
+START_TEST(test_tokenize_long_word) {
+    char text[201];
+    memset(text, 'A', 100);
+    text[100] = ' ';
+    memset(text + 101, 'b', 100);
+    struct collected c = { .n = 0 };
+
+    ck_assert_int_eq(tokenize((const unsigned char *)text, sizeof(text), 1, collect, &c), 0);
+    ck_assert_uint_eq(c.n, 2);
+    ck_assert_uint_eq(strlen(c.words[0]), 100);
+    ck_assert_int_eq(c.words[0][99], 'a');
+    ck_assert_uint_eq(strlen(c.words[1]), 100);
+}
+END_TEST
+
+/* test that a non-zero return value stops tokenizing */
+START_TEST(test_tokenize_stop) {
+    const char text[] = "one two three";
+    int count = 0;
+
+    ck_assert_int_eq(tokenize((const unsigned char *)text, sizeof(text) - 1, 1,
+                              stop_at_second, &count), 7);
+    ck_assert_int_eq(count, 2);
+}
+END_TEST
+
+/* test the block classifier against isalpha and tolower for every byte */
+START_TEST(test_fold_letters) {
+    unsigned char src[256];
+    unsigned char dst[64];
+    for (int i = 0; i < 256; i++) {
+        src[i] = (unsigned char)i;
+    }
+
+    /* Odd lengths also exercise the scalar tail. */
+    for (size_t start = 0; start < 256; start += 61) {
+        size_t n = 256 - start < 64 ? 256 - start : 64;
+        uint64_t newlines;
+        uint64_t letters = fold_letters(src + start, dst, n, &newlines);
+
+        for (size_t i = 0; i < n; i++) {
+            int c = src[start + i];
+            int letter = c < 128 && isalpha(c);
+            ck_assert_int_eq((int)(letters >> i & 1), letter);
+            ck_assert_int_eq((int)(newlines >> i & 1), c == '\n');
+            ck_assert_int_eq(dst[i], letter ? tolower(c) : ' ');
+        }
+        ck_assert_uint_eq(n == 64 ? 0 : letters >> n, 0);
+    }
+}
+END_TEST
+
+/* test words and newlines around the 64 byte blocks */
+START_TEST(test_tokenize_blocks) {
+    char text[200];
+    memset(text, '\n', sizeof(text));
+    memcpy(text + 60, "Across", 6);
+    memcpy(text + 124, "ab", 2);
+    memcpy(text + 128, "Edge", 4);
+    memcpy(text + 196, "Last", 4);
+    struct collected c = { .n = 0 };
+
+    ck_assert_int_eq(tokenize((const unsigned char *)text, sizeof(text), 1, collect, &c), 0);
+
+    const char *words[] = { "across", "ab", "edge", "last" };
+    unsigned long lines[] = { 61, 119, 121, 185 };
+    ck_assert_uint_eq(c.n, 4);
+    for (size_t i = 0; i < c.n; i++) {
+        ck_assert_str_eq(c.words[i], words[i]);
+        ck_assert_uint_eq(c.lines[i], lines[i]);
+    }
+}
+END_TEST
+
+Suite *tokenize_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Tokenize");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_tokenize_lines);
+    tcase_add_test(tc_core, test_tokenize_long_word);
+    tcase_add_test(tc_core, test_tokenize_stop);
+    tcase_add_test(tc_core, test_fold_letters);
+    tcase_add_test(tc_core, test_tokenize_blocks);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = tokenize_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#include <check.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "typed_tables.h"
+
+// For older versions of the check library
+#ifndef ck_assert_ptr_nonnull
+#define ck_assert_ptr_nonnull(X) _ck_assert_ptr(X, !=, NULL)
+#endif
+#ifndef ck_assert_ptr_null
+#define ck_assert_ptr_null(X) _ck_assert_ptr(X, ==, NULL)
+#endif
+
+/* Add up the keys and the number of values of a u64 table. */
+struct sums {
+    uint64_t keys;
+    unsigned long values;
+};
+
+static int sum_u64(void *ctx, uint64_t key, struct array *values) {
+    struct sums *s = ctx;
+    s->keys += key;
+    s->values += array_size(values);
+    return 0;
+}
+
+/* Make a 16 byte key from a number. */
+static struct key16 make_key16(unsigned int n) {
+    struct key16 key;
+    memset(key.bytes, 0xab, sizeof(key.bytes));
+    memcpy(key.bytes + 5, &n, sizeof(n));
+    return key;
+}
+
+/* Tests */
+
+/* test inserting, looking up and appending values with 32 bit keys */
+START_TEST(test_typed_u32) {
+    struct u32_table *t = u32_table_init(4, 0.8);
+    ck_assert_ptr_nonnull(t);
+    for (int i = 0; i < 3000; i++) {
+        ck_assert_int_eq(u32_table_insert(t, (uint32_t)(i % 1000) * 4096, i), 0);
+    }
+    ck_assert_uint_eq(u32_table_size(t), 1000);
+    ck_assert(u32_table_load_factor(t) <= 0.8);
+
+    struct array *values = u32_table_lookup(t, 7 * 4096);
+    ck_assert_ptr_nonnull(values);
+    ck_assert_uint_eq(array_size(values), 3);
+    ck_assert_int_eq(array_get(values, 0), 7);
+    ck_assert_int_eq(array_get(values, 2), 2007);
+    ck_assert_ptr_null(u32_table_lookup(t, 7));
+    ck_assert_ptr_null(u32_table_lookup(t, 1000 * 4096));
+
+    /* Key 0 is a key like any other */
+    ck_assert_int_eq(array_get(u32_table_lookup(t, 0), 1), 1000);
+
+    u32_table_cleanup(t);
+    ck_assert_ptr_null(u32_table_init(0, 0.8));
+    ck_assert_ptr_null(u32_table_init(4, 0));
+}
+END_TEST
+
+/* test deleting keys, with the entries behind them shifted back */
+START_TEST(test_typed_u64_delete) {
+    struct u64_table *t = u64_table_init(8, 0.9);
+    ck_assert_ptr_nonnull(t);
+    for (uint64_t i = 0; i < 2000; i++) {
+        ck_assert_int_eq(u64_table_insert(t, i << 40, (int)i), 0);
+    }
+    for (uint64_t i = 0; i < 2000; i += 2) {
+        ck_assert_int_eq(u64_table_delete(t, i << 40), 0);
+    }
+    ck_assert_int_eq(u64_table_delete(t, 0), 1);
+    ck_assert_uint_eq(u64_table_size(t), 1000);
+    for (uint64_t i = 0; i < 2000; i++) {
+        struct array *values = u64_table_lookup(t, i << 40);
+        if (i % 2 == 0) {
+            ck_assert_ptr_null(values);
+        } else {
+            ck_assert_ptr_nonnull(values);
+            ck_assert_int_eq(array_get(values, 0), (int)i);
+        }
+    }
+
+    struct sums s = { 0, 0 };
+    ck_assert_int_eq(u64_table_foreach(t, sum_u64, &s), 0);
+    ck_assert_uint_eq(s.keys, (uint64_t)1000 * 1000 << 40);
+    ck_assert_uint_eq(s.values, 1000);
+
+    ck_assert_int_eq(u64_table_delete(NULL, 1), -1);
+    u64_table_cleanup(t);
+}
+END_TEST
+
+/* test fixed length byte keys */
+START_TEST(test_typed_key16) {
+    struct key16_table *t = key16_table_init(16, 0.7);
+    ck_assert_ptr_nonnull(t);
+    for (unsigned int i = 0; i < 500; i++) {
+        ck_assert_int_eq(key16_table_insert(t, make_key16(i), (int)i), 0);
+        ck_assert_int_eq(key16_table_insert(t, make_key16(i), (int)i + 1), 0);
+    }
+    ck_assert_uint_eq(key16_table_size(t), 500);
+
+    struct array *values = key16_table_lookup(t, make_key16(123));
+    ck_assert_ptr_nonnull(values);
+    ck_assert_uint_eq(array_size(values), 2);
+    ck_assert_int_eq(array_get(values, 1), 124);
+
+    struct key16 other = make_key16(123);
+    other.bytes[15] = 0;
+    ck_assert_ptr_null(key16_table_lookup(t, other));
+    ck_assert_int_eq(key16_table_delete(t, make_key16(123)), 0);
+    ck_assert_ptr_null(key16_table_lookup(t, make_key16(123)));
+    ck_assert_uint_eq(key16_table_size(t), 499);
+    key16_table_cleanup(t);
+}
+END_TEST
+
+Suite *typed_table_suite(void) {
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Typed table");
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_typed_u32);
+    tcase_add_test(tc_core, test_typed_u64_delete);
+    tcase_add_test(tc_core, test_typed_key16);
+
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void) {
+    int number_failed;
+    Suite *s = typed_table_suite();
+    SRunner *sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,621 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file implements a chained hash table that many threads can use at
+ * the same time. Writers lock the stripe of the key, one of STRIPES mutexes;
+ * the number of buckets is always a multiple of STRIPES, so every bucket
+ * belongs to exactly one stripe. Lookups take no lock. Bucket heads, next
+ * pointers and value blocks are published with release stores, so a lookup
+ * only ever sees fully initialised nodes. The values of a key live in a block
+ * that writers only append to; a full block is replaced by a copy twice its
+ * size. A resize locks all stripes and builds a new bucket array out of
+ * copies of the nodes, so lookups that still walk the old array see intact
+ * chains.
+ *
+ * Unlinked nodes, replaced value blocks and old bucket arrays are retired
+ * instead of freed, using epoch based reclamation
+ * (https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf). Every thread
+ * that does lookups gets a reader record, in which it announces the global
+ * epoch while it reads the table. The epoch only advances when all readers
+ * that are reading have announced the current epoch, so memory retired in
+ * epoch e is no longer reachable by any reader once the epoch is e + 2.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "concurrent_table.h"
+
+/* Number of write locks, the number of buckets is a multiple of it. */
+#define STRIPES 64
+
+/* Number of blocks retired between two attempts to free some. */
+#define RECLAIM_BATCH 64
+
+/* Initial number of values in a value block. */
+#define VALUES_START 4
+
+/* The ways a retired block is freed. */
+enum retire_kind {
+    /* A value block */
+    RETIRE_VALUES,
+    /* A deleted node together with its value block */
+    RETIRE_NODE,
+    /* A bucket array left by a resize, with the nodes in its chains but not
+     * their value blocks, which the copies of the nodes took over */
+    RETIRE_BUCKETS
+};
+
+struct cvalues {
+    /* Number of values that fit in data */
+    size_t capacity;
+    /* Number of values in data, published after the value itself */
+    _Atomic size_t used;
+    int data[];
+};
+
+struct cnode {
+    _Atomic(struct cnode *) next;
+    /* Full hash of the key */
+    unsigned long hash;
+    /* Values of the key, replaced by a bigger copy when full */
+    _Atomic(struct cvalues *) values;
+    char key[];
+};
+
+struct cbuckets {
+    unsigned long capacity;
+    _Atomic(struct cnode *) heads[];
+};
+
+/* Announcement of a thread that reads the table. */
+struct reader {
+    /* Epoch in which the current lookup started, 0 if there is none */
+    _Atomic unsigned long epoch;
+    /* Token of the thread that owns this record, never changes */
+    const void *owner;
+    /* Next record, never changes after the record is added */
+    struct reader *next;
+};
+
+struct retired {
+    void *block;
+    enum retire_kind kind;
+    /* Epoch in which the block was retired */
+    unsigned long epoch;
+    struct retired *next;
+};
+
+/* Reclamation state. Kept behind a pointer, so lookups on a const table can
+ * add their reader record. */
+struct reclaim {
+    /* Global epoch, starts at 2 and only writers advance it */
+    _Atomic unsigned long epoch;
+    /* List of reader records, records are only added */
+    _Atomic(struct reader *) readers;
+    /* Protects retired, until_reclaim and advancing the epoch */
+    pthread_mutex_t lock;
+    struct retired *retired;
+    /* Number of blocks still to retire before the next attempt to free
+     * some, so a reader that holds up the epoch does not make every retire
+     * walk the whole list */
+    unsigned long until_reclaim;
+};
+
+struct ctable {
+    /* Current bucket array, replaced as a whole by a resize */
+    _Atomic(struct cbuckets *) buckets;
+    /* Capacity of the current bucket array */
+    _Atomic unsigned long capacity;
+    /* Number of keys */
+    _Atomic unsigned long load;
+    unsigned long (*hash_func)(const unsigned char *);
+    double max_load_factor;
+    /* Lock i protects the buckets with index i modulo STRIPES */
+    pthread_mutex_t stripes[STRIPES];
+    struct reclaim *reclaim;
+    /* Unique number of the table, used to cache reader records per thread */
+    unsigned long id;
+};
+
+/* Source of table ids, 0 is never used. */
+static _Atomic unsigned long next_table_id = 1;
+
+/* The address of this variable identifies the thread that owns a reader
+ * record. */
+static _Thread_local char thread_token;
+
+/* Reader record of this thread for the table with id table_id. */
+static _Thread_local struct {
+    unsigned long table_id;
+    struct reader *record;
+} reader_cache;
+
+/*
+ * Find the reader record of this thread for a table, or add one the first
+ * time. Records are never released: they stay owned when a thread exits,
+ * and a new thread that gets the same token simply uses them again.
+ *
+ * Returns the record, or NULL on allocation failure.
+ */
+static struct reader *reader_record(const struct ctable *t) {
+    if (reader_cache.table_id == t->id) {
+        return reader_cache.record;
+    }
+
+    struct reclaim *r = t->reclaim;
+    const void *me = &thread_token;
+    struct reader *record = NULL;
+
+    for (struct reader *s = atomic_load(&r->readers); s != NULL && record == NULL; s = s->next) {
+        if (s->owner == me) {
+            record = s;
+        }
+    }
+    if (record == NULL) {
+        record = malloc(sizeof(struct reader));
+        if (record == NULL) {
+            return NULL;
+        }
+        atomic_init(&record->epoch, 0);
+        record->owner = me;
+        record->next = atomic_load(&r->readers);
+        while (!atomic_compare_exchange_weak(&r->readers, &record->next, record)) {
+        }
+    }
+
+    reader_cache.table_id = t->id;
+    reader_cache.record = record;
+    return record;
+}
+
+/* Announce the current epoch before reading the table. The fence keeps the
+ * reads of the table from moving before the announcement. */
+static void reader_enter(struct reclaim *r, struct reader *record) {
+    atomic_store(&record->epoch, atomic_load(&r->epoch));
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/* Announce that the lookup is done. */
+static void reader_leave(struct reader *record) {
+    atomic_store_explicit(&record->epoch, 0, memory_order_release);
+}
+
+/* Free the chains of a bucket array, and their value blocks if free_values
+ * is set, together with the array itself. */
+static void free_buckets(struct cbuckets *b, int free_values) {
+    for (unsigned long i = 0; i < b->capacity; i++) {
+        struct cnode *n = atomic_load_explicit(&b->heads[i], memory_order_relaxed);
+        while (n != NULL) {
+            struct cnode *next = atomic_load_explicit(&n->next, memory_order_relaxed);
+            if (free_values) {
+                free(atomic_load_explicit(&n->values, memory_order_relaxed));
+            }
+            free(n);
+            n = next;
+        }
+    }
+    free(b);
+}
+
+/* Free a retired block in the way its kind requires. */
+static void free_retired(struct retired *item) {
+    if (item->kind == RETIRE_NODE) {
+        struct cnode *n = item->block;
+        free(atomic_load_explicit(&n->values, memory_order_relaxed));
+        free(n);
+    } else if (item->kind == RETIRE_BUCKETS) {
+        free_buckets(item->block, 0);
+    } else {
+        free(item->block);
+    }
+    free(item);
+}
+
+/*
+ * Advance the epoch if every reader that is reading has announced the
+ * current one, then free the blocks retired at least two epochs ago. Must be
+ * called with the reclamation lock held.
+ */
+static void reclaim_old(struct reclaim *r) {
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned long epoch = atomic_load(&r->epoch);
+    int advance = 1;
+    for (struct reader *s = atomic_load(&r->readers); s != NULL; s = s->next) {
+        unsigned long announced = atomic_load(&s->epoch);
+        if (announced != 0 && announced != epoch) {
+            advance = 0;
+            break;
+        }
+    }
+    if (advance) {
+        atomic_store(&r->epoch, ++epoch);
+    }
+
+    struct retired **link = &r->retired;
+    while (*link != NULL) {
+        struct retired *item = *link;
+        if (item->epoch + 2 <= epoch) {
+            *link = item->next;
+            free_retired(item);
+        } else {
+            link = &item->next;
+        }
+    }
+}
+
+/*
+ * Hand a block that was unlinked from the table over for freeing, once no
+ * reader can still be using it.
+ *
+ * Returns 0 on success, 1 if no memory was left to remember the block, in
+ * which case it is leaked rather than freed too early.
+ */
+static int retire(struct ctable *t, void *block, enum retire_kind kind) {
+    struct reclaim *r = t->reclaim;
+    struct retired *item = malloc(sizeof(struct retired));
+    if (item == NULL) {
+        return 1;
+    }
+    item->block = block;
+    item->kind = kind;
+
+    pthread_mutex_lock(&r->lock);
+    item->epoch = atomic_load(&r->epoch);
+    item->next = r->retired;
+    r->retired = item;
+    if (--r->until_reclaim == 0) {
+        reclaim_old(r);
+        r->until_reclaim = RECLAIM_BATCH;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+/* Allocate an empty bucket array, returns NULL on failure. */
+static struct cbuckets *buckets_alloc(unsigned long capacity) {
+    struct cbuckets *b = malloc(sizeof(struct cbuckets)
+                                + capacity * sizeof(_Atomic(struct cnode *)));
+    if (b == NULL) {
+        return NULL;
+    }
+    b->capacity = capacity;
+    for (unsigned long i = 0; i < capacity; i++) {
+        atomic_init(&b->heads[i], NULL);
+    }
+    return b;
+}
+
+/* Allocate a node for key that is not linked yet, returns NULL on failure. */
+static struct cnode *node_alloc(const char *key, unsigned long hash,
+                                struct cvalues *values) {
+    size_t key_size = strlen(key) + 1;
+    struct cnode *n = malloc(sizeof(struct cnode) + key_size);
+    if (n == NULL) {
+        return NULL;
+    }
+    atomic_init(&n->next, NULL);
+    n->hash = hash;
+    atomic_init(&n->values, values);
+    memcpy(n->key, key, key_size);
+    return n;
+}
+
+/* Allocate a value block holding the first used values of data, with room
+ * for capacity values. Returns NULL on failure. */
+static struct cvalues *values_alloc(size_t capacity, const int *data, size_t used) {
+    struct cvalues *v = malloc(sizeof(struct cvalues) + capacity * sizeof(int));
+    if (v == NULL) {
+        return NULL;
+    }
+    v->capacity = capacity;
+    memcpy(v->data, data, used * sizeof(int));
+    atomic_init(&v->used, used);
+    return v;
+}
+
+/*
+ * Find the node of a key in a chain.
+ *
+ * Returns the node, or NULL if the key is not in the chain.
+ */
+static struct cnode *chain_find(_Atomic(struct cnode *) *head, const char *key,
+                                unsigned long hash) {
+    struct cnode *n = atomic_load_explicit(head, memory_order_acquire);
+    while (n != NULL && (n->hash != hash || strcmp(n->key, key) != 0)) {
+        n = atomic_load_explicit(&n->next, memory_order_acquire);
+    }
+    return n;
+}
+
+/*
+ * Append a value to a node, with the stripe of the node locked. The value is
+ * written before the new count is published, so lookups never read a value
+ * that is not there yet.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int values_append(struct ctable *t, struct cnode *n, int value) {
+    struct cvalues *v = atomic_load_explicit(&n->values, memory_order_relaxed);
+    size_t used = atomic_load_explicit(&v->used, memory_order_relaxed);
+
+    if (used == v->capacity) {
+        struct cvalues *bigger = values_alloc(v->capacity * 2, v->data, used);
+        if (bigger == NULL) {
+            return 1;
+        }
+        atomic_store_explicit(&n->values, bigger, memory_order_release);
+        retire(t, v, RETIRE_VALUES);
+        v = bigger;
+    }
+    v->data[used] = value;
+    atomic_store_explicit(&v->used, used + 1, memory_order_release);
+    return 0;
+}
+
+/*
+ * Double the number of buckets if the table is still over its load factor
+ * once all stripes are locked. The new array is filled with copies of the
+ * nodes that share their value blocks, the old array with the original
+ * nodes is retired.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int ctable_resize(struct ctable *t) {
+    for (int i = 0; i < STRIPES; i++) {
+        pthread_mutex_lock(&t->stripes[i]);
+    }
+
+    int res = 0;
+    struct cbuckets *old = atomic_load_explicit(&t->buckets, memory_order_relaxed);
+    if ((double)atomic_load(&t->load) > t->max_load_factor * (double)old->capacity) {
+        struct cbuckets *b = buckets_alloc(old->capacity * 2);
+        res = b == NULL;
+
+        for (unsigned long i = 0; i < old->capacity && res == 0; i++) {
+            struct cnode *n = atomic_load_explicit(&old->heads[i], memory_order_relaxed);
+            for (; n != NULL; n = atomic_load_explicit(&n->next, memory_order_relaxed)) {
+                struct cvalues *v = atomic_load_explicit(&n->values, memory_order_relaxed);
+                struct cnode *copy = node_alloc(n->key, n->hash, v);
+                if (copy == NULL) {
+                    res = 1;
+                    break;
+                }
+                _Atomic(struct cnode *) *head = &b->heads[n->hash % b->capacity];
+                atomic_init(&copy->next, atomic_load_explicit(head, memory_order_relaxed));
+                atomic_init(head, copy);
+            }
+        }
+
+        if (res == 0) {
+            atomic_store(&t->capacity, b->capacity);
+            atomic_store_explicit(&t->buckets, b, memory_order_release);
+            retire(t, old, RETIRE_BUCKETS);
+        } else if (b != NULL) {
+            free_buckets(b, 0);
+        }
+    }
+
+    for (int i = STRIPES - 1; i >= 0; i--) {
+        pthread_mutex_unlock(&t->stripes[i]);
+    }
+    return res;
+}
+
+/*
+ * Initialize a concurrent hash table.
+ *
+ * capacity: Minimum initial number of buckets, rounded up to a multiple of
+ * the number of stripes.
+ * max_load_factor: Maximum load factor before the table is resized.
+ * hash_func: Hash function for the keys.
+ *
+ * Returns a pointer to the table, or NULL on failure.
+ */
+struct ctable *ctable_init(unsigned long capacity, double max_load_factor,
+                           unsigned long (*hash_func)(const unsigned char *)) {
+    if (max_load_factor <= 0 || hash_func == NULL) {
+        return NULL;
+    }
+
+    struct ctable *t = malloc(sizeof(struct ctable));
+    if (t == NULL) {
+        return NULL;
+    }
+    t->reclaim = malloc(sizeof(struct reclaim));
+    capacity = capacity < STRIPES ? STRIPES : (capacity + STRIPES - 1) / STRIPES * STRIPES;
+    struct cbuckets *b = buckets_alloc(capacity);
+    if (t->reclaim == NULL || b == NULL) {
+        free(t->reclaim);
+        free(b);
+        free(t);
+        return NULL;
+    }
+
+    atomic_init(&t->buckets, b);
+    atomic_init(&t->capacity, capacity);
+    atomic_init(&t->load, 0);
+    t->hash_func = hash_func;
+    t->max_load_factor = max_load_factor;
+    for (int i = 0; i < STRIPES; i++) {
+        pthread_mutex_init(&t->stripes[i], NULL);
+    }
+    t->id = atomic_fetch_add(&next_table_id, 1);
+
+    atomic_init(&t->reclaim->epoch, 2);
+    atomic_init(&t->reclaim->readers, NULL);
+    pthread_mutex_init(&t->reclaim->lock, NULL);
+    t->reclaim->retired = NULL;
+    t->reclaim->until_reclaim = RECLAIM_BATCH;
+
+    return t;
+}
+
+/*
+ * Copy and insert a key with its value, or append the value if the key is
+ * already present.
+ *
+ * t: The table.
+ * key: The key to insert.
+ * value: The value to associate with the key.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int ctable_insert(struct ctable *t, const char *key, int value) {
+    if (t == NULL || key == NULL) {
+        return 1;
+    }
+
+    unsigned long hash = t->hash_func((const unsigned char *)key);
+    pthread_mutex_t *stripe = &t->stripes[hash % STRIPES];
+    int res = 0;
+    int added = 0;
+
+    /* The bucket array only changes with all stripes locked. */
+    pthread_mutex_lock(stripe);
+    struct cbuckets *b = atomic_load_explicit(&t->buckets, memory_order_relaxed);
+    _Atomic(struct cnode *) *head = &b->heads[hash % b->capacity];
+    struct cnode *n = chain_find(head, key, hash);
+    if (n != NULL) {
+        res = values_append(t, n, value);
+    } else {
+        struct cvalues *v = values_alloc(VALUES_START, &value, 1);
+        n = v == NULL ? NULL : node_alloc(key, hash, v);
+        if (n == NULL) {
+            free(v);
+            res = 1;
+        } else {
+            atomic_init(&n->next, atomic_load_explicit(head, memory_order_relaxed));
+            atomic_store_explicit(head, n, memory_order_release);
+            added = 1;
+        }
+    }
+    pthread_mutex_unlock(stripe);
+
+    if (added) {
+        unsigned long load = atomic_fetch_add(&t->load, 1) + 1;
+        if ((double)load > t->max_load_factor * (double)atomic_load(&t->capacity)) {
+            res = ctable_resize(t);
+        }
+    }
+    return res;
+}
+
+/*
+ * Look up a key without taking any lock.
+ *
+ * t: The table.
+ * key: The key to look up.
+ * values: Receives the first values of the key.
+ * max: Number of values that fit in values.
+ *
+ * Returns the number of values of the key, 0 if it is not present or on
+ * failure.
+ */
+size_t ctable_lookup(const struct ctable *t, const char *key, int *values, size_t max) {
+    if (t == NULL || key == NULL) {
+        return 0;
+    }
+
+    unsigned long hash = t->hash_func((const unsigned char *)key);
+    struct reader *record = reader_record(t);
+    if (record == NULL) {
+        return 0;
+    }
+
+    size_t count = 0;
+    reader_enter(t->reclaim, record);
+    struct cbuckets *b = atomic_load_explicit(&t->buckets, memory_order_acquire);
+    struct cnode *n = chain_find(&b->heads[hash % b->capacity], key, hash);
+    if (n != NULL) {
+        struct cvalues *v = atomic_load_explicit(&n->values, memory_order_acquire);
+        count = atomic_load_explicit(&v->used, memory_order_acquire);
+        if (max > 0) {
+            memcpy(values, v->data, (count < max ? count : max) * sizeof(int));
+        }
+    }
+    reader_leave(record);
+
+    return count;
+}
+
+/*
+ * Remove a key and its values.
+ *
+ * t: The table.
+ * key: The key to remove.
+ *
+ * Returns 0 if the key was removed, 1 if it was not found and -1 if t or key
+ * is NULL.
+ */
+int ctable_delete(struct ctable *t, const char *key) {
+    if (t == NULL || key == NULL) {
+        return -1;
+    }
+
+    unsigned long hash = t->hash_func((const unsigned char *)key);
+    pthread_mutex_t *stripe = &t->stripes[hash % STRIPES];
+
+    pthread_mutex_lock(stripe);
+    struct cbuckets *b = atomic_load_explicit(&t->buckets, memory_order_relaxed);
+    _Atomic(struct cnode *) *link = &b->heads[hash % b->capacity];
+    struct cnode *n = atomic_load_explicit(link, memory_order_relaxed);
+    while (n != NULL && (n->hash != hash || strcmp(n->key, key) != 0)) {
+        link = &n->next;
+        n = atomic_load_explicit(link, memory_order_relaxed);
+    }
+    if (n != NULL) {
+        /* Lookups that are on n can still follow its next pointer. */
+        atomic_store_explicit(link, atomic_load_explicit(&n->next, memory_order_relaxed),
+                              memory_order_release);
+        atomic_fetch_sub(&t->load, 1);
+        retire(t, n, RETIRE_NODE);
+    }
+    pthread_mutex_unlock(stripe);
+
+    return n == NULL;
+}
+
+/*
+ * Returns the load factor of the table, or -1.0 if t is NULL.
+ */
+double ctable_load_factor(const struct ctable *t) {
+    if (t == NULL) {
+        return -1.0;
+    }
+    return (double)atomic_load(&t->load) / (double)atomic_load(&t->capacity);
+}
+
+/*
+ * Clean up the table, everything retired and the reader records.
+ */
+void ctable_cleanup(struct ctable *t) {
+    if (t == NULL) {
+        return;
+    }
+
+    struct reclaim *r = t->reclaim;
+    while (r->retired != NULL) {
+        struct retired *next = r->retired->next;
+        free_retired(r->retired);
+        r->retired = next;
+    }
+    struct reader *s = atomic_load(&r->readers);
+    while (s != NULL) {
+        struct reader *next = s->next;
+        free(s);
+        s = next;
+    }
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+
+    for (int i = 0; i < STRIPES; i++) {
+        pthread_mutex_destroy(&t->stripes[i]);
+    }
+    free_buckets(atomic_load(&t->buckets), 1);
+    free(t);
+}
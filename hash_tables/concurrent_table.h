@@ -0,0 +1,46 @@
+#ifndef CONCURRENT_TABLE_H
+#define CONCURRENT_TABLE_H
+
+#include <stddef.h>
+
+/* Chained hash table that can be shared between threads, with the same
+ * keys and values as the table in hash_table.h. Writers lock one of a fixed
+ * number of stripes of the buckets, so writers of different stripes run in
+ * parallel. Lookups take no lock at all: they follow atomic pointers and
+ * memory that writers unlink is only freed once no lookup that started
+ * before the unlink is still running (epoch based reclamation). A resize
+ * locks all stripes but never blocks lookups. */
+
+/* Handle to the concurrent table. */
+struct ctable;
+
+/* Initialise a table, like table_init. Returns NULL on failure. */
+struct ctable *ctable_init(unsigned long capacity, double max_load_factor,
+                           unsigned long (*hash_func)(const unsigned char *));
+
+/* Copies and inserts key with value, or appends value to the values of key
+ * if it is present. Safe to call from any number of threads.
+ * Returns 0 if successful and 1 otherwise. */
+int ctable_insert(struct ctable *t, const char *key, int value);
+
+/* Copies up to max values of key into values, in the order they were
+ * inserted. Never blocks and is safe to call from any number of threads.
+ * Returns the total number of values of key, so a return value above max
+ * means values was too small. Returns 0 if the key is not present, and also
+ * on failure. */
+size_t ctable_lookup(const struct ctable *t, const char *key, int *values, size_t max);
+
+/* Removes key and its values. Safe to call from any number of threads.
+ * Returns 0 if the key was removed, 1 if it was not present and -1 if t or
+ * key is NULL. */
+int ctable_delete(struct ctable *t, const char *key);
+
+/* Returns the number of keys stored / the number of buckets, or -1.0 if t is
+ * NULL. */
+double ctable_load_factor(const struct ctable *t);
+
+/* Cleans up the table with all its keys and values. No other thread may use
+ * the table during or after this call. */
+void ctable_cleanup(struct ctable *t);
+
+#endif /* CONCURRENT_TABLE_H */
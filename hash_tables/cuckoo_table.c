@@ -0,0 +1,441 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file implements a bucketized cuckoo hash table
+ * (https://www.cs.princeton.edu/~mfreed/docs/cuckoo-eurosys14.pdf). The
+ * table is an array of buckets of 4 slots, and every key is stored in one of
+ * exactly two buckets, so a lookup checks at most 8 slots, hit or miss. A
+ * bucket holds the hashes and entry pointers of its slots in one cache line,
+ * and the key itself is only read when the full 64 bit hash matches.
+ * An insert that finds both buckets full evicts a random entry of a bucket,
+ * which moves to its other bucket, and so on. If that does not end in a free
+ * slot after MAX_KICKS evictions, the evictions are undone and the table is
+ * doubled.
+ *
+ * The buckets are picked with the table's hash combined with a second hash of
+ * the key, seeded FNV-1a with the murmur3 finalizer. A weak table hash, like
+ * hash_too_simple, then can not put all keys in the same few bucket pairs.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "cuckoo_table.h"
+
+/* Slots per bucket, a bucket is 64 bytes. */
+#define CUCKOO_WAYS 4
+
+/* Used instead of the requested load factor when that one is too high for a
+ * 4-way cuckoo table to keep inserts cheap. */
+#define CUCKOO_MAX_LOAD 0.9
+
+/* Evictions an insert tries before the table is doubled. */
+#define MAX_KICKS 128
+
+/* Seed of the second hash. */
+#define SECOND_SEED 0x8a5cd789635d2dffULL
+
+struct cuckoo_entry {
+    /* Values stored for the key */
+    struct array *value;
+    /* The key, copied on insert */
+    char key[];
+};
+
+struct cuckoo_bucket {
+    /* Combined hash of every slot, so moving an entry never reads its key */
+    uint64_t hashes[CUCKOO_WAYS];
+    /* Entry of every slot, NULL if the slot is empty */
+    struct cuckoo_entry *entries[CUCKOO_WAYS];
+};
+
+struct cuckoo_table {
+    /* Bucket array, aligned to the size of a bucket */
+    struct cuckoo_bucket *buckets;
+    /* Maximum load factor after which the table is doubled */
+    double max_load_factor;
+    /* Number of buckets, always a power of two */
+    unsigned long n_buckets;
+    /* Number of keys */
+    unsigned long load;
+    /* State of the generator that picks the slots to evict */
+    uint64_t random;
+};
+
+/* A slot an entry was evicted from, to undo a failed insert. */
+struct kick {
+    unsigned long bucket;
+    unsigned int slot;
+};
+
+/* Return the second hash of a key, which does not depend on the table's hash
+ * function. */
+static uint64_t second_hash(const char *key) {
+    uint64_t h = SECOND_SEED;
+    for (const unsigned char *c = (const unsigned char *)key; *c != '\0'; c++) {
+        h ^= *c;
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
+/*
+ * Return the hash stored for a key, the table's hash mixed with the second
+ * hash, which all other functions take. It is computed once per key, so a
+ * batch of lookups hashes each key once for the prefetch and the find.
+ * Multiplier from Fibonacci hashing.
+ */
+unsigned long cuckoo_hash(const char *key, unsigned long hash) {
+    return (unsigned long)(((uint64_t)hash * 0x9e3779b97f4a7c15ULL) ^ second_hash(key));
+}
+
+/* The first bucket of a hash, picked by its low half. */
+static unsigned long first_bucket(uint64_t hash, unsigned long n_buckets) {
+    return (unsigned long)hash & (n_buckets - 1);
+}
+
+/* The second bucket of a hash, picked by its high half. It differs from the
+ * first bucket whenever there is more than one bucket. */
+static unsigned long second_bucket(uint64_t hash, unsigned long n_buckets) {
+    unsigned long first = first_bucket(hash, n_buckets);
+    unsigned long second = (unsigned long)(hash >> 32) & (n_buckets - 1);
+    return second != first ? second : first ^ ((n_buckets - 1) & 1);
+}
+
+/* Return the bucket of a hash that is not b. */
+static unsigned long other_bucket(uint64_t hash, unsigned long b, unsigned long n_buckets) {
+    unsigned long first = first_bucket(hash, n_buckets);
+    return b == first ? second_bucket(hash, n_buckets) : first;
+}
+
+/* Return the next number of a xorshift64 generator. */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/*
+ * Put an entry in a free slot of a bucket.
+ *
+ * Returns 1 if it was put, 0 if the bucket is full.
+ */
+static int put_free(struct cuckoo_bucket *bucket, uint64_t hash, struct cuckoo_entry *entry) {
+    for (unsigned int s = 0; s < CUCKOO_WAYS; s++) {
+        if (bucket->entries[s] == NULL) {
+            bucket->hashes[s] = hash;
+            bucket->entries[s] = entry;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Exchange the hash and entry of a slot with the given ones. */
+static void swap_slot(struct cuckoo_bucket *bucket, unsigned int s, uint64_t *hash,
+                      struct cuckoo_entry **entry) {
+    uint64_t h = bucket->hashes[s];
+    struct cuckoo_entry *e = bucket->entries[s];
+    bucket->hashes[s] = *hash;
+    bucket->entries[s] = *entry;
+    *hash = h;
+    *entry = e;
+}
+
+/*
+ * Place an entry in one of its buckets, evicting other entries to their
+ * other bucket when both are full. The entry must not be present yet.
+ *
+ * Returns 0 on success, 1 if no free slot was reached within MAX_KICKS
+ * evictions, in which case all evictions are undone.
+ */
+static int place_entry(struct cuckoo_bucket *buckets, unsigned long n_buckets, uint64_t hash,
+                       struct cuckoo_entry *entry, uint64_t *random) {
+    if (put_free(&buckets[first_bucket(hash, n_buckets)], hash, entry)) {
+        return 0;
+    }
+
+    struct kick path[MAX_KICKS];
+    unsigned long b = second_bucket(hash, n_buckets);
+    for (int k = 0; k < MAX_KICKS; k++) {
+        if (put_free(&buckets[b], hash, entry)) {
+            return 0;
+        }
+        path[k].bucket = b;
+        path[k].slot = (unsigned int)(next_random(random) % CUCKOO_WAYS);
+        swap_slot(&buckets[b], path[k].slot, &hash, &entry);
+        b = other_bucket(hash, b, n_buckets);
+    }
+
+    /* Swapping back in reverse order restores every slot. */
+    for (int k = MAX_KICKS - 1; k >= 0; k--) {
+        swap_slot(&buckets[path[k].bucket], path[k].slot, &hash, &entry);
+    }
+    return 1;
+}
+
+/*
+ * Allocate an empty bucket array.
+ *
+ * Returns the array, or NULL on failure.
+ */
+static struct cuckoo_bucket *alloc_buckets(unsigned long n_buckets) {
+    struct cuckoo_bucket *buckets = aligned_alloc(sizeof(struct cuckoo_bucket),
+                                                  n_buckets * sizeof(struct cuckoo_bucket));
+    if (buckets != NULL) {
+        memset(buckets, 0, n_buckets * sizeof(struct cuckoo_bucket));
+    }
+    return buckets;
+}
+
+/*
+ * Move all entries to a new bucket array with at least new_buckets buckets.
+ * If the entries do not fit, the new array is doubled until they do.
+ *
+ * Returns 0 on success, 1 on failure, in which case the table is unchanged.
+ */
+static int cuckoo_rebuild(struct cuckoo_table *c, unsigned long new_buckets) {
+    for (;; new_buckets *= 2) {
+        struct cuckoo_bucket *buckets = alloc_buckets(new_buckets);
+        if (buckets == NULL) {
+            return 1;
+        }
+
+        int failed = 0;
+        for (unsigned long b = 0; b < c->n_buckets && !failed; b++) {
+            for (unsigned int s = 0; s < CUCKOO_WAYS && !failed; s++) {
+                struct cuckoo_bucket *old = &c->buckets[b];
+                if (old->entries[s] != NULL) {
+                    failed = place_entry(buckets, new_buckets, old->hashes[s],
+                                         old->entries[s], &c->random);
+                }
+            }
+        }
+        if (!failed) {
+            free(c->buckets);
+            c->buckets = buckets;
+            c->n_buckets = new_buckets;
+            return 0;
+        }
+        free(buckets);
+    }
+}
+
+/*
+ * Find the slot of a key.
+ *
+ * Returns a pointer to the entry pointer of the slot, or NULL if the key is
+ * not present.
+ */
+static struct cuckoo_entry **find_slot(const struct cuckoo_table *c, const char *key,
+                                       unsigned long hash) {
+    uint64_t h = hash;
+    unsigned long b[2] = { first_bucket(h, c->n_buckets), second_bucket(h, c->n_buckets) };
+
+    for (int i = 0; i < 2; i++) {
+        struct cuckoo_bucket *bucket = &c->buckets[b[i]];
+        for (unsigned int s = 0; s < CUCKOO_WAYS; s++) {
+            if (bucket->hashes[s] == h && bucket->entries[s] != NULL
+                && strcmp(bucket->entries[s]->key, key) == 0) {
+                return &bucket->entries[s];
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Initialize a cuckoo table.
+ *
+ * capacity: Minimum initial number of slots.
+ * max_load_factor: Maximum load factor before doubling.
+ *
+ * Returns a pointer to the table, or NULL on failure.
+ */
+struct cuckoo_table *cuckoo_init(unsigned long capacity, double max_load_factor) {
+    if (capacity == 0 || max_load_factor <= 0) {
+        return NULL;
+    }
+
+    struct cuckoo_table *c = malloc(sizeof(struct cuckoo_table));
+    if (c == NULL) {
+        return NULL;
+    }
+
+    unsigned long n_buckets = 1;
+    while (n_buckets * CUCKOO_WAYS < capacity) {
+        n_buckets *= 2;
+    }
+    c->buckets = alloc_buckets(n_buckets);
+    if (c->buckets == NULL) {
+        free(c);
+        return NULL;
+    }
+    c->n_buckets = n_buckets;
+    c->max_load_factor = max_load_factor < CUCKOO_MAX_LOAD ? max_load_factor : CUCKOO_MAX_LOAD;
+    c->load = 0;
+    c->random = SECOND_SEED;
+
+    return c;
+}
+
+/*
+ * Look up a key, reading at most its two buckets.
+ *
+ * Returns the values stored for the key, or NULL if it is not present.
+ */
+struct array *cuckoo_find(const struct cuckoo_table *c, const char *key,
+                          unsigned long hash) {
+    struct cuckoo_entry **slot = find_slot(c, key, hash);
+    return slot != NULL ? (*slot)->value : NULL;
+}
+
+/*
+ * Prefetch both buckets of a key.
+ */
+void cuckoo_prefetch(const struct cuckoo_table *c, unsigned long hash) {
+    __builtin_prefetch(&c->buckets[first_bucket(hash, c->n_buckets)]);
+    __builtin_prefetch(&c->buckets[second_bucket(hash, c->n_buckets)]);
+}
+
+/*
+ * Copy and insert a key that is not present yet. The table is doubled first
+ * when the extra key would exceed the maximum load factor, and also when the
+ * key can not be placed.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int cuckoo_insert(struct cuckoo_table *c, const char *key, unsigned long hash,
+                  struct array *value) {
+    unsigned long slots = c->n_buckets * CUCKOO_WAYS;
+    if ((double)(c->load + 1) > c->max_load_factor * (double)slots) {
+        if (cuckoo_rebuild(c, c->n_buckets * 2) != 0) {
+            return 1;
+        }
+    }
+
+    size_t len = strlen(key);
+    struct cuckoo_entry *entry = malloc(sizeof(struct cuckoo_entry) + len + 1);
+    if (entry == NULL) {
+        return 1;
+    }
+    memcpy(entry->key, key, len + 1);
+    entry->value = value;
+
+    while (place_entry(c->buckets, c->n_buckets, hash, entry, &c->random) != 0) {
+        if (cuckoo_rebuild(c, c->n_buckets * 2) != 0) {
+            free(entry);
+            return 1;
+        }
+    }
+    c->load++;
+
+    return 0;
+}
+
+/*
+ * Remove a key and clean up its values. Cuckoo tables need no deleted
+ * markers, the slot simply becomes free.
+ *
+ * Returns 0 if the key was removed, 1 if it was not present.
+ */
+int cuckoo_remove(struct cuckoo_table *c, const char *key, unsigned long hash) {
+    struct cuckoo_entry **slot = find_slot(c, key, hash);
+    if (slot == NULL) {
+        return 1;
+    }
+
+    array_cleanup((*slot)->value);
+    free(*slot);
+    *slot = NULL;
+    c->load--;
+
+    return 0;
+}
+
+/*
+ * Call a function for every key in the table.
+ *
+ * Returns 0 if func returned 0 for all keys, otherwise its first non-zero
+ * return value.
+ */
+int cuckoo_foreach(const struct cuckoo_table *c,
+                   int (*func)(void *ctx, const char *key, struct array *value),
+                   void *ctx) {
+    for (unsigned long b = 0; b < c->n_buckets; b++) {
+        for (unsigned int s = 0; s < CUCKOO_WAYS; s++) {
+            struct cuckoo_entry *entry = c->buckets[b].entries[s];
+            if (entry != NULL) {
+                int res = func(ctx, entry->key, entry->value);
+                if (res != 0) {
+                    return res;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Rebuild the table with the fewest buckets that hold its keys within the
+ * maximum load factor.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int cuckoo_compact(struct cuckoo_table *c) {
+    unsigned long n_buckets = 1;
+    while ((double)c->load > c->max_load_factor * (double)(n_buckets * CUCKOO_WAYS)) {
+        n_buckets *= 2;
+    }
+    if (n_buckets >= c->n_buckets) {
+        return 0;
+    }
+    return cuckoo_rebuild(c, n_buckets);
+}
+
+/*
+ * Returns the load factor of the table.
+ */
+double cuckoo_load_factor(const struct cuckoo_table *c) {
+    return (double)c->load / (double)(c->n_buckets * CUCKOO_WAYS);
+}
+
+/*
+ * Returns the number of bytes of the table, its buckets and entry headers.
+ */
+unsigned long cuckoo_memory(const struct cuckoo_table *c) {
+    return (unsigned long)(sizeof(struct cuckoo_table)
+                           + c->n_buckets * sizeof(struct cuckoo_bucket)
+                           + c->load * sizeof(struct cuckoo_entry));
+}
+
+/*
+ * Clean up the table and free all keys and values.
+ */
+void cuckoo_cleanup(struct cuckoo_table *c) {
+    if (c == NULL) {
+        return;
+    }
+
+    for (unsigned long b = 0; b < c->n_buckets; b++) {
+        for (unsigned int s = 0; s < CUCKOO_WAYS; s++) {
+            if (c->buckets[b].entries[s] != NULL) {
+                array_cleanup(c->buckets[b].entries[s]->value);
+                free(c->buckets[b].entries[s]);
+            }
+        }
+    }
+    free(c->buckets);
+    free(c);
+}
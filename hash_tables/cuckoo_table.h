@@ -0,0 +1,63 @@
+#ifndef CUCKOO_TABLE_H
+#define CUCKOO_TABLE_H
+
+/* Bucketized cuckoo hash table, used as a backend for the hash table in
+ * hash_table.c. Every key can only be in one of two buckets of 4 slots, and
+ * a bucket fills exactly one cache line, so any lookup reads at most two
+ * buckets. The interface mirrors swiss_table.h: keys are copied on insert,
+ * values are owned by the table and all functions take the precomputed hash
+ * of the key. That hash is cuckoo_hash of the key: the hash of the table
+ * combined with a second hash of the key, from which the two buckets are
+ * chosen. */
+
+struct array;
+
+/* Handle to the cuckoo table. */
+struct cuckoo_table;
+
+/* Initialise a table with room for at least capacity slots and the given
+ * maximum load factor, which is clamped to 0.9. Returns NULL on failure. */
+struct cuckoo_table *cuckoo_init(unsigned long capacity, double max_load_factor);
+
+/* Returns the hash the other functions take for key, with hash the hash of
+ * key of the table. */
+unsigned long cuckoo_hash(const char *key, unsigned long hash);
+
+/* Returns the value stored for key, or NULL if the key is not present. */
+struct array *cuckoo_find(const struct cuckoo_table *c, const char *key,
+                          unsigned long hash);
+
+/* Prefetches both buckets of key, for a cuckoo_find of it shortly after. */
+void cuckoo_prefetch(const struct cuckoo_table *c, unsigned long hash);
+
+/* Copies and inserts a key that is not yet present, together with its value.
+ * The table takes ownership of value. Returns 0 on success, 1 otherwise. */
+int cuckoo_insert(struct cuckoo_table *c, const char *key, unsigned long hash,
+                  struct array *value);
+
+/* Removes key and cleans up its value.
+ * Returns 0 if the key was removed and 1 if it was not present. */
+int cuckoo_remove(struct cuckoo_table *c, const char *key, unsigned long hash);
+
+/* Calls func for every key with its value, in bucket order, until func
+ * returns non-zero. Returns 0 or the non-zero return value of func. */
+int cuckoo_foreach(const struct cuckoo_table *c,
+                   int (*func)(void *ctx, const char *key, struct array *value),
+                   void *ctx);
+
+/* Rebuilds the table with the fewest buckets that hold its keys within the
+ * maximum load factor. Returns 0 on success, 1 on failure, in which case the
+ * table is unchanged. */
+int cuckoo_compact(struct cuckoo_table *c);
+
+/* Returns the number of keys stored / the number of slots. */
+double cuckoo_load_factor(const struct cuckoo_table *c);
+
+/* Returns the number of bytes of the table, its buckets and the headers of
+ * its entries, without the keys and values. */
+unsigned long cuckoo_memory(const struct cuckoo_table *c);
+
+/* Cleans up the table together with all keys and values. */
+void cuckoo_cleanup(struct cuckoo_table *c);
+
+#endif /* CUCKOO_TABLE_H */
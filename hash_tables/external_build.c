@@ -0,0 +1,449 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file builds the word index of a text with bounded memory, by external
+ * sorting. The tokenizer fills a pool of words and an array of (word, line)
+ * pairs. When either is full the pairs are sorted by word and line and
+ * written to a run file, in which every word appears once, followed by its
+ * lines. Runs are written in text order, so for a word the lines of an
+ * earlier run all come before those of a later run. At the end the runs are
+ * merged: every step takes the smallest word of all runs and joins its lines
+ * from the runs in run order into a compressed array, which is written to the
+ * index file. More than MERGE_FANIN runs are first merged in groups of
+ * consecutive runs into longer runs, to bound the number of open files.
+ *
+ * A run is a sequence of entries: the length of the word as uint32_t, the
+ * word without NUL, the number of lines as uint32_t and the lines as
+ * int32_t, all in host byte order.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_ext.h"
+#include "external_build.h"
+#include "index_file.h"
+#include "tokenize.h"
+
+/* Maximum number of runs merged at once. */
+#define MERGE_FANIN 16
+
+/* Part of the budget used for the word pool, the rest holds the pairs. */
+#define POOL_SHARE 4
+
+/* A word of the text with its line. */
+struct pair {
+    const char *word;
+    int line;
+};
+
+/* State of a build while the text is tokenized. */
+struct build_state {
+    /* Words of the pairs, NUL terminated */
+    char *pool;
+    size_t pool_used;
+    size_t pool_size;
+    struct pair *pairs;
+    size_t n_pairs;
+    size_t max_pairs;
+    /* Name of the index, the runs are named after it */
+    const char *filename;
+    /* Numbers of the run files in text order */
+    unsigned long *runs;
+    unsigned long n_runs;
+    unsigned long runs_capacity;
+    /* Number of the next run file */
+    unsigned long next_run;
+};
+
+/* A run file being merged, positioned after the header of its current
+ * entry. */
+struct run_reader {
+    FILE *in;
+    /* Word of the current entry, NUL terminated */
+    char *word;
+    size_t word_size;
+    /* Lines of the current entry that are not read yet */
+    uint32_t n_lines;
+    /* Set at the end of the run */
+    int done;
+};
+
+/* Called by merge_runs for every word with all its lines. */
+typedef int (*merge_sink)(void *ctx, const char *word, const struct array *lines);
+
+/* Write the name of run number n to name, which has room for it. */
+static void run_name(char *name, const char *filename, unsigned long n) {
+    sprintf(name, "%s.run%lu", filename, n);
+}
+
+/* Return a newly allocated buffer large enough for the name of any run. */
+static char *alloc_run_name(const char *filename) {
+    return malloc(strlen(filename) + 32);
+}
+
+/* Remove run number n. */
+static void remove_run(const char *filename, unsigned long n) {
+    char *name = alloc_run_name(filename);
+    if (name != NULL) {
+        run_name(name, filename, n);
+        remove(name);
+        free(name);
+    }
+}
+
+/* Compare two pairs by word and then by line, for qsort. */
+static int compare_pairs(const void *a, const void *b) {
+    const struct pair *x = a;
+    const struct pair *y = b;
+    int res = strcmp(x->word, y->word);
+    if (res != 0) {
+        return res;
+    }
+    return (x->line > y->line) - (x->line < y->line);
+}
+
+/*
+ * Write the header of a run entry.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int write_entry_header(FILE *out, const char *word, uint32_t n_lines) {
+    uint32_t len = (uint32_t)strlen(word);
+    return fwrite(&len, sizeof(len), 1, out) != 1
+           || fwrite(word, 1, len, out) != len
+           || fwrite(&n_lines, sizeof(n_lines), 1, out) != 1;
+}
+
+/*
+ * Add a new run number to the list of runs.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int add_run(struct build_state *b, unsigned long n) {
+    if (b->n_runs == b->runs_capacity) {
+        unsigned long capacity = b->runs_capacity > 0 ? 2 * b->runs_capacity : 16;
+        unsigned long *bigger = realloc(b->runs, capacity * sizeof(unsigned long));
+        if (bigger == NULL) {
+            return 1;
+        }
+        b->runs = bigger;
+        b->runs_capacity = capacity;
+    }
+    b->runs[b->n_runs++] = n;
+    return 0;
+}
+
+/*
+ * Sort the collected pairs and write them as the next run, with the lines
+ * of every word once. Empties the pool and the pairs.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int spill_run(struct build_state *b) {
+    if (b->n_pairs == 0) {
+        return 0;
+    }
+    qsort(b->pairs, b->n_pairs, sizeof(struct pair), compare_pairs);
+
+    char *name = alloc_run_name(b->filename);
+    if (name == NULL) {
+        return 1;
+    }
+    unsigned long n = b->next_run++;
+    run_name(name, b->filename, n);
+    FILE *out = fopen(name, "wb");
+    free(name);
+    if (out == NULL) {
+        return 1;
+    }
+    int failed = add_run(b, n);
+    if (failed) {
+        fclose(out);
+        remove_run(b->filename, n);
+        return 1;
+    }
+
+    for (size_t start = 0, end; start < b->n_pairs && !failed; start = end) {
+        const char *word = b->pairs[start].word;
+        uint32_t n_lines = 1;
+        for (end = start + 1; end < b->n_pairs && strcmp(b->pairs[end].word, word) == 0; end++) {
+            if (b->pairs[end].line != b->pairs[end - 1].line) {
+                n_lines++;
+            }
+        }
+
+        failed = write_entry_header(out, word, n_lines);
+        for (size_t i = start; i < end && !failed; i++) {
+            if (i == start || b->pairs[i].line != b->pairs[i - 1].line) {
+                int32_t line = b->pairs[i].line;
+                failed = fwrite(&line, sizeof(line), 1, out) != 1;
+            }
+        }
+    }
+    if (fclose(out) != 0) {
+        failed = 1;
+    }
+
+    b->pool_used = 0;
+    b->n_pairs = 0;
+    return failed;
+}
+
+/* Collect a word of the text, spilling a run first if the pool or the
+ * pairs are full. */
+static int add_pair(void *ctx, const char *word, size_t len, unsigned long line_number) {
+    struct build_state *b = ctx;
+    if (len + 1 > b->pool_size) {
+        return 1;
+    }
+    if (b->pool_used + len + 1 > b->pool_size || b->n_pairs == b->max_pairs) {
+        if (spill_run(b) != 0) {
+            return 1;
+        }
+    }
+
+    char *copy = b->pool + b->pool_used;
+    memcpy(copy, word, len + 1);
+    b->pool_used += len + 1;
+    b->pairs[b->n_pairs].word = copy;
+    b->pairs[b->n_pairs].line = (int)line_number;
+    b->n_pairs++;
+    return 0;
+}
+
+/*
+ * Read the header of the next entry of a run, or mark the run done at its
+ * end.
+ *
+ * Returns 0 on success, 1 on a read error or a truncated run.
+ */
+static int read_entry_header(struct run_reader *r) {
+    uint32_t len;
+    if (fread(&len, sizeof(len), 1, r->in) != 1) {
+        r->done = 1;
+        return ferror(r->in) != 0;
+    }
+    if (len + 1 > r->word_size) {
+        char *bigger = realloc(r->word, len + 1);
+        if (bigger == NULL) {
+            return 1;
+        }
+        r->word = bigger;
+        r->word_size = len + 1;
+    }
+    if (fread(r->word, 1, len, r->in) != len
+        || fread(&r->n_lines, sizeof(r->n_lines), 1, r->in) != 1) {
+        return 1;
+    }
+    r->word[len] = '\0';
+    return 0;
+}
+
+/*
+ * Append the lines of the current entry of a run to lines, skipping a line
+ * that is already the last one, and move to the next entry.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int read_entry_lines(struct run_reader *r, struct array *lines) {
+    for (; r->n_lines > 0; r->n_lines--) {
+        int32_t line;
+        if (fread(&line, sizeof(line), 1, r->in) != 1) {
+            return 1;
+        }
+        if (array_size(lines) == 0 || array_last(lines) < line) {
+            if (array_append(lines, line) != 0) {
+                return 1;
+            }
+        }
+    }
+    return read_entry_header(r);
+}
+
+/*
+ * Merge runs, given in text order, and pass every word with all its lines to
+ * sink in strcmp order.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int merge_runs(const char *filename, const unsigned long *runs, unsigned long n,
+                      merge_sink sink, void *ctx) {
+    struct run_reader readers[MERGE_FANIN];
+    char *name = alloc_run_name(filename);
+    char *word = NULL;
+    size_t word_size = 0;
+    int failed = name == NULL;
+
+    memset(readers, 0, sizeof(readers));
+    for (unsigned long i = 0; i < n && !failed; i++) {
+        run_name(name, filename, runs[i]);
+        readers[i].in = fopen(name, "rb");
+        failed = readers[i].in == NULL || read_entry_header(&readers[i]) != 0;
+    }
+
+    while (!failed) {
+        /* The smallest word, the earliest run wins ties. */
+        struct run_reader *min = NULL;
+        for (unsigned long i = 0; i < n; i++) {
+            if (!readers[i].done && (min == NULL || strcmp(readers[i].word, min->word) < 0)) {
+                min = &readers[i];
+            }
+        }
+        if (min == NULL) {
+            break;
+        }
+
+        size_t len = strlen(min->word);
+        if (len + 1 > word_size) {
+            char *bigger = realloc(word, len + 1);
+            if (bigger == NULL) {
+                failed = 1;
+                break;
+            }
+            word = bigger;
+            word_size = len + 1;
+        }
+        memcpy(word, min->word, len + 1);
+
+        struct array *lines = array_init_compressed();
+        failed = lines == NULL;
+        for (unsigned long i = 0; i < n && !failed; i++) {
+            if (!readers[i].done && strcmp(readers[i].word, word) == 0) {
+                failed = read_entry_lines(&readers[i], lines);
+            }
+        }
+        failed = failed || sink(ctx, word, lines) != 0;
+        array_cleanup(lines);
+    }
+
+    for (unsigned long i = 0; i < n; i++) {
+        if (readers[i].in != NULL) {
+            fclose(readers[i].in);
+        }
+        free(readers[i].word);
+    }
+    free(word);
+    free(name);
+    return failed;
+}
+
+/* Write a merged word to a run file, ctx is the file. */
+static int write_run_entry(void *ctx, const char *word, const struct array *lines) {
+    FILE *out = ctx;
+    if (write_entry_header(out, word, (uint32_t)array_size(lines)) != 0) {
+        return 1;
+    }
+    struct array_cursor c;
+    int line;
+    array_cursor_init(&c, lines);
+    while (array_cursor_next(&c, &line)) {
+        int32_t value = line;
+        if (fwrite(&value, sizeof(value), 1, out) != 1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Write a merged word to the index, ctx is the index writer. */
+static int write_index_entry(void *ctx, const char *word, const struct array *lines) {
+    return index_writer_add(ctx, word, lines);
+}
+
+/*
+ * Merge groups of MERGE_FANIN consecutive runs into single runs until at
+ * most MERGE_FANIN runs are left. The merged runs are removed.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int reduce_runs(struct build_state *b) {
+    char *name = alloc_run_name(b->filename);
+    if (name == NULL) {
+        return 1;
+    }
+
+    while (b->n_runs > MERGE_FANIN) {
+        unsigned long kept = 0;
+        for (unsigned long start = 0; start < b->n_runs; start += MERGE_FANIN) {
+            unsigned long count = b->n_runs - start < MERGE_FANIN ? b->n_runs - start
+                                                                  : MERGE_FANIN;
+            unsigned long n = b->next_run++;
+            run_name(name, b->filename, n);
+            FILE *out = fopen(name, "wb");
+            int failed = out == NULL
+                         || merge_runs(b->filename, b->runs + start, count, write_run_entry,
+                                       out) != 0;
+            if (out != NULL && fclose(out) != 0) {
+                failed = 1;
+            }
+            if (failed) {
+                remove(name);
+                free(name);
+                return 1;
+            }
+            for (unsigned long i = start; i < start + count; i++) {
+                remove_run(b->filename, b->runs[i]);
+            }
+            /* Later groups start after start, so this slot is free. */
+            b->runs[kept++] = n;
+        }
+        b->n_runs = kept;
+    }
+
+    free(name);
+    return 0;
+}
+
+/*
+ * Build the word index of a text into an index file with bounded memory.
+ *
+ * text: The text.
+ * size: Number of bytes of the text.
+ * filename: The index file to write.
+ * memory_budget: Number of bytes the collected pairs may take.
+ * hash_func: The hash function lookups will use.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int index_build_external(const unsigned char *text, size_t size, const char *filename,
+                         size_t memory_budget,
+                         unsigned long (*hash_func)(const unsigned char *)) {
+    if (filename == NULL || hash_func == NULL || memory_budget < EXTERNAL_MIN_BUDGET) {
+        return 1;
+    }
+
+    struct build_state b;
+    memset(&b, 0, sizeof(b));
+    b.filename = filename;
+    b.pool_size = memory_budget / POOL_SHARE;
+    b.max_pairs = (memory_budget - b.pool_size) / sizeof(struct pair);
+    b.pool = malloc(b.pool_size);
+    b.pairs = malloc(b.max_pairs * sizeof(struct pair));
+
+    int failed = b.pool == NULL || b.pairs == NULL;
+    failed = failed || tokenize(text, size, 1, add_pair, &b) != 0;
+    failed = failed || spill_run(&b) != 0;
+    free(b.pool);
+    free(b.pairs);
+    failed = failed || reduce_runs(&b) != 0;
+
+    if (!failed) {
+        struct index_writer *w = index_writer_open(filename, hash_func);
+        failed = w == NULL;
+        if (!failed) {
+            failed = merge_runs(filename, b.runs, b.n_runs, write_index_entry, w) != 0;
+            failed = index_writer_close(w, !failed) || failed;
+        }
+    }
+
+    for (unsigned long i = 0; i < b.n_runs; i++) {
+        remove_run(filename, b.runs[i]);
+    }
+    free(b.runs);
+    return failed;
+}
@@ -0,0 +1,26 @@
+#ifndef EXTERNAL_BUILD_H
+#define EXTERNAL_BUILD_H
+
+#include <stddef.h>
+
+/* Building the word index of a text that is too large for its table to fit
+ * in memory. Instead of a table, the (word, line) pairs of the text are
+ * collected up to a memory budget, sorted and written to run files, and the
+ * runs are merged into an index file (see index_file.h), which table_load
+ * opens like any saved index. */
+
+/* Smallest memory budget index_build_external accepts. */
+#define EXTERNAL_MIN_BUDGET (64 * 1024)
+
+/* Build the word index of size bytes of text and write it to the index file
+ * filename, for lookups with hash_func. The pairs of the text take at most
+ * memory_budget bytes. Merging needs memory for the posting list of one word
+ * at a time and 16 bytes per distinct word. The runs are written next to the
+ * index as filename.run<n> and removed again. A word must fit in a quarter
+ * of the budget. Returns 0 on success and 1 on failure, also if
+ * memory_budget is below EXTERNAL_MIN_BUDGET. */
+int index_build_external(const unsigned char *text, size_t size, const char *filename,
+                         size_t memory_budget,
+                         unsigned long (*hash_func)(const unsigned char *));
+
+#endif /* EXTERNAL_BUILD_H */
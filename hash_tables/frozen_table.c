@@ -0,0 +1,420 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file implements a read-only table in which every key has its own
+ * slot, found with a minimal perfect hash function in the style of PTHash
+ * (https://arxiv.org/abs/2104.10402). Every key is hashed to 64 bits with a
+ * seed and assigned to a bucket; 60% of the keys go to the first 30% of the
+ * buckets, which makes the buckets unequal in size. Buckets are placed from
+ * the largest to the smallest: for each one the pilot values 0, 1, 2, ... are
+ * tried until the slots (hash ^ mix(pilot)) % n_slots of all its keys are
+ * free. A lookup then only needs the hash of the key, the pilot of its
+ * bucket, the slot and one key compare.
+ *
+ * The keys are stored NUL terminated one after another in slot order, and the
+ * values as array images (see array_image_write) in one block, with a block
+ * of read-only views of the images in slot order next to them. The table has
+ * no per-key allocations and lookups never write to it, so threads can share
+ * a frozen table. If no seed works the table falls back to a few
+ * percent of extra slots, which are then left empty.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_ext.h"
+#include "frozen_table.h"
+#include "hash_table_ext.h"
+
+/* Average number of keys per bucket. */
+#define BUCKET_SIZE 4
+
+/* Pilots tried per bucket before a seed is given up. */
+#define MAX_PILOT (1u << 24)
+
+/* Seeds tried before extra slots are added. */
+#define MAX_SEEDS 8
+
+/* Key offset of an empty slot. */
+#define EMPTY_SLOT UINT32_MAX
+
+struct frozen_table {
+    /* Seed of the key hash */
+    uint64_t seed;
+    unsigned long n_keys;
+    unsigned long n_slots;
+    unsigned long n_buckets;
+    /* Number of buckets that get 60% of the keys */
+    unsigned long n_dense;
+    /* Pilot of every bucket */
+    uint32_t *pilots;
+    /* Offset of the key of every slot in keys, EMPTY_SLOT for empty slots */
+    uint32_t *key_offsets;
+    char *keys;
+    uint32_t *images;
+    /* Bytes of keys and images */
+    size_t keys_size;
+    size_t images_size;
+    /* View of the images of every slot, array_footprint() bytes each, left
+     * uninitialised for empty slots */
+    unsigned char *views;
+};
+
+/* A key of the source table while the table is built. */
+struct entry {
+    const char *key;
+    struct array *values;
+    uint64_t hash;
+};
+
+/* Finalizer of MurmurHash3, mixes all bits of x into all bits. */
+static uint64_t fmix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* Seeded 64 bit hash of a key: FNV-1a followed by a finalizer. */
+static uint64_t key_hash(const char *key, uint64_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (const unsigned char *c = (const unsigned char *)key; *c != '\0'; c++) {
+        h ^= *c;
+        h *= 0x100000001b3ULL;
+    }
+    return fmix64(h);
+}
+
+/* The bucket of a hash. The low half decides between the dense and the
+ * sparse buckets, the high half picks one of them. */
+static unsigned long hash_bucket(uint64_t hash, unsigned long n_buckets, unsigned long n_dense) {
+    uint64_t high = hash >> 32;
+    if ((uint32_t)hash < 0x9999999aU) {
+        return (unsigned long)(high % n_dense);
+    }
+    return n_dense + (unsigned long)(high % (n_buckets - n_dense));
+}
+
+/* The slot of a hash for a given pilot. */
+static unsigned long hash_slot(uint64_t hash, uint32_t pilot, unsigned long n_slots) {
+    return (unsigned long)((hash ^ fmix64(pilot + 1)) % n_slots);
+}
+
+/* Add a key of the source table to the entries in ctx. */
+static int add_entry(void *ctx, const char *key, struct array *values) {
+    struct entry **next = ctx;
+    (*next)->key = key;
+    (*next)->values = values;
+    (*next)++;
+    return 0;
+}
+
+/* Count a key of the source table. */
+static int count_entry(void *ctx, const char *key, struct array *values) {
+    (void)key;
+    (void)values;
+    (*(unsigned long *)ctx)++;
+    return 0;
+}
+
+/*
+ * Try to find a pilot for every bucket with the current seed and sizes.
+ *
+ * f: The table, with seed, n_keys, n_slots, n_buckets and n_dense set.
+ * entries: The keys, hashed with the seed.
+ * slot_entry: Set to the entry of every slot, or n_keys for empty slots.
+ *
+ * Returns 0 on success, 1 if some bucket has no pilot or memory ran out.
+ */
+static int place_buckets(struct frozen_table *f, struct entry *entries,
+                         unsigned long *slot_entry) {
+    unsigned long n = f->n_keys;
+    unsigned long nb = f->n_buckets;
+    /* Entries sorted by bucket, with the start of every bucket */
+    unsigned long *start = calloc(nb + 1, sizeof(unsigned long));
+    unsigned long *by_bucket = malloc((n + 1) * sizeof(unsigned long));
+    /* Buckets sorted by size, largest first */
+    unsigned long *order = malloc(nb * sizeof(unsigned long));
+    /* Slots of the keys of the bucket being placed, first used for sorting */
+    unsigned long *slots = malloc((n > nb ? n : nb) * sizeof(unsigned long) + sizeof(unsigned long));
+    int failed = start == NULL || by_bucket == NULL || order == NULL || slots == NULL;
+
+    if (!failed) {
+        unsigned long max_size = 0;
+        for (unsigned long i = 0; i < n; i++) {
+            start[hash_bucket(entries[i].hash, nb, f->n_dense) + 1]++;
+        }
+        for (unsigned long b = 0; b < nb; b++) {
+            max_size = start[b + 1] > max_size ? start[b + 1] : max_size;
+            start[b + 1] += start[b];
+        }
+        memcpy(slots, start, nb * sizeof(unsigned long));
+        for (unsigned long i = 0; i < n; i++) {
+            by_bucket[slots[hash_bucket(entries[i].hash, nb, f->n_dense)]++] = i;
+        }
+
+        /* Counting sort of the buckets on size, from large to small. */
+        unsigned long *first = calloc(max_size + 2, sizeof(unsigned long));
+        if (first == NULL) {
+            failed = 1;
+        } else {
+            for (unsigned long b = 0; b < nb; b++) {
+                first[max_size - (start[b + 1] - start[b]) + 1]++;
+            }
+            for (unsigned long size = 0; size <= max_size; size++) {
+                first[size + 1] += first[size];
+            }
+            for (unsigned long b = 0; b < nb; b++) {
+                order[first[max_size - (start[b + 1] - start[b])]++] = b;
+            }
+            free(first);
+        }
+        for (unsigned long s = 0; s < f->n_slots; s++) {
+            slot_entry[s] = n;
+        }
+
+        /* Empty buckets come last, their pilot is never used. */
+        for (unsigned long o = 0; o < nb && !failed; o++) {
+            unsigned long b = order[o];
+            unsigned long size = start[b + 1] - start[b];
+            if (size == 0) {
+                break;
+            }
+            uint32_t pilot = 0;
+            for (;; pilot++) {
+                if (pilot == MAX_PILOT) {
+                    failed = 1;
+                    break;
+                }
+                unsigned long placed = 0;
+                for (; placed < size; placed++) {
+                    unsigned long e = by_bucket[start[b] + placed];
+                    slots[placed] = hash_slot(entries[e].hash, pilot, f->n_slots);
+                    if (slot_entry[slots[placed]] != n) {
+                        break;
+                    }
+                    /* Claim the slot, so keys of this bucket that land on
+                     * the same slot are caught too. */
+                    slot_entry[slots[placed]] = e;
+                }
+                if (placed == size) {
+                    break;
+                }
+                for (unsigned long j = 0; j < placed; j++) {
+                    slot_entry[slots[j]] = n;
+                }
+            }
+            f->pilots[b] = pilot;
+        }
+    }
+
+    free(start);
+    free(by_bucket);
+    free(order);
+    free(slots);
+    return failed;
+}
+
+/*
+ * Copy the keys and values into the packed arrays in slot order.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int pack_entries(struct frozen_table *f, const struct entry *entries,
+                        const unsigned long *slot_entry) {
+    size_t keys_size = 0;
+    size_t images_size = 0;
+    for (unsigned long i = 0; i < f->n_keys; i++) {
+        keys_size += strlen(entries[i].key) + 1;
+        images_size += (array_image_size(entries[i].values) + 3) & ~(size_t)3;
+    }
+    if (keys_size >= EMPTY_SLOT || images_size / 4 >= UINT32_MAX) {
+        return 1;
+    }
+
+    f->keys = malloc(keys_size > 0 ? keys_size : 1);
+    f->images = malloc(images_size > 0 ? images_size : 4);
+    if (f->keys == NULL || f->images == NULL) {
+        return 1;
+    }
+    f->keys_size = keys_size;
+    f->images_size = images_size;
+
+    size_t key_at = 0;
+    size_t image_at = 0;
+    for (unsigned long s = 0; s < f->n_slots; s++) {
+        if (slot_entry[s] == f->n_keys) {
+            f->key_offsets[s] = EMPTY_SLOT;
+            continue;
+        }
+        const struct entry *e = &entries[slot_entry[s]];
+        size_t key_size = strlen(e->key) + 1;
+        memcpy(f->keys + key_at, e->key, key_size);
+        f->key_offsets[s] = (uint32_t)key_at;
+        key_at += key_size;
+
+        array_image_write(e->values, f->images + image_at / 4);
+        array_view_at(f->views + s * array_footprint(), f->images + image_at / 4);
+        image_at += (array_image_size(e->values) + 3) & ~(size_t)3;
+    }
+    return 0;
+}
+
+/*
+ * Build a frozen table from the keys and values of a table.
+ *
+ * t: The table, it is not changed.
+ *
+ * Returns a pointer to the frozen table, or NULL on failure.
+ */
+struct frozen_table *frozen_build(const struct table *t) {
+    unsigned long n = 0;
+    if (table_foreach(t, count_entry, &n) != 0) {
+        return NULL;
+    }
+
+    struct frozen_table *f = calloc(1, sizeof(struct frozen_table));
+    struct entry *entries = malloc((n > 0 ? n : 1) * sizeof(struct entry));
+    if (f == NULL || entries == NULL) {
+        free(f);
+        free(entries);
+        return NULL;
+    }
+    struct entry *next = entries;
+    table_foreach(t, add_entry, &next);
+
+    f->n_keys = n;
+    f->n_slots = n > 0 ? n : 1;
+    f->n_buckets = n / BUCKET_SIZE + 2;
+    f->n_dense = f->n_buckets * 3 / 10 > 0 ? f->n_buckets * 3 / 10 : 1;
+    f->pilots = calloc(f->n_buckets, sizeof(uint32_t));
+    unsigned long *slot_entry = NULL;
+    int failed = f->pilots == NULL;
+
+    for (int attempt = 0; !failed; attempt++) {
+        if (attempt > 0 && attempt % MAX_SEEDS == 0) {
+            f->n_slots += f->n_slots / 32 + 1;
+        }
+        free(slot_entry);
+        slot_entry = malloc(f->n_slots * sizeof(unsigned long));
+        if (slot_entry == NULL) {
+            failed = 1;
+            break;
+        }
+        f->seed = fmix64((uint64_t)attempt + 1);
+        for (unsigned long i = 0; i < n; i++) {
+            entries[i].hash = key_hash(entries[i].key, f->seed);
+        }
+        if (place_buckets(f, entries, slot_entry) == 0) {
+            break;
+        }
+    }
+
+    if (!failed) {
+        f->key_offsets = malloc(f->n_slots * sizeof(uint32_t));
+        f->views = malloc(f->n_slots * array_footprint());
+        failed = f->key_offsets == NULL || f->views == NULL
+                 || pack_entries(f, entries, slot_entry) != 0;
+    }
+
+    free(slot_entry);
+    free(entries);
+    if (failed) {
+        frozen_cleanup(f);
+        return NULL;
+    }
+    return f;
+}
+
+/*
+ * Returns the seeded hash of a key.
+ */
+unsigned long frozen_hash(const struct frozen_table *f, const char *key) {
+    return (unsigned long)key_hash(key, f->seed);
+}
+
+/*
+ * Return the view of the values of a full slot.
+ */
+static struct array *slot_values(const struct frozen_table *f, unsigned long s) {
+    return (struct array *)(void *)(f->views + s * array_footprint());
+}
+
+/*
+ * Look up a key.
+ *
+ * Returns the values stored for the key, or NULL if it is not present.
+ */
+struct array *frozen_find(const struct frozen_table *f, const char *key,
+                          unsigned long hash) {
+    unsigned long b = hash_bucket(hash, f->n_buckets, f->n_dense);
+    unsigned long s = hash_slot(hash, f->pilots[b], f->n_slots);
+    if (f->key_offsets[s] == EMPTY_SLOT || strcmp(f->keys + f->key_offsets[s], key) != 0) {
+        return NULL;
+    }
+    return slot_values(f, s);
+}
+
+/*
+ * Prefetch the pilot of the bucket of a hash.
+ */
+void frozen_prefetch(const struct frozen_table *f, unsigned long hash) {
+    __builtin_prefetch(&f->pilots[hash_bucket(hash, f->n_buckets, f->n_dense)]);
+}
+
+/*
+ * Call a function for every key in the table.
+ *
+ * Returns 0 if func returned 0 for all keys, otherwise its first non-zero
+ * return value.
+ */
+int frozen_foreach(const struct frozen_table *f,
+                   int (*func)(void *ctx, const char *key, struct array *value),
+                   void *ctx) {
+    for (unsigned long s = 0; s < f->n_slots; s++) {
+        if (f->key_offsets[s] != EMPTY_SLOT) {
+            int res = func(ctx, f->keys + f->key_offsets[s], slot_values(f, s));
+            if (res != 0) {
+                return res;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Returns the load factor of the table.
+ */
+double frozen_load_factor(const struct frozen_table *f) {
+    return (double)f->n_keys / (double)f->n_slots;
+}
+
+/*
+ * Returns the number of bytes of the table, the pilots and the per-slot key
+ * offsets and views.
+ */
+unsigned long frozen_memory(const struct frozen_table *f) {
+    return (unsigned long)(sizeof(struct frozen_table)
+                           + f->n_buckets * sizeof(uint32_t)
+                           + f->n_slots * (sizeof(uint32_t) + array_footprint()));
+}
+
+/*
+ * Free the table and its views.
+ */
+void frozen_cleanup(struct frozen_table *f) {
+    if (f == NULL) {
+        return;
+    }
+    free(f->views);
+    free(f->pilots);
+    free(f->key_offsets);
+    free(f->keys);
+    free(f->images);
+    free(f);
+}
@@ -0,0 +1,51 @@
+#ifndef FROZEN_TABLE_H
+#define FROZEN_TABLE_H
+
+/* Static table built from the keys and values of another table, used as the
+ * TABLE_FROZEN backend of the hash table in hash_table.c. Keys are placed
+ * with a minimal perfect hash function, so a lookup takes one hash, one slot
+ * and one key compare. Keys and values are packed into contiguous arrays.
+ * The table hashes keys with its own seeded hash function, so weak hash
+ * functions of the source table do not matter. */
+
+struct array;
+struct table;
+
+/* Handle to the frozen table. */
+struct frozen_table;
+
+/* Build a frozen table with the keys and values of t, which is not changed.
+ * Returns NULL on failure. */
+struct frozen_table *frozen_build(const struct table *t);
+
+/* Returns the hash of key that frozen_find and frozen_prefetch take. */
+unsigned long frozen_hash(const struct frozen_table *f, const char *key);
+
+/* Returns the values stored for key, or NULL if the key is not present. The
+ * values are read-only views created by frozen_build, so lookups do not
+ * change the table and threads can share it. hash must be
+ * frozen_hash(f, key). */
+struct array *frozen_find(const struct frozen_table *f, const char *key,
+                          unsigned long hash);
+
+/* Prefetches the pilot of the bucket of hash. */
+void frozen_prefetch(const struct frozen_table *f, unsigned long hash);
+
+/* Calls func for every key with its values until func returns non-zero.
+ * Returns 0 or the non-zero return value of func. */
+int frozen_foreach(const struct frozen_table *f,
+                   int (*func)(void *ctx, const char *key, struct array *value),
+                   void *ctx);
+
+/* Returns the number of keys / the number of slots, 1.0 unless the build had
+ * to fall back to extra slots. */
+double frozen_load_factor(const struct frozen_table *f);
+
+/* Returns the number of bytes of the table, its pilots and its slots,
+ * without the keys and values. */
+unsigned long frozen_memory(const struct frozen_table *f);
+
+/* Frees the table and the views handed out by frozen_find. */
+void frozen_cleanup(struct frozen_table *f);
+
+#endif /* FROZEN_TABLE_H */
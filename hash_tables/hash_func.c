@@ -1,3 +1,6 @@
+#include <stdint.h>
+#include <string.h>
+
 #include "hash_func.h"
 
 /* Do not edit this function, as it used in testing too
@@ -6,3 +9,143 @@ unsigned long hash_too_simple(const unsigned char *str) {
     return (unsigned long) *str;
 }
 
+/* 64 bit FNV-1a.
+ * Source: http://www.isthe.com/chongo/tech/comp/fnv/ */
+unsigned long hash_fnv1a(const unsigned char *str) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *str != '\0'; str++) {
+        hash ^= *str;
+        hash *= 1099511628211ULL;
+    }
+    return (unsigned long) hash;
+}
+
+/* Read 8, 4 or 3 (or less) bytes of a key, little endian on the usual
+ * machines. memcpy keeps unaligned reads well defined. */
+static uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read_small(const unsigned char *p, size_t len) {
+    return ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+}
+
+/* Replace a and b by the low and high half of their 128 bit product. Done
+ * in 32 bit parts to stay within ISO C. */
+static void mum(uint64_t *a, uint64_t *b) {
+    uint64_t a_lo = *a & 0xffffffffULL, a_hi = *a >> 32;
+    uint64_t b_lo = *b & 0xffffffffULL, b_hi = *b >> 32;
+
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_hi = a_hi * b_hi;
+
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+    *b = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    *a = (cross << 32) | (lo_lo & 0xffffffffULL);
+}
+
+/* Multiply and fold the 128 bit product back to 64 bits. */
+static uint64_t mix(uint64_t a, uint64_t b) {
+    mum(&a, &b);
+    return a ^ b;
+}
+
+/* 64 bit hash in the style of wyhash: short keys are read in at most two
+ * overlapping loads, longer keys 16 bytes per round.
+ * Source: https://github.com/wangyi-fudan/wyhash */
+unsigned long hash_wy64(const unsigned char *str) {
+    const uint64_t secret[4] = { 0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+                                 0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL };
+    size_t len = strlen((const char *) str);
+    const unsigned char *p = str;
+    uint64_t seed = mix(secret[0], secret[1]);
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t mid = (len >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + mid);
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+        } else if (len > 0) {
+            a = read_small(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        while (i > 16) {
+            seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    mum(&a, &b);
+    return (unsigned long) mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+static uint32_t rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+/* MurmurHash3 x86_32 with seed 0.
+ * Source: https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp */
+unsigned long hash_murmur3(const unsigned char *str) {
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+    size_t len = strlen((const char *) str);
+    size_t nblocks = len / 4;
+    uint32_t h = 0;
+
+    for (size_t i = 0; i < nblocks; i++) {
+        uint32_t k;
+        memcpy(&k, str + i * 4, sizeof(k));
+        k *= c1;
+        k = rotl32(k, 15);
+        k *= c2;
+
+        h ^= k;
+        h = rotl32(h, 13);
+        h = h * 5 + 0xe6546b64;
+    }
+
+    const unsigned char *tail = str + nblocks * 4;
+    uint32_t k = 0;
+    switch (len & 3) {
+    case 3:
+        k ^= (uint32_t) tail[2] << 16;
+        /* fall through */
+    case 2:
+        k ^= (uint32_t) tail[1] << 8;
+        /* fall through */
+    case 1:
+        k ^= tail[0];
+        k *= c1;
+        k = rotl32(k, 15);
+        k *= c2;
+        h ^= k;
+    }
+
+    h ^= (uint32_t) len;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
@@ -2,6 +2,15 @@
 /* Example hash function with terrible performance */
 unsigned long hash_too_simple(const unsigned char *str);
 
-/* Add the header for your own added hash functions here. You may search online
- * for existing solutions for hashing function, as long as you as you
- * attribute the source, meaning links to the used material.  */
+/* 64 bit FNV-1a, a byte at a time xor and multiply.
+ * Source: http://www.isthe.com/chongo/tech/comp/fnv/ */
+unsigned long hash_fnv1a(const unsigned char *str);
+
+/* 64 bit hash in the style of wyhash, reads 8 bytes at a time and mixes them
+ * with a folded 64x64 -> 128 bit multiply.
+ * Source: https://github.com/wangyi-fudan/wyhash */
+unsigned long hash_wy64(const unsigned char *str);
+
+/* MurmurHash3, the x86_32 variant with seed 0.
+ * Source: https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp */
+unsigned long hash_murmur3(const unsigned char *str);
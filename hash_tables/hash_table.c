@@ -6,15 +6,57 @@
  * This file implements a hash table that uses separate chaining for collision
  * resolution. Each key is associated with an array of integer values, which dynamically
  * resizes as needed. The hash table supports insertion, lookup, deletion, resizing, 
- * and cleanup.
+ * and cleanup. Tables created with table_init_mode can instead store their keys
+ * in one of the open addressing backends, in which case the calls are forwarded
+ * to it, or spread the work of a resize over the operations that follow it.
+ * A table can also be saved to an index file, and loaded back as a read-only
+ * table that answers lookups straight from the mapped file, or be frozen into
+ * a read-only table with a perfect hash function. Chained tables shrink
+ * again when deletes drop their load factor below a minimum, and
+ * table_compact rebuilds any table at the size its keys need. With the
+ * TABLE_BLOOM option a Bloom filter of all keys is kept next to the table,
+ * which answers most lookups of absent keys on its own. Every table counts its
+ * lookups and resizes, which table_stats reports together with the shape and
+ * memory use of the table.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <math.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "array_ext.h"
+#include "bloom.h"
+#include "cuckoo_table.h"
+#include "frozen_table.h"
+#include "hash_table_ext.h"
+#include "index_file.h"
+#include "robin_hood.h"
+#include "swiss_table.h"
+
+/* Least number of old buckets moved by every operation during an
+ * incremental resize. */
+#define MIGRATE_BUCKETS 8
+
+/* Size of the chunks of the arena of a TABLE_ARENA table. */
+#define ARENA_CHUNK_SIZE (64 * 1024)
 
-#include "array.h"
-#include "hash_table.h"
+/* Number of keys of a batch lookup whose buckets are fetched together. */
+#define BATCH_WINDOW 16
+
+/* Bits of the mode that select the backend, the others are options. */
+#define BACKEND_MASK 0xff
+
+/* The default minimum load factor is the maximum divided by this. */
+#define MIN_LOAD_DIVISOR 4
 
 struct table {
     /* The (simple) array used to index the table */
@@ -23,34 +65,139 @@ struct table {
     unsigned long (*hash_func)(const unsigned char *);
     /* Maximum load factor after which the table array should be resized */
     double max_load_factor;
+    /* Load factor below which deletes shrink the table array again */
+    double min_load_factor;
     /* Capacity of the array used to index the table */
     unsigned long capacity;
+    /* Capacity the table was created with, it never shrinks below that */
+    unsigned long min_capacity;
     /* Current number of elements stored in the table */
     unsigned long load;
+
+    /* Storage backend, one of the TABLE_* modes */
+    int mode;
+    /* TABLE_* options the table was created with */
+    int options;
+    /* Open addressing storage, only used in TABLE_ROBIN_HOOD mode */
+    struct robin_table *robin;
+    /* Group probing storage, only used in TABLE_SWISS mode */
+    struct swiss_table *swiss;
+    /* Bucketized cuckoo storage, only used in TABLE_CUCKOO mode */
+    struct cuckoo_table *cuckoo;
+    /* Mapped index file, only used in TABLE_MAPPED mode */
+    struct index_file *index;
+    /* Perfect hash storage, only used in TABLE_FROZEN mode */
+    struct frozen_table *frozen;
+    /* State of an incremental resize, only used with TABLE_INCREMENTAL_RESIZE */
+    struct migration *migration;
+    /* Allocator for nodes, keys and value arrays, only used with TABLE_ARENA */
+    struct arena *arena;
+    /* Lookup and resize counters for table_stats */
+    struct table_counters *counters;
+    /* Filter of the keys, only used with TABLE_BLOOM */
+    struct bloom *bloom;
+    /* Keys added to the filter, and how many of them were deleted since */
+    unsigned long bloom_keys;
+    unsigned long bloom_stale;
 };
 
 /* Note: This struct should be a *strong* hint to a specific type of hash table
  * You may implement other options, if you can build them in such a way they
  * pass all tests. However, the other options are generally harder to code. */
 struct node {
-    /* The string of characters that is the key for this node */
-    char *key;
-    /* A resizing array, containing the all the integer values for this key */
-    struct array *value;
-
     /* Next pointer */
     struct node *next;
+    /* Full hash of the key, so resizing never calls the hash function again */
+    unsigned long hash;
+    /* Length of the key, compared before the key itself. The resizing array
+     * with all the integer values for this key is embedded in the same block
+     * as the node, right after the key, so its place follows from key_len. */
+    size_t key_len;
+    /* The string of characters that is the key for this node */
+    char key[];
+};
+
+/* Bookkeeping for an incremental resize. While old_array is not NULL, the
+ * buckets from index next onwards still have to be moved to the table array.
+ * Only inserts and deletes move buckets, lookups search both arrays. */
+struct migration {
+    /* The array the table is being resized from, NULL if no resize is going on */
+    struct node **old_array;
+    /* Capacity of the old array */
+    unsigned long old_capacity;
+    /* First old bucket that has not been moved yet */
+    unsigned long next;
+    /* Buckets moved by every insert and delete, enough to empty the old
+     * array before the next resize can start */
+    unsigned long step;
 };
 
+/* Counters of the lookups and resizes of a table. Kept behind a pointer so
+ * lookups on a const table can count themselves, which they only do after
+ * table_count_lookups turned it on. */
+struct table_counters {
+    /* Set if lookups are counted */
+    int count_lookups;
+    unsigned long hits;
+    unsigned long misses;
+    /* Total number of keys compared by the hits and by the misses */
+    unsigned long hit_probes;
+    unsigned long miss_probes;
+    unsigned long max_hit_probes;
+    unsigned long max_miss_probes;
+    unsigned long resizes;
+    double resize_seconds;
+    /* Most old buckets of an incremental resize moved at once */
+    unsigned long max_moved;
+    /* Misses answered by the Bloom filter alone */
+    unsigned long bloom_rejects;
+};
+
+/* Return the time on the monotonic clock in seconds. */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Count a resize that started at start. */
+static void count_resize(const struct table *t, double start) {
+    t->counters->resizes++;
+    t->counters->resize_seconds += now() - start;
+}
+
+/* Count a lookup that compared probes keys, if lookups are counted. */
+static void count_lookup(const struct table *t, int hit, unsigned long probes) {
+    struct table_counters *c = t->counters;
+    if (!c->count_lookups) {
+        return;
+    }
+    if (hit) {
+        c->hits++;
+        c->hit_probes += probes;
+        if (probes > c->max_hit_probes) {
+            c->max_hit_probes = probes;
+        }
+    } else {
+        c->misses++;
+        c->miss_probes += probes;
+        if (probes > c->max_miss_probes) {
+            c->max_miss_probes = probes;
+        }
+    }
+}
+
 /* 
- * Resize the hash table to twice its current capacity.
+ * Move all nodes to a new bucket array. Any incremental resize must have
+ * finished.
  * 
- * t: The hash table to resize.
+ * t: The hash table.
+ * new_capacity: Number of buckets of the new array.
  * 
  * Returns 0 on success, 1 on failure.
  */
-int table_resize(struct table *t) {
-    unsigned long new_capacity = t->capacity * 2;
+static int rehash(struct table *t, unsigned long new_capacity) {
+    double start = now();
     struct node **new_array = calloc(new_capacity, sizeof(struct node *));
     if (new_array == NULL) {
         return 1;
@@ -61,7 +208,7 @@ int table_resize(struct table *t) {
         while (current != NULL) {
             struct node *next = current->next;
 
-            unsigned long new_index = t->hash_func((const unsigned char *)current->key) % new_capacity;
+            unsigned long new_index = current->hash % new_capacity;
             current->next = new_array[new_index];
             new_array[new_index] = current;
 
@@ -71,213 +218,1486 @@ int table_resize(struct table *t) {
     free(t->array);
     t->array = new_array;
     t->capacity = new_capacity;
+    count_resize(t, start);
 
     return 0;
 }
 
 /* 
- * Initialize a hash table.
+ * Resize the hash table to twice its current capacity.
  * 
- * capacity: Initial capacity of the hash table.
- * max_load_factor: Maximum load factor before resizing.
- * hash_func: Pointer to the hash function to use.
+ * t: The hash table to resize.
  * 
- * Returnsa pointer to the initialized hash table, or NULL on failure.
+ * Returns 0 on success, 1 on failure.
  */
-struct table *table_init(unsigned long capacity,
-                         double max_load_factor,
-                         unsigned long (*hash_func)(const unsigned char *)) {
-    if (capacity == 0 || max_load_factor <= 0 || hash_func == NULL) {
-        return NULL;
+int table_resize(struct table *t) {
+    return rehash(t, t->capacity * 2);
+}
+
+/* 
+ * Move up to limit buckets of an ongoing incremental resize to the new
+ * array, and free the old array once it is empty.
+ * 
+ * t: The hash table.
+ * limit: Maximum number of old buckets to move.
+ * 
+ * Returns the number of buckets moved.
+ */
+static unsigned long move_buckets(struct table *t, unsigned long limit) {
+    struct migration *m = t->migration;
+    if (m == NULL || m->old_array == NULL) {
+        return 0;
     }
 
-    struct table *t = malloc(sizeof(struct table));
-    if (t == NULL) {
-        return NULL;
+    unsigned long moved = 0;
+    for (; moved < limit && m->next < m->old_capacity; moved++) {
+        struct node *current = m->old_array[m->next];
+        while (current != NULL) {
+            struct node *next = current->next;
+
+            unsigned long new_index = current->hash % t->capacity;
+            current->next = t->array[new_index];
+            t->array[new_index] = current;
+
+            current = next;
+        }
+        m->old_array[m->next] = NULL;
+        m->next++;
     }
 
-    t->array = calloc(capacity, sizeof(struct node *));
-    if (t->array == NULL) {
-        free(t);
-        return NULL;
+    if (m->next == m->old_capacity) {
+        free(m->old_array);
+        m->old_array = NULL;
     }
-    t->hash_func = hash_func;
-    t->max_load_factor = max_load_factor;
-    t->capacity = capacity;
-    t->load = 0;
+    return moved;
+}
 
-    return t;
+/* Count the buckets moved by one insert or delete. */
+static void count_moved(const struct table *t, unsigned long moved) {
+    if (moved > t->counters->max_moved) {
+        t->counters->max_moved = moved;
+    }
 }
 
 /* 
- * Copies and inserts a key into the hash table, along with its value.
- * If the key already exists, the value is appended to the existing array.
+ * Move the buckets of an ongoing incremental resize that one insert or
+ * delete moves.
  * 
  * t: The hash table.
- * key: The key to insert.
- * value: The value to associate with the key.
+ */
+static void migrate_step(struct table *t) {
+    if (t->migration != NULL) {
+        count_moved(t, move_buckets(t, t->migration->step));
+    }
+}
+
+/* 
+ * Move all remaining buckets of an ongoing incremental resize.
+ * 
+ * t: The hash table.
+ * 
+ * Returns the number of buckets moved.
+ */
+static unsigned long finish_migration(struct table *t) {
+    return move_buckets(t, ULONG_MAX);
+}
+
+/* 
+ * Start an incremental resize to a new capacity, larger or smaller. New keys
+ * go to the new array straight away, the old buckets are moved by
+ * migrate_step. A previous resize that is still going on is finished first.
+ * 
+ * t: The hash table to resize.
+ * new_capacity: Number of buckets of the new array.
  * 
  * Returns 0 on success, 1 on failure.
  */
-int table_insert(struct table *t, const char *key, int value) {
-    if (t == NULL || key == NULL) {
+static int start_migration(struct table *t, unsigned long new_capacity) {
+    double start = now();
+    struct migration *m = t->migration;
+    count_moved(t, finish_migration(t));
+
+    struct node **new_array = calloc(new_capacity, sizeof(struct node *));
+    if (new_array == NULL) {
         return 1;
     }
 
-    unsigned long index = t->hash_func((const unsigned char *)key) % t->capacity;
-    struct node *current = t->array[index];
+    m->old_array = t->array;
+    m->old_capacity = t->capacity;
+    m->next = 0;
+    t->array = new_array;
+    t->capacity = new_capacity;
 
-    while (current != NULL) {
-        if (strcmp(current->key, key) == 0) {
-            if (array_append(current->value, value) != 0) {
-                return 1;
-            }
-            return 0;
-        }
-        current = current->next;
+    /* Every insert and delete changes the load by at most one, so the old
+     * array is empty before the load can reach either resize threshold and
+     * no resize has to finish this one at once. */
+    double room = t->max_load_factor * (double)t->capacity - (double)t->load;
+    if (t->min_load_factor > 0 && t->capacity / 2 >= t->min_capacity) {
+        double above = (double)t->load - t->min_load_factor * (double)t->capacity;
+        room = above < room ? above : room;
     }
-    struct node *new_node = malloc(sizeof(struct node));
-    if (new_node == NULL) {
-        return 1;
+    unsigned long ops = room >= 1 ? (unsigned long)room : 1;
+    m->step = (m->old_capacity + ops - 1) / ops;
+    if (m->step < MIGRATE_BUCKETS) {
+        m->step = MIGRATE_BUCKETS;
     }
-    new_node->key = malloc(strlen(key) + 1);
-    if (new_node->key == NULL) {
-        free(new_node);
-        return 1;
+    count_resize(t, start);
+
+    return 0;
+}
+
+/* 
+ * Check whether a node holds the given key. The stored hash and length rule
+ * out almost all other keys before any bytes are compared.
+ */
+static int node_matches(const struct node *n, const char *key,
+                        unsigned long hash, size_t key_len) {
+    return n->hash == hash && n->key_len == key_len
+           && memcmp(n->key, key, key_len) == 0;
+}
+
+/* 
+ * Allocate memory for a node, from the arena if the table has one.
+ * 
+ * Returns a pointer to the memory, or NULL on failure.
+ */
+static void *table_alloc(const struct table *t, size_t size) {
+    if (t->arena != NULL) {
+        return arena_alloc(t->arena, size);
     }
-    strcpy(new_node->key, key);
+    return malloc(size);
+}
 
-    new_node->value = array_init(4);
-    if (new_node->value == NULL) {
-        free(new_node->key);
-        free(new_node);
-        return 1;
+/* 
+ * Free memory from table_alloc. Arena memory is only released together with
+ * the arena.
+ */
+static void table_free(const struct table *t, void *mem) {
+    if (t->arena == NULL) {
+        free(mem);
     }
+}
 
-    if (array_append(new_node->value, value) != 0) {
-        array_cleanup(new_node->value);
-        free(new_node->key);
-        free(new_node);
-        return 1;
+/* Return the offset of the value array in the block of a node. */
+static size_t value_offset(size_t key_len) {
+    size_t align = alignof(max_align_t);
+    return (offsetof(struct node, key) + key_len + 1 + align - 1) / align * align;
+}
+
+/* Return the value array embedded in the block of a node. */
+static struct array *node_values(const struct node *n) {
+    /* The array is written through, like the rest of a node's block. */
+    return (struct array *)(uintptr_t)((const char *)n + value_offset(n->key_len));
+}
+
+/* 
+ * Create a node for a key in a single block: the node fields, the key bytes
+ * and then the value array, which keeps its first values inline.
+ * 
+ * Returns a pointer to the node, or NULL on failure.
+ */
+static struct node *node_create(const struct table *t, const char *key,
+                                unsigned long hash, size_t key_len) {
+    size_t offset = value_offset(key_len);
+
+    struct node *n = table_alloc(t, offset + array_footprint());
+    if (n == NULL) {
+        return NULL;
     }
-    new_node->next = t->array[index];
-    t->array[index] = new_node;
-    t->load++;
+    memcpy(n->key, key, key_len + 1);
+    n->hash = hash;
+    n->key_len = key_len;
+    array_init_at((char *)n + offset, t->arena, (t->options & TABLE_COMPRESSED) != 0);
+    n->next = NULL;
+    return n;
+}
 
-    if ((double)t->load / t->capacity > t->max_load_factor) {
-        if (table_resize(t) != 0) {
-            return 1;
+/* 
+ * Free a node together with the spilled values of its array.
+ */
+static void node_free(const struct table *t, struct node *n) {
+    array_cleanup(node_values(n));
+    table_free(t, n);
+}
+
+/* 
+ * Free the nodes of a bucket array, their keys and their value arrays.
+ * 
+ * t: The hash table the nodes belong to.
+ * array: The bucket array.
+ * capacity: Number of buckets in the array.
+ */
+static void free_nodes(const struct table *t, struct node **array, unsigned long capacity) {
+    for (unsigned long i = 0; i < capacity; i++) {
+        struct node *current = array[i];
+        while (current != NULL) {
+            struct node *temp = current;
+            current = current->next;
+            node_free(t, temp);
         }
     }
-    return 0;
 }
 
 /* 
- * Look up a key in the hash table and return its associated array of values.
+ * Find the link that points to the node of a key: either a bucket or the
+ * next pointer of the node before it. During an incremental resize the old
+ * array is searched as well.
  * 
  * t: The hash table.
- * key: The key to look up.
+ * key: The key to find.
+ * hash: The hash of the key.
+ * key_len: The length of the key.
+ * probes: If not NULL, set to the number of nodes compared.
  * 
- * Returns a pointer to the array of values, or NULL if the key is not found or t is NULL.
+ * Returns a pointer to the link, or NULL if the key is not present.
  */
-struct array *table_lookup(const struct table *t, const char *key) {
-    if (t == NULL || key == NULL) {
-        return NULL;
-    }
+static struct node **find_link(const struct table *t, const char *key,
+                               unsigned long hash, size_t key_len,
+                               unsigned long *probes) {
+    struct node **link = &t->array[hash % t->capacity];
+    unsigned long compared = 0;
+    struct node **found = NULL;
 
-    unsigned long index = t->hash_func((const unsigned char *)key) % t->capacity;
-    struct node *current = t->array[index];
+    for (; *link != NULL && found == NULL; link = &(*link)->next) {
+        compared++;
+        if (node_matches(*link, key, hash, key_len)) {
+            found = link;
+        }
+    }
 
-    while (current != NULL) {
-        if (strcmp(current->key, key) == 0) {
-            return current->value;
+    const struct migration *m = t->migration;
+    if (found == NULL && m != NULL && m->old_array != NULL) {
+        link = &m->old_array[hash % m->old_capacity];
+        for (; *link != NULL && found == NULL; link = &(*link)->next) {
+            compared++;
+            if (node_matches(*link, key, hash, key_len)) {
+                found = link;
+            }
         }
-        current = current->next;
     }
 
-    return NULL;
+    if (probes != NULL) {
+        *probes = compared;
+    }
+    return found;
 }
 
 /* 
- * Calculate the load factor of the hash table.
- * The load factor is defined as: number of elements stored / table capacity.
+ * Initialize a hash table.
  * 
- * t: The hash table.
+ * capacity: Initial capacity of the hash table.
+ * max_load_factor: Maximum load factor before resizing.
+ * hash_func: Pointer to the hash function to use.
  * 
- * Returns:
- * The load factor as a double. Returns -1.0 if the hash table is NULL or its 
- * capacity is zero.
+ * Returnsa pointer to the initialized hash table, or NULL on failure.
  */
-double table_load_factor(const struct table *t) {
-    if (t == NULL || t->capacity == 0) {
-        return -1.0;
-    }
-    return (double)t->load / t->capacity;
+struct table *table_init(unsigned long capacity,
+                         double max_load_factor,
+                         unsigned long (*hash_func)(const unsigned char *)) {
+    return table_init_mode(capacity, max_load_factor, hash_func, TABLE_CHAINING);
 }
 
 /* 
- * Remove the specified key and its associated values from the hash table.
+ * Initialize a hash table that uses the given storage backend.
  * 
- * t: The hash table.
- * key: The key to remove.
+ * capacity: Initial capacity of the hash table.
+ * max_load_factor: Maximum load factor before resizing.
+ * hash_func: Pointer to the hash function to use.
+ * mode: One of the TABLE_* backends from hash_table_ext.h, chaining can be
+ *       combined with the TABLE_INCREMENTAL_RESIZE, TABLE_ARENA and
+ *       TABLE_COMPRESSED options, and every backend with TABLE_BLOOM.
  * 
- * Returns:
- * 0 if the key was successfully removed.
- * 1 if the key was not found in the table.
- * -1 if the hash table or key is NULL.
+ * Returns a pointer to the initialized hash table, or NULL on failure.
  */
-int table_delete(struct table *t, const char *key) {
-    if (t == NULL || key == NULL) {
-        return -1;
+struct table *table_init_mode(unsigned long capacity,
+                              double max_load_factor,
+                              unsigned long (*hash_func)(const unsigned char *),
+                              int mode) {
+    if (capacity == 0 || max_load_factor <= 0 || hash_func == NULL) {
+        return NULL;
+    }
+    int options = mode & ~BACKEND_MASK;
+    mode &= BACKEND_MASK;
+    if (mode != TABLE_CHAINING && mode != TABLE_ROBIN_HOOD && mode != TABLE_SWISS
+        && mode != TABLE_CUCKOO) {
+        return NULL;
+    }
+    if ((options & ~(TABLE_INCREMENTAL_RESIZE | TABLE_ARENA | TABLE_COMPRESSED | TABLE_BLOOM)) != 0
+        || ((options & ~TABLE_BLOOM) != 0 && mode != TABLE_CHAINING)) {
+        return NULL;
     }
 
-    unsigned long index = t->hash_func((const unsigned char *)key) % t->capacity;
-    struct node *current = t->array[index];
-    struct node *prev = NULL;
+    struct table *t = malloc(sizeof(struct table));
+    if (t == NULL) {
+        return NULL;
+    }
 
-    while (current != NULL) {
-        if (strcmp(current->key, key) == 0) {
-            if (prev == NULL) {
-                t->array[index] = current->next;
-            } else {
-                prev->next = current->next;
+    t->array = NULL;
+    t->robin = NULL;
+    t->swiss = NULL;
+    t->cuckoo = NULL;
+    t->index = NULL;
+    t->frozen = NULL;
+    t->migration = NULL;
+    t->arena = NULL;
+    t->counters = NULL;
+    t->bloom = NULL;
+    t->bloom_keys = 0;
+    t->bloom_stale = 0;
+    if (mode == TABLE_ROBIN_HOOD) {
+        t->robin = robin_init(capacity, max_load_factor);
+        if (t->robin == NULL) {
+            free(t);
+            return NULL;
+        }
+    } else if (mode == TABLE_SWISS) {
+        t->swiss = swiss_init(capacity, max_load_factor);
+        if (t->swiss == NULL) {
+            free(t);
+            return NULL;
+        }
+    } else if (mode == TABLE_CUCKOO) {
+        t->cuckoo = cuckoo_init(capacity, max_load_factor);
+        if (t->cuckoo == NULL) {
+            free(t);
+            return NULL;
+        }
+    } else {
+        t->array = calloc(capacity, sizeof(struct node *));
+        if (t->array == NULL) {
+            free(t);
+            return NULL;
+        }
+        if (options & TABLE_INCREMENTAL_RESIZE) {
+            t->migration = malloc(sizeof(struct migration));
+            if (t->migration == NULL) {
+                free(t->array);
+                free(t);
+                return NULL;
             }
-
-            array_cleanup(current->value);
-            free(current->key);
-            free(current);
-            t->load--;
-            return 0;
+            t->migration->old_array = NULL;
         }
-
-        prev = current;
-        current = current->next;
+        if (options & TABLE_ARENA) {
+            t->arena = arena_init(ARENA_CHUNK_SIZE);
+            if (t->arena == NULL) {
+                free(t->migration);
+                free(t->array);
+                free(t);
+                return NULL;
+            }
+        }
+    }
+    t->hash_func = hash_func;
+    t->max_load_factor = max_load_factor;
+    t->min_load_factor = max_load_factor / MIN_LOAD_DIVISOR;
+    t->capacity = capacity;
+    t->min_capacity = capacity;
+    t->load = 0;
+    t->mode = mode;
+    t->options = options;
+    t->counters = calloc(1, sizeof(struct table_counters));
+    if (options & TABLE_BLOOM) {
+        double keys = (double)capacity * max_load_factor;
+        t->bloom = bloom_init(keys > 1 ? (unsigned long)keys : 1);
+    }
+    if (t->counters == NULL || ((options & TABLE_BLOOM) && t->bloom == NULL)) {
+        table_cleanup(t);
+        return NULL;
     }
 
-    return 1;
+    return t;
 }
 
 /* 
- * Clean up the hash table and free all allocated memory.
+ * Load a table from an index file written by table_save.
  * 
- * t: The hash table to clean up.
+ * filename: The index file.
+ * hash_func: The hash function of the saved table.
+ * 
+ * Returns a pointer to the read-only table, or NULL on failure.
  */
-void table_cleanup(struct table *t) {
+struct table *table_load(const char *filename,
+                         unsigned long (*hash_func)(const unsigned char *)) {
+    if (filename == NULL || hash_func == NULL) {
+        return NULL;
+    }
+
+    struct table *t = malloc(sizeof(struct table));
     if (t == NULL) {
-        return;
+        return NULL;
+    }
+    t->index = index_open(filename, hash_func);
+    if (t->index == NULL) {
+        free(t);
+        return NULL;
     }
 
-    for (unsigned long i = 0; i < t->capacity; i++) {
-        struct node *current = t->array[i];
-        while (current != NULL) {
-            struct node *temp = current;
-            current = current->next;
-            array_cleanup(temp->value);
-            free(temp->key);
-            free(temp);
-        }
+    t->array = NULL;
+    t->robin = NULL;
+    t->swiss = NULL;
+    t->cuckoo = NULL;
+    t->frozen = NULL;
+    t->migration = NULL;
+    t->arena = NULL;
+    t->bloom = NULL;
+    t->bloom_keys = 0;
+    t->bloom_stale = 0;
+    t->hash_func = hash_func;
+    t->max_load_factor = 1.0;
+    t->min_load_factor = 0;
+    t->capacity = 1;
+    t->min_capacity = 1;
+    t->load = 0;
+    t->mode = TABLE_MAPPED;
+    t->options = 0;
+    t->counters = calloc(1, sizeof(struct table_counters));
+    if (t->counters == NULL) {
+        table_cleanup(t);
+        return NULL;
     }
 
-    free(t->array);
+    return t;
+}
+
+/* 
+ * Save the keys and values of a table to an index file.
+ * 
+ * t: The hash table.
+ * filename: The file to write.
+ * 
+ * Returns 0 on success, 1 on failure.
+ */
+int table_save(const struct table *t, const char *filename) {
+    if (t == NULL || filename == NULL) {
+        return 1;
+    }
+    return index_write(filename, t, t->hash_func);
+}
+
+/* Return 1 if the table can not be changed. */
+static int read_only(const struct table *t) {
+    return t->mode == TABLE_MAPPED || t->mode == TABLE_FROZEN;
+}
+
+/* Hash a key for the backend of a table. Frozen tables and index files use
+ * their own hash function, cuckoo tables mix a second hash into that of the
+ * table. */
+static unsigned long key_hash(const struct table *t, const char *key) {
+    if (t->mode == TABLE_FROZEN) {
+        return frozen_hash(t->frozen, key);
+    }
+    if (t->mode == TABLE_MAPPED) {
+        return index_hash(t->index, key);
+    }
+    if (t->mode == TABLE_CUCKOO) {
+        return cuckoo_hash(key, t->hash_func((const unsigned char *)key));
+    }
+    return t->hash_func((const unsigned char *)key);
+}
+
+/* Add a key to the count of the filter, called for every key by rebuild_bloom. */
+static int add_to_bloom(void *ctx, const char *key, struct array *values) {
+    (void)values;
+    struct table *t = ctx;
+    bloom_add(t->bloom, bloom_hash(key));
+    t->bloom_keys++;
+    return 0;
+}
+
+/* 
+ * Replace the Bloom filter by one of all current keys, with room for as many
+ * again. If that fails the old filter is kept, it still has every key.
+ * 
+ * t: The hash table.
+ */
+static void rebuild_bloom(struct table *t) {
+    unsigned long keys = t->bloom_keys - t->bloom_stale;
+    struct bloom *b = bloom_init(keys > 0 ? 2 * keys : 1);
+    if (b == NULL) {
+        return;
+    }
+    bloom_cleanup(t->bloom);
+    t->bloom = b;
+    t->bloom_keys = 0;
+    t->bloom_stale = 0;
+    table_foreach(t, add_to_bloom, t);
+}
+
+/* 
+ * Add a new key to the Bloom filter of the table, if it has one. Once it
+ * holds more keys than it was sized for the filter is rebuilt at twice the
+ * size, like the table itself.
+ */
+static void bloom_insert(struct table *t, const char *key) {
+    if (t->bloom == NULL) {
+        return;
+    }
+    bloom_add(t->bloom, bloom_hash(key));
+    t->bloom_keys++;
+    if (t->bloom_keys > bloom_capacity(t->bloom)) {
+        rebuild_bloom(t);
+    }
+}
+
+/* 
+ * Note the delete of a key in the Bloom filter of the table, if it has one.
+ * Its bits can not be cleared, so the filter is rebuilt once a quarter of
+ * its keys are gone.
+ */
+static void bloom_delete(struct table *t) {
+    if (t->bloom == NULL) {
+        return;
+    }
+    t->bloom_stale++;
+    if (t->bloom_stale * 4 > t->bloom_keys) {
+        rebuild_bloom(t);
+    }
+}
+
+/* 
+ * Check the Bloom filter of the table, if it has one, and count the lookup
+ * as a miss if the filter rules the key out.
+ * 
+ * Returns 1 if the key is certainly absent, 0 if it may be present.
+ */
+static int bloom_rejects(const struct table *t, uint64_t hash) {
+    if (bloom_maybe_contains(t->bloom, hash)) {
+        return 0;
+    }
+    if (t->counters->count_lookups) {
+        t->counters->bloom_rejects++;
+    }
+    count_lookup(t, 0, 0);
+    return 1;
+}
+
+/* Forward a lookup to the open addressing backend of the table. */
+static struct array *backend_find(const struct table *t, const char *key,
+                                  unsigned long hash) {
+    if (t->mode == TABLE_SWISS) {
+        return swiss_find(t->swiss, key, hash);
+    }
+    if (t->mode == TABLE_CUCKOO) {
+        return cuckoo_find(t->cuckoo, key, hash);
+    }
+    if (t->mode == TABLE_MAPPED) {
+        return index_find(t->index, key, hash);
+    }
+    if (t->mode == TABLE_FROZEN) {
+        return frozen_find(t->frozen, key, hash);
+    }
+    return robin_find(t->robin, key, hash);
+}
+
+/* Forward the insert of a new key to the open addressing backend. */
+static int backend_insert(struct table *t, const char *key, unsigned long hash,
+                          struct array *value) {
+    if (t->mode == TABLE_SWISS) {
+        return swiss_insert(t->swiss, key, hash, value);
+    }
+    if (t->mode == TABLE_CUCKOO) {
+        return cuckoo_insert(t->cuckoo, key, hash, value);
+    }
+    return robin_insert(t->robin, key, hash, value);
+}
+
+/* 
+ * Append a value to the values of an existing key. With unique_tail set the
+ * value is skipped when it already is the last one.
+ * 
+ * Returns 0 on success, 1 on failure.
+ */
+static int append_value(struct array *values, int value, int unique_tail) {
+    if (unique_tail && array_size(values) > 0 && array_last(values) == value) {
+        return 0;
+    }
+    return array_append(values, value) != 0;
+}
+
+/* 
+ * Find the values of a key in the open addressing backend, inserting the key
+ * with an empty array first when it is not present yet.
+ * 
+ * Returns the values, or NULL on failure.
+ */
+static struct array *backend_find_or_create(struct table *t, const char *key, int *created) {
+    unsigned long hash = key_hash(t, key);
+    struct array *values = backend_find(t, key, hash);
+    if (values != NULL) {
+        return values;
+    }
+
+    values = array_init(4);
+    if (values == NULL) {
+        return NULL;
+    }
+    if (backend_insert(t, key, hash, values) != 0) {
+        array_cleanup(values);
+        return NULL;
+    }
+    bloom_insert(t, key);
+    *created = 1;
+    return values;
+}
+
+/* 
+ * Find the values of a key, inserting a copy of the key with an empty array
+ * first when it is not present yet. Both cases take a single search of the
+ * table, and neither counts as a lookup.
+ * 
+ * t: The hash table.
+ * key: The key to find or insert.
+ * created: Set to 1 if the key was inserted and to 0 if it was present.
+ * 
+ * Returns the values of the key, or NULL on failure. If created is set, the
+ * key stays in the table even when the resize after it failed.
+ */
+static struct array *find_or_create(struct table *t, const char *key, int *created) {
+    *created = 0;
+    if (t == NULL || key == NULL || read_only(t)) {
+        return NULL;
+    }
+    if (t->mode != TABLE_CHAINING) {
+        return backend_find_or_create(t, key, created);
+    }
+
+    unsigned long hash = t->hash_func((const unsigned char *)key);
+    size_t key_len = strlen(key);
+
+    migrate_step(t);
+    struct node **link = find_link(t, key, hash, key_len, NULL);
+    if (link != NULL) {
+        return node_values(*link);
+    }
+
+    unsigned long index = hash % t->capacity;
+    struct node *new_node = node_create(t, key, hash, key_len);
+    if (new_node == NULL) {
+        return NULL;
+    }
+    new_node->next = t->array[index];
+    t->array[index] = new_node;
+    t->load++;
+    bloom_insert(t, key);
+    *created = 1;
+
+    if ((double)t->load / t->capacity > t->max_load_factor) {
+        int failed = t->migration != NULL ? start_migration(t, t->capacity * 2)
+                                          : table_resize(t);
+        if (failed) {
+            return NULL;
+        }
+    }
+    return node_values(new_node);
+}
+
+/* 
+ * Copy and insert a key with its value, or append the value if the key is
+ * already present. A key that was inserted for a value that could not be
+ * stored is removed again.
+ * 
+ * t: The hash table.
+ * key: The key to insert.
+ * value: The value to associate with the key.
+ * unique_tail: If set, do not append a value that already is the last one.
+ * 
+ * Returns 0 on success, 1 on failure.
+ */
+static int insert_value(struct table *t, const char *key, int value, int unique_tail) {
+    int created;
+    struct array *values = find_or_create(t, key, &created);
+    if (values != NULL && append_value(values, value, unique_tail) == 0) {
+        return 0;
+    }
+    if (created) {
+        table_delete(t, key);
+    }
+    return 1;
+}
+
+/* 
+ * Copies and inserts a key into the hash table, along with its value.
+ * If the key already exists, the value is appended to the existing array.
+ * 
+ * t: The hash table.
+ * key: The key to insert.
+ * value: The value to associate with the key.
+ * 
+ * Returns 0 on success, 1 on failure.
+ */
+int table_insert(struct table *t, const char *key, int value) {
+    return insert_value(t, key, value, 0);
+}
+
+/* 
+ * Like table_insert, but a value that is equal to the last value of the key
+ * is not appended again.
+ * 
+ * t: The hash table.
+ * key: The key to insert.
+ * value: The value to associate with the key.
+ * 
+ * Returns 0 on success, also if the value was skipped, and 1 on failure.
+ */
+int table_insert_unique_tail(struct table *t, const char *key, int value) {
+    return insert_value(t, key, value, 1);
+}
+
+/* 
+ * Look up a key in the hash table and return its associated array of values.
+ * The table is not changed, so lookups can run concurrently, unless
+ * table_count_lookups turned on counting: then every lookup updates the
+ * counters behind t.
+ * 
+ * t: The hash table.
+ * key: The key to look up.
+ * 
+ * Returns a pointer to the array of values, or NULL if the key is not found or t is NULL.
+ */
+struct array *table_lookup(const struct table *t, const char *key) {
+    if (t == NULL || key == NULL) {
+        return NULL;
+    }
+    if (t->bloom != NULL && bloom_rejects(t, bloom_hash(key))) {
+        return NULL;
+    }
+    if (t->mode != TABLE_CHAINING) {
+        struct array *values = backend_find(t, key, key_hash(t, key));
+        count_lookup(t, values != NULL, t->mode == TABLE_FROZEN);
+        return values;
+    }
+
+    unsigned long probes;
+    struct node **link = find_link(t, key, t->hash_func((const unsigned char *)key), strlen(key),
+                                   &probes);
+    count_lookup(t, link != NULL, probes);
+    if (link == NULL) {
+        return NULL;
+    }
+    return node_values(*link);
+}
+
+/* Prefetch the bucket, or the first slots probed, for the hash of a key. */
+static void prefetch_bucket(const struct table *t, unsigned long hash) {
+    if (t->mode == TABLE_ROBIN_HOOD) {
+        robin_prefetch(t->robin, hash);
+    } else if (t->mode == TABLE_SWISS) {
+        swiss_prefetch(t->swiss, hash);
+    } else if (t->mode == TABLE_CUCKOO) {
+        cuckoo_prefetch(t->cuckoo, hash);
+    } else if (t->mode == TABLE_MAPPED) {
+        index_prefetch(t->index, hash);
+    } else if (t->mode == TABLE_FROZEN) {
+        frozen_prefetch(t->frozen, hash);
+    } else {
+        __builtin_prefetch(&t->array[hash % t->capacity]);
+    }
+}
+
+/* 
+ * Look up a batch of keys. The keys are handled BATCH_WINDOW at a time in
+ * stages: first all keys of the window are hashed and their buckets
+ * prefetched, then the first nodes of the chains are prefetched, which by
+ * then are usually known, and only then the keys are resolved one by one.
+ * With a Bloom filter the blocks of all keys are fetched and checked first,
+ * and only the keys that pass go through the other stages.
+ * 
+ * t: The hash table.
+ * keys: The keys to look up, NULL entries are allowed.
+ * n: Number of keys.
+ * out: Receives the array of values of every key, or NULL.
+ * 
+ * Returns 0 on success, 1 on invalid input.
+ */
+int table_lookup_batch(const struct table *t, const char *const keys[], size_t n,
+                       struct array *out[]) {
+    if (t == NULL || (n > 0 && (keys == NULL || out == NULL))) {
+        return 1;
+    }
+
+    unsigned long hashes[BATCH_WINDOW];
+    size_t lengths[BATCH_WINDOW];
+    uint64_t bloom_hashes[BATCH_WINDOW];
+    const char *batch[BATCH_WINDOW];
+
+    for (size_t start = 0; start < n; start += BATCH_WINDOW) {
+        size_t count = n - start < BATCH_WINDOW ? n - start : BATCH_WINDOW;
+        memcpy(batch, keys + start, count * sizeof(const char *));
+
+        if (t->bloom != NULL) {
+            for (size_t i = 0; i < count; i++) {
+                if (batch[i] != NULL) {
+                    bloom_hashes[i] = bloom_hash(batch[i]);
+                    bloom_prefetch(t->bloom, bloom_hashes[i]);
+                }
+            }
+            for (size_t i = 0; i < count; i++) {
+                if (batch[i] != NULL && bloom_rejects(t, bloom_hashes[i])) {
+                    batch[i] = NULL;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (batch[i] != NULL) {
+                hashes[i] = key_hash(t, batch[i]);
+                lengths[i] = strlen(batch[i]);
+                prefetch_bucket(t, hashes[i]);
+            }
+        }
+
+        if (t->mode == TABLE_CHAINING) {
+            for (size_t i = 0; i < count; i++) {
+                if (batch[i] != NULL) {
+                    __builtin_prefetch(t->array[hashes[i] % t->capacity]);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            out[start + i] = NULL;
+            if (batch[i] == NULL) {
+                continue;
+            }
+            if (t->mode != TABLE_CHAINING) {
+                out[start + i] = backend_find(t, batch[i], hashes[i]);
+                count_lookup(t, out[start + i] != NULL, t->mode == TABLE_FROZEN);
+                continue;
+            }
+
+            unsigned long probes;
+            struct node **link = find_link(t, batch[i], hashes[i], lengths[i], &probes);
+            count_lookup(t, link != NULL, probes);
+            if (link != NULL) {
+                out[start + i] = node_values(*link);
+            }
+        }
+    }
+    return 0;
+}
+
+/* 
+ * Look up several keys and intersect their values. The keys are looked up
+ * with a single batch, and if all of them are present their arrays are
+ * intersected starting from the shortest.
+ * 
+ * t: The hash table.
+ * keys: The keys, NULL entries count as absent keys.
+ * n: Number of keys.
+ * 
+ * Returns a new array with the values all keys have in common, empty if a key
+ * is absent, or NULL on failure or invalid input.
+ */
+struct array *table_lookup_and(const struct table *t, const char *const keys[], size_t n) {
+    if (t == NULL || keys == NULL || n == 0) {
+        return NULL;
+    }
+
+    struct array **values = malloc(n * sizeof(struct array *));
+    if (values == NULL) {
+        return NULL;
+    }
+    struct array *result = NULL;
+    if (table_lookup_batch(t, keys, n, values) == 0) {
+        int absent = 0;
+        for (size_t i = 0; i < n; i++) {
+            absent |= values[i] == NULL;
+        }
+        result = absent ? array_init(0)
+                        : array_intersect((const struct array *const *)values, n);
+    }
+    free(values);
+    return result;
+}
+
+/* 
+ * Calculate the load factor of the hash table.
+ * The load factor is defined as: number of elements stored / table capacity.
+ * 
+ * t: The hash table.
+ * 
+ * Returns:
+ * The load factor as a double. Returns -1.0 if the hash table is NULL or its 
+ * capacity is zero.
+ */
+double table_load_factor(const struct table *t) {
+    if (t == NULL || t->capacity == 0) {
+        return -1.0;
+    }
+    if (t->mode == TABLE_ROBIN_HOOD) {
+        return robin_load_factor(t->robin);
+    }
+    if (t->mode == TABLE_SWISS) {
+        return swiss_load_factor(t->swiss);
+    }
+    if (t->mode == TABLE_CUCKOO) {
+        return cuckoo_load_factor(t->cuckoo);
+    }
+    if (t->mode == TABLE_MAPPED) {
+        return index_load_factor(t->index);
+    }
+    if (t->mode == TABLE_FROZEN) {
+        return frozen_load_factor(t->frozen);
+    }
+    return (double)t->load / t->capacity;
+}
+
+/* 
+ * Measure how evenly the keys of a chained table are spread over its buckets.
+ * During an incremental resize only the new bucket array is measured.
+ * 
+ * t: The hash table.
+ * max_chain: Set to the length of the longest chain.
+ * stddev: Set to the standard deviation of the chain lengths of all buckets.
+ * 
+ * Returns 0 on success, 1 if t is not a chained table or on invalid input.
+ */
+int table_chain_spread(const struct table *t, unsigned long *max_chain, double *stddev) {
+    if (t == NULL || max_chain == NULL || stddev == NULL || t->mode != TABLE_CHAINING) {
+        return 1;
+    }
+
+    unsigned long total = 0;
+    double sum_squares = 0;
+    *max_chain = 0;
+    for (unsigned long i = 0; i < t->capacity; i++) {
+        unsigned long length = 0;
+        for (const struct node *n = t->array[i]; n != NULL; n = n->next) {
+            length++;
+        }
+        if (length > *max_chain) {
+            *max_chain = length;
+        }
+        total += length;
+        sum_squares += (double)length * (double)length;
+    }
+
+    double mean = (double)total / (double)t->capacity;
+    *stddev = sqrt(sum_squares / (double)t->capacity - mean * mean);
+    return 0;
+}
+
+/* 
+ * Add the buckets of a bucket array to the occupancy and chain length
+ * statistics.
+ */
+static void count_chains(struct node **array, unsigned long capacity,
+                         struct table_stats *stats) {
+    for (unsigned long i = 0; i < capacity; i++) {
+        unsigned long length = 0;
+        for (const struct node *n = array[i]; n != NULL; n = n->next) {
+            length++;
+        }
+        stats->chains[length < TABLE_STATS_CHAINS ? length : TABLE_STATS_CHAINS - 1]++;
+        stats->used_buckets += length > 0;
+        if (length > stats->max_chain) {
+            stats->max_chain = length;
+        }
+    }
+    stats->buckets += capacity;
+}
+
+/* Table and statistics that count_key adds to. */
+struct stats_target {
+    const struct table *t;
+    struct table_stats *stats;
+};
+
+/* 
+ * Add the memory of one key and its values to the statistics. The key and
+ * value array of a chained table share the block of its node, the other
+ * backends allocate an array struct per key.
+ * 
+ * Returns 0.
+ */
+static int count_key(void *ctx, const char *key, struct array *values) {
+    const struct stats_target *s = ctx;
+    size_t key_size = strlen(key) + 1;
+
+    s->stats->keys++;
+    s->stats->key_bytes += key_size;
+    s->stats->value_bytes += array_memory(values);
+    if (s->t->mode == TABLE_CHAINING) {
+        s->stats->node_bytes += value_offset(key_size - 1) + array_footprint() - key_size;
+    } else {
+        s->stats->node_bytes += array_footprint();
+    }
+    return 0;
+}
+
+/* 
+ * Turn counting lookups for table_stats on or off.
+ * 
+ * t: The hash table.
+ * enable: 1 to count lookups, 0 to stop counting them.
+ * 
+ * Returns 0 on success, 1 if t is NULL.
+ */
+int table_count_lookups(struct table *t, int enable) {
+    if (t == NULL) {
+        return 1;
+    }
+    t->counters->count_lookups = enable != 0;
+    return 0;
+}
+
+/* 
+ * Collect statistics about a table: its lookup and resize counters, the
+ * occupancy and chain lengths of its buckets and its memory use.
+ * 
+ * t: The hash table.
+ * stats: Filled in with the statistics.
+ * 
+ * Returns 0 on success, 1 on invalid input.
+ */
+int table_stats(const struct table *t, struct table_stats *stats) {
+    if (t == NULL || stats == NULL) {
+        return 1;
+    }
+    memset(stats, 0, sizeof(struct table_stats));
+
+    const struct table_counters *c = t->counters;
+    stats->hits = c->hits;
+    stats->misses = c->misses;
+    stats->avg_hit_probes = c->hits > 0 ? (double)c->hit_probes / (double)c->hits : 0;
+    stats->avg_miss_probes = c->misses > 0 ? (double)c->miss_probes / (double)c->misses : 0;
+    stats->max_hit_probes = c->max_hit_probes;
+    stats->max_miss_probes = c->max_miss_probes;
+    stats->resizes = c->resizes;
+    stats->resize_seconds = c->resize_seconds;
+    stats->max_moved_buckets = c->max_moved;
+    stats->bloom_rejects = c->bloom_rejects;
+    stats->load_factor = table_load_factor(t);
+
+    stats->table_bytes = sizeof(struct table) + sizeof(struct table_counters);
+    if (t->bloom != NULL) {
+        stats->table_bytes += bloom_memory(t->bloom);
+    }
+    if (t->mode == TABLE_CHAINING) {
+        count_chains(t->array, t->capacity, stats);
+        if (t->migration != NULL) {
+            stats->table_bytes += sizeof(struct migration);
+            if (t->migration->old_array != NULL) {
+                count_chains(t->migration->old_array, t->migration->old_capacity, stats);
+            }
+        }
+        stats->table_bytes += stats->buckets * sizeof(struct node *);
+    } else if (t->mode == TABLE_ROBIN_HOOD) {
+        stats->table_bytes += robin_memory(t->robin);
+    } else if (t->mode == TABLE_SWISS) {
+        stats->table_bytes += swiss_memory(t->swiss);
+    } else if (t->mode == TABLE_CUCKOO) {
+        stats->table_bytes += cuckoo_memory(t->cuckoo);
+    } else if (t->mode == TABLE_MAPPED) {
+        stats->table_bytes += index_memory(t->index);
+    } else {
+        stats->table_bytes += frozen_memory(t->frozen);
+    }
+
+    struct stats_target target = { t, stats };
+    table_foreach(t, count_key, &target);
+    return 0;
+}
+
+/* 
+ * Call a function for every node of a bucket array.
+ * 
+ * Returns 0, or the first non-zero return value of func.
+ */
+static int foreach_node(struct node **array, unsigned long capacity,
+                        table_visit_func func, void *ctx) {
+    for (unsigned long i = 0; i < capacity; i++) {
+        for (struct node *n = array[i]; n != NULL; n = n->next) {
+            int res = func(ctx, n->key, node_values(n));
+            if (res != 0) {
+                return res;
+            }
+        }
+    }
+    return 0;
+}
+
+/* 
+ * Call a function for every key in the table and its values. During an
+ * incremental resize the buckets of both arrays are visited, without moving
+ * any of them.
+ * 
+ * t: The hash table.
+ * func: Called for every key, a non-zero return value stops the iteration.
+ * ctx: Passed to func.
+ * 
+ * Returns 0 if every key was visited, the return value of func if it was not
+ * 0, or -1 if t or func is NULL.
+ */
+int table_foreach(const struct table *t, table_visit_func func, void *ctx) {
+    if (t == NULL || func == NULL) {
+        return -1;
+    }
+    if (t->mode == TABLE_ROBIN_HOOD) {
+        return robin_foreach(t->robin, func, ctx);
+    }
+    if (t->mode == TABLE_SWISS) {
+        return swiss_foreach(t->swiss, func, ctx);
+    }
+    if (t->mode == TABLE_CUCKOO) {
+        return cuckoo_foreach(t->cuckoo, func, ctx);
+    }
+    if (t->mode == TABLE_MAPPED) {
+        return index_foreach(t->index, func, ctx);
+    }
+    if (t->mode == TABLE_FROZEN) {
+        return frozen_foreach(t->frozen, func, ctx);
+    }
+
+    if (t->migration != NULL && t->migration->old_array != NULL) {
+        int res = foreach_node(t->migration->old_array, t->migration->old_capacity,
+                               func, ctx);
+        if (res != 0) {
+            return res;
+        }
+    }
+    return foreach_node(t->array, t->capacity, func, ctx);
+}
+
+/* 
+ * Get the number of keys of a table that stores the strcmp order of its
+ * keys, which tables loaded from an index file do.
+ * 
+ * t: The hash table.
+ * n_keys: Set to the number of keys in the order.
+ * 
+ * Returns 1 if the table stores the order, 0 otherwise.
+ */
+int table_key_order(const struct table *t, unsigned long *n_keys) {
+    if (t == NULL || t->mode != TABLE_MAPPED) {
+        return 0;
+    }
+    *n_keys = index_size(t->index);
+    return 1;
+}
+
+/* 
+ * Get a key of a table by its position in the stored strcmp order.
+ * 
+ * t: A table for which table_key_order returns 1.
+ * rank: Position of the key, below the number of keys.
+ * key, values: Set to the key and its values.
+ * 
+ * Returns 0 on success, 1 if rank is out of range or the key is damaged.
+ */
+int table_sorted_key(const struct table *t, unsigned long rank, const char **key,
+                     struct array **values) {
+    if (t == NULL || t->mode != TABLE_MAPPED) {
+        return 1;
+    }
+    *key = index_key_at(t->index, rank, values);
+    return *key == NULL;
+}
+
+/* Destination and offset of a table_merge. */
+struct merge_target {
+    struct table *dst;
+    int offset;
+};
+
+/* 
+ * Append the values of one key to the merge destination. The first value
+ * are appended to the array find_or_create returns, which copies the key if
+ * it is new.
+ * 
+ * Returns 0 on success, 1 on failure.
+ */
+static int merge_key(void *ctx, const char *key, struct array *values) {
+    const struct merge_target *m = ctx;
+    struct array_cursor c;
+    int value;
+
+    array_cursor_init(&c, values);
+    if (!array_cursor_next(&c, &value)) {
+        return 0;
+    }
+    int created;
+    struct array *dst_values = find_or_create(m->dst, key, &created);
+    if (dst_values == NULL) {
+        return 1;
+    }
+    do {
+        if (array_append(dst_values, value + m->offset) != 0) {
+            if (created && array_size(dst_values) == 0) {
+                table_delete(m->dst, key);
+            }
+            return 1;
+        }
+    } while (array_cursor_next(&c, &value));
+    return 0;
+}
+
+/* 
+ * Append the values of every key of src to the same key in dst.
+ * 
+ * dst: The table to merge into.
+ * src: The table to merge from, it is not changed.
+ * offset: Added to every value of src.
+ * 
+ * Returns 0 on success, 1 on failure.
+ */
+int table_merge(struct table *dst, const struct table *src, int offset) {
+    if (dst == NULL || src == NULL) {
+        return 1;
+    }
+    struct merge_target m = { dst, offset };
+    return table_foreach(src, merge_key, &m) != 0;
+}
+
+/* 
+ * Remove the specified key and its associated values from the hash table.
+ * 
+ * t: The hash table.
+ * key: The key to remove.
+ * 
+ * Returns:
+ * 0 if the key was successfully removed.
+ * 1 if the key was not found in the table.
+ * -1 if the hash table or key is NULL, or the table is read-only.
+ */
+int table_delete(struct table *t, const char *key) {
+    if (t == NULL || key == NULL || read_only(t)) {
+        return -1;
+    }
+    if (t->mode != TABLE_CHAINING) {
+        unsigned long hash = key_hash(t, key);
+        int res = t->mode == TABLE_ROBIN_HOOD ? robin_remove(t->robin, key, hash)
+                  : t->mode == TABLE_SWISS    ? swiss_remove(t->swiss, key, hash)
+                                              : cuckoo_remove(t->cuckoo, key, hash);
+        if (res == 0) {
+            bloom_delete(t);
+        }
+        return res;
+    }
+
+    migrate_step(t);
+    struct node **link = find_link(t, key, t->hash_func((const unsigned char *)key), strlen(key),
+                                   NULL);
+    if (link == NULL) {
+        return 1;
+    }
+
+    struct node *current = *link;
+    *link = current->next;
+
+    node_free(t, current);
+    t->load--;
+    bloom_delete(t);
+
+    /* Halve the array, which leaves the load factor below half the maximum.
+     * With incremental resizing the nodes move over the next deletes, like
+     * they do when the table grows. A failure to shrink does not make the
+     * delete fail. */
+    if ((double)t->load < t->min_load_factor * (double)t->capacity
+        && t->capacity / 2 >= t->min_capacity) {
+        if (t->migration != NULL) {
+            start_migration(t, t->capacity / 2);
+        } else {
+            rehash(t, t->capacity / 2);
+        }
+    }
+    return 0;
+}
+
+/* 
+ * Set the load factor below which deletes shrink a chained table. A shrink
+ * halves the bucket array, but never below the capacity the table was
+ * created with.
+ * 
+ * t: The hash table.
+ * min_load_factor: The minimum load factor, 0 turns shrinking off.
+ * 
+ * Returns 0 on success, 1 on invalid input or for other backends.
+ */
+int table_set_min_load_factor(struct table *t, double min_load_factor) {
+    if (t == NULL || t->mode != TABLE_CHAINING || min_load_factor < 0
+        || min_load_factor >= t->max_load_factor / 2) {
+        return 1;
+    }
+    t->min_load_factor = min_load_factor;
+    return 0;
+}
+
+/* 
+ * Copy every node of a chained table into a new arena and bucket array, so
+ * the memory of deleted nodes and of value arrays that grew is released.
+ * The old nodes are only freed once all copies are made.
+ * 
+ * t: The hash table, with TABLE_ARENA and no incremental resize going on.
+ * new_capacity: Number of buckets of the new array.
+ * 
+ * Returns 0 on success, 1 on failure, in which case t is unchanged.
+ */
+static int copy_to_arena(struct table *t, unsigned long new_capacity) {
+    double start = now();
+    struct arena *old_arena = t->arena;
+    struct node **new_array = calloc(new_capacity, sizeof(struct node *));
+    t->arena = arena_init(ARENA_CHUNK_SIZE);
+    int failed = new_array == NULL || t->arena == NULL;
+
+    for (unsigned long i = 0; i < t->capacity && !failed; i++) {
+        for (const struct node *n = t->array[i]; n != NULL && !failed; n = n->next) {
+            struct node *copy = node_create(t, n->key, n->hash, n->key_len);
+            if (copy == NULL) {
+                failed = 1;
+                break;
+            }
+            struct array_cursor c;
+            int value;
+            array_cursor_init(&c, node_values(n));
+            while (!failed && array_cursor_next(&c, &value)) {
+                failed = array_append(node_values(copy), value) != 0;
+            }
+            copy->next = new_array[copy->hash % new_capacity];
+            new_array[copy->hash % new_capacity] = copy;
+        }
+    }
+
+    if (failed) {
+        arena_cleanup(t->arena);
+        free(new_array);
+        t->arena = old_arena;
+        return 1;
+    }
+    arena_cleanup(old_arena);
+    free(t->array);
+    t->array = new_array;
+    t->capacity = new_capacity;
+    count_resize(t, start);
+    return 0;
+}
+
+/* 
+ * Rebuild the storage of a table at the size its keys need.
+ * 
+ * Returns 0 on success, 1 on failure, in which case t is unchanged.
+ */
+static int compact_storage(struct table *t) {
+    if (t->mode == TABLE_ROBIN_HOOD) {
+        return robin_compact(t->robin);
+    }
+    if (t->mode == TABLE_SWISS) {
+        return swiss_compact(t->swiss);
+    }
+    if (t->mode == TABLE_CUCKOO) {
+        return cuckoo_compact(t->cuckoo);
+    }
+
+    finish_migration(t);
+    unsigned long capacity = (unsigned long)ceil((double)t->load / t->max_load_factor);
+    capacity = capacity > 0 ? capacity : 1;
+    if (t->arena != NULL) {
+        return copy_to_arena(t, capacity);
+    }
+    if (capacity == t->capacity) {
+        return 0;
+    }
+    return rehash(t, capacity);
+}
+
+/* 
+ * Rebuild a table at the size its keys need. A chained table gets the
+ * smallest bucket array that keeps it within the maximum load factor, and
+ * with TABLE_ARENA its nodes are copied into a new arena. The open
+ * addressing backends are rebuilt with the fewest slots that fit. A Bloom
+ * filter is rebuilt without the deleted keys.
+ * 
+ * t: The hash table.
+ * 
+ * Returns 0 on success, 1 on failure or for read-only tables. On failure the
+ * table is unchanged.
+ */
+int table_compact(struct table *t) {
+    if (t == NULL || read_only(t) || compact_storage(t) != 0) {
+        return 1;
+    }
+    if (t->bloom != NULL) {
+        rebuild_bloom(t);
+    }
+    return 0;
+}
+
+/* 
+ * Free the storage of the table with all keys and values, but not the table
+ * struct itself.
+ * 
+ * t: The hash table.
+ */
+static void free_storage(struct table *t) {
+    if (t->mode != TABLE_CHAINING) {
+        robin_cleanup(t->robin);
+        swiss_cleanup(t->swiss);
+        cuckoo_cleanup(t->cuckoo);
+        index_close(t->index);
+        frozen_cleanup(t->frozen);
+        t->robin = NULL;
+        t->swiss = NULL;
+        t->cuckoo = NULL;
+        t->index = NULL;
+        t->frozen = NULL;
+        return;
+    }
+
+    /* With an arena all nodes go at once, without walking the chains. */
+    if (t->migration != NULL) {
+        if (t->migration->old_array != NULL && t->arena == NULL) {
+            free_nodes(t, t->migration->old_array, t->migration->old_capacity);
+        }
+        free(t->migration->old_array);
+        free(t->migration);
+        t->migration = NULL;
+    }
+    if (t->arena == NULL) {
+        free_nodes(t, t->array, t->capacity);
+    }
+    arena_cleanup(t->arena);
+    free(t->array);
+    t->arena = NULL;
+    t->array = NULL;
+}
+
+/* 
+ * Replace the storage of a table by a frozen table with the same keys and
+ * values. The old storage is only freed once the frozen table is complete,
+ * so on failure the table is unchanged.
+ * 
+ * t: The hash table.
+ * 
+ * Returns 0 on success, 1 on failure or if the table is read-only already.
+ */
+int table_freeze(struct table *t) {
+    if (t == NULL || read_only(t)) {
+        return 1;
+    }
+
+    struct frozen_table *frozen = frozen_build(t);
+    if (frozen == NULL) {
+        return 1;
+    }
+    free_storage(t);
+    t->frozen = frozen;
+    t->mode = TABLE_FROZEN;
+    t->options = 0;
+    t->capacity = 1;
+    return 0;
+}
+
+/* 
+ * Clean up the hash table and free all allocated memory.
+ * 
+ * t: The hash table to clean up.
+ */
+void table_cleanup(struct table *t) {
+    if (t == NULL) {
+        return;
+    }
+    free_storage(t);
+    bloom_cleanup(t->bloom);
+    free(t->counters);
     free(t);
 }
@@ -0,0 +1,226 @@
+#ifndef HASH_TABLE_EXT_H
+#define HASH_TABLE_EXT_H
+
+/* Extensions to the hash table interface. hash_table.h itself is kept as
+ * handed out, these functions work on the same struct table handle. */
+
+#include <stddef.h>
+
+#include "hash_table.h"
+
+/* Table backends, passed as the mode of table_init_mode. */
+
+/* Separate chaining, this is what table_init uses. */
+#define TABLE_CHAINING 0
+/* Open addressing with Robin Hood displacement and backward shift deletion. */
+#define TABLE_ROBIN_HOOD 1
+/* Open addressing with 7 bit hash tags, probed 16 slots at a time. */
+#define TABLE_SWISS 2
+/* Read-only table in a mapped index file, only created by table_load. */
+#define TABLE_MAPPED 3
+/* Read-only table with a minimal perfect hash function, only created by
+ * table_freeze. */
+#define TABLE_FROZEN 4
+/* Bucketized cuckoo hashing: every key is in one of two buckets of 4 slots,
+ * so any lookup, hit or miss, reads at most two cache lines of the table. */
+#define TABLE_CUCKOO 5
+
+/* Options that can be added to TABLE_CHAINING with |. */
+
+/* Instead of rehashing all nodes at once, a resize keeps the old and new
+ * bucket arrays around and every insert and delete moves a few buckets until
+ * the old array is empty. Lookups search both arrays and move nothing. */
+#define TABLE_INCREMENTAL_RESIZE 0x100
+/* Nodes, keys and value arrays are carved from large chunks owned by the
+ * table and all released at once on cleanup. The memory of deleted keys is
+ * only reclaimed then too. */
+#define TABLE_ARENA 0x200
+/* Values are stored as compressed arrays (see array_init_compressed), so for
+ * every key they must be strictly increasing and non-negative. table_insert
+ * fails for any other value. Meant for line numbers. */
+#define TABLE_COMPRESSED 0x400
+
+/* Options that can be added to any backend with |. */
+
+/* Keep a blocked Bloom filter of the keys next to the table (see bloom.h).
+ * Lookups check it first and return NULL without searching the table for
+ * almost all absent keys, at the cost of one more hash and cache line per
+ * lookup and about 2 bytes per key. The filter is rebuilt when the table has
+ * grown past the size it was made for, and after a quarter of its keys were
+ * deleted. */
+#define TABLE_BLOOM 0x800
+
+/* Initialise a hash table like table_init, but with the storage backend and
+ * options selected by mode. Returns NULL on failure or for an unknown mode. */
+struct table *table_init_mode(unsigned long capacity,
+                              double max_load_factor,
+                              unsigned long (*hash_func)(const unsigned char *),
+                              int mode);
+
+/* Save the keys and values of t to an index file, which table_load can map
+ * back without rebuilding the table. The file is written under a temporary
+ * name first, so a running process that has the old file loaded keeps a
+ * consistent copy. Returns 0 on success and 1 on failure. */
+int table_save(const struct table *t, const char *filename);
+
+/* Load a table saved by table_save, with the same hash function as the saved
+ * table. The file is mapped and lookups are answered from the mapping, so
+ * only the pages that lookups touch are read, and processes that load the
+ * same file share them. A key whose record in the file is damaged is not
+ * found. The table is read-only: table_insert fails and
+ * table_delete returns -1. Values are read-only arrays to which array_append
+ * fails. Returns NULL on failure, also if the file was saved with another
+ * hash function. */
+struct table *table_load(const char *filename,
+                         unsigned long (*hash_func)(const unsigned char *));
+
+/* Turn t into a read-only table in which every key has a slot of its own,
+ * found with a minimal perfect hash function, and all keys and values are
+ * packed into a few large blocks. A lookup then takes one hash, one slot and
+ * one key compare, and the table needs no spare capacity or per-key pointers.
+ * Afterwards table_insert fails, table_delete returns -1 and the values are
+ * read-only arrays. Returns 0 on success, or 1 on failure or if t is
+ * read-only already, in both cases t is unchanged. */
+int table_freeze(struct table *t);
+
+/* Insert like table_insert, but do not append value if it is already the last
+ * value stored for key. Inserting every word of a line with its line number
+ * this way stores each line only once, with a single search per word.
+ * Returns 0 if successful, also when the value was skipped, and 1 otherwise. */
+int table_insert_unique_tail(struct table *t, const char *key, int value);
+
+/* Called by table_foreach for every key with its values. The values may be
+ * modified, but the table itself must not change during the iteration. A
+ * non-zero return value stops the iteration. */
+typedef int (*table_visit_func)(void *ctx, const char *key, struct array *values);
+
+/* Call func for every key in the table, in no particular order. Returns 0 if
+ * all keys were visited, the non-zero return value of func if it stopped
+ * early, and -1 if t or func is NULL. */
+int table_foreach(const struct table *t, table_visit_func func, void *ctx);
+
+/* Tables loaded by table_load know the strcmp order of their keys, which
+ * table_save stores in the file. Returns 1 and sets n_keys to the number of
+ * keys for such a table, and returns 0 for all other tables. */
+int table_key_order(const struct table *t, unsigned long *n_keys);
+
+/* Set key and values to the key at position rank of the order of a table for
+ * which table_key_order returns 1, reading only that key. Returns 0 on
+ * success and 1 if rank is not below the number of keys or the key is
+ * damaged. */
+int table_sorted_key(const struct table *t, unsigned long rank, const char **key,
+                     struct array **values);
+
+/* Append all values of src to the values of the same keys in dst, with offset
+ * added to each of them. Keys that are not in dst yet are copied. Used to
+ * combine tables that were built from consecutive parts of a text, where the
+ * offset is the number of lines before the part src was built from.
+ * Returns 0 on success and 1 on failure, in which case dst may hold part of
+ * the values of src. */
+int table_merge(struct table *dst, const struct table *src, int offset);
+
+/* Look up n keys at once and store the values of keys[i] in out[i], NULL if
+ * the key is not present or keys[i] is NULL. The keys are hashed and their
+ * buckets prefetched a window at a time before any of them is resolved, so
+ * the cache misses of the keys overlap instead of following each other.
+ * Returns 0 on success and 1 if t is NULL, or keys or out is NULL while n is
+ * not 0. */
+int table_lookup_batch(const struct table *t, const char *const keys[], size_t n,
+                       struct array *out[]);
+
+/* Look up n keys and return a new array with the values that all of them
+ * have, in ascending order and each only once, for example the lines that
+ * contain all words of a query. The values of every key must be in
+ * ascending order, as line numbers inserted line by line are. The arrays are
+ * intersected starting from the key with the fewest values (see
+ * array_intersect). The array is empty if any key is absent, and must be
+ * cleaned up by the caller. Returns NULL on failure, if t or keys is NULL or
+ * if n is 0. */
+struct array *table_lookup_and(const struct table *t, const char *const keys[], size_t n);
+
+/* Report how evenly the keys of a chained table are spread: the length of the
+ * longest chain and the standard deviation of the chain lengths over all
+ * buckets. Returns 0 on success and 1 on failure or for other backends. */
+int table_chain_spread(const struct table *t, unsigned long *max_chain, double *stddev);
+
+/* Set the load factor below which table_delete halves the bucket array of a
+ * chained table, by default a quarter of the maximum load factor. The table
+ * never shrinks below the capacity it was created with. min_load_factor must
+ * be below half the maximum, so a shrink is not followed by a grow right
+ * away; 0 turns shrinking off. Returns 0 on success and 1 on invalid input
+ * or for other backends. */
+int table_set_min_load_factor(struct table *t, double min_load_factor);
+
+/* Rebuild t at the size its keys need, to give back the memory of a table
+ * that once held many more keys. A chained table gets the smallest bucket
+ * array that stays within the maximum load factor, finishing any incremental
+ * resize, and with TABLE_ARENA its nodes and values are copied into a fresh
+ * arena, which releases the memory of deleted keys. The open addressing
+ * backends get the fewest slots that fit and drop their deleted slots. The
+ * next inserts may grow the table again. Returns 0 on success and 1 on
+ * failure or for read-only tables, in which case t is unchanged. */
+int table_compact(struct table *t);
+
+/* Number of chain lengths table_stats counts separately, longer chains are
+ * counted together with the last one. */
+#define TABLE_STATS_CHAINS 16
+
+/* Statistics filled in by table_stats. The fields are only public so the
+ * struct can live on the stack. */
+struct table_stats {
+    unsigned long keys;
+    double load_factor;
+
+    /* Bucket occupancy and chain lengths, only for chained tables. During an
+     * incremental resize the buckets of both arrays are counted. */
+    unsigned long buckets;
+    unsigned long used_buckets;
+    /* chains[i] is the number of buckets with a chain of i keys */
+    unsigned long chains[TABLE_STATS_CHAINS];
+    unsigned long max_chain;
+
+    /* Lookups through table_lookup and table_lookup_batch, only counted
+     * after table_count_lookups turned counting on. The probe length is the
+     * number of keys compared; it is measured for chained tables, always 1
+     * for frozen tables and 0 for the other backends. */
+    unsigned long hits;
+    unsigned long misses;
+    double avg_hit_probes;
+    double avg_miss_probes;
+    unsigned long max_hit_probes;
+    unsigned long max_miss_probes;
+    /* Misses the Bloom filter answered without probing, with TABLE_BLOOM */
+    unsigned long bloom_rejects;
+
+    /* Resizes of chained tables and the time they took. With
+     * TABLE_INCREMENTAL_RESIZE only the start of a resize is timed, not the
+     * buckets moved by later operations. */
+    unsigned long resizes;
+    double resize_seconds;
+    /* With TABLE_INCREMENTAL_RESIZE, the most old buckets that a single
+     * insert or delete moved to the new array */
+    unsigned long max_moved_buckets;
+
+    /* Bytes of the table itself with its bucket array or slots and Bloom
+     * filter, of the per-key overhead (nodes and array structs), of the keys
+     * including their NUL and of the value data outside the arrays. */
+    size_t table_bytes;
+    size_t node_bytes;
+    size_t key_bytes;
+    size_t value_bytes;
+};
+
+/* Count the lookups of t for table_stats if enable is 1, stop counting them
+ * if it is 0. Counting is off for new tables. While it is on, every lookup
+ * adds to the counters of t, so lookups change the table and must not run
+ * concurrently. Returns 0 on success and 1 if t is NULL. */
+int table_count_lookups(struct table *t, int enable);
+
+/* Fill in stats for t. The resize counters are always kept, the lookup
+ * counters only with table_count_lookups, and the other numbers are computed
+ * by walking the whole table, which makes this call O(n). Lookups must not
+ * run on t at the same time. Returns 0 on success and 1 if t or stats is
+ * NULL. */
+int table_stats(const struct table *t, struct table_stats *stats);
+
+#endif /* HASH_TABLE_EXT_H */
@@ -0,0 +1,209 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file builds the word index of a text, optionally using several
+ * threads. The text is cut into parts that end right after a newline, so no
+ * word or line is split. Each thread tokenizes its part into its own table
+ * with line numbers counted from the start of the part, and counts the lines
+ * of the part. The tables are then merged pairwise in rounds: in every round
+ * the right table of each pair is appended to the left one, shifted by the
+ * number of lines covered by the left one, so the values stay in text order.
+ * After log2(threads) rounds the first table holds the whole index.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_table_ext.h"
+#include "index_build.h"
+#include "tokenize.h"
+
+/* Parameters of the tables that are built. */
+struct build_params {
+    unsigned long capacity;
+    double max_load_factor;
+    unsigned long (*hash_func)(const unsigned char *);
+    int mode;
+};
+
+/* One part of the text, together with the table built from it. */
+struct chunk {
+    /* Start and size of the part */
+    const unsigned char *text;
+    size_t size;
+    const struct build_params *params;
+    /* Index of the part, or of the parts merged into it so far */
+    struct table *table;
+    /* Number of lines covered by table */
+    unsigned long lines;
+    /* Chunk to merge into this one in the current round */
+    struct chunk *merge_from;
+    /* Set if building or merging failed */
+    int failed;
+};
+
+/* Insert a word of the text into the table in ctx, with its line number. */
+static int insert_word(void *ctx, const char *word, size_t len, unsigned long line_number) {
+    (void)len;
+    /* Line numbers only increase, so a word that occurs more than once on
+     * this line has it as its last value already. */
+    return table_insert_unique_tail(ctx, word, (int)line_number);
+}
+
+/* Return the number of newlines in size bytes of text. */
+static unsigned long count_newlines(const unsigned char *text, size_t size) {
+    unsigned long lines = 0;
+    for (size_t i = 0; i < size;) {
+        const unsigned char *nl = memchr(text + i, '\n', size - i);
+        if (nl == NULL) {
+            break;
+        }
+        lines++;
+        i = (size_t)(nl - text) + 1;
+    }
+    return lines;
+}
+
+/* Thread function that indexes the part of the text of a chunk. */
+static void *build_chunk(void *arg) {
+    struct chunk *c = arg;
+    const struct build_params *p = c->params;
+
+    c->table = table_init_mode(p->capacity, p->max_load_factor, p->hash_func, p->mode);
+    if (c->table == NULL || tokenize(c->text, c->size, 1, insert_word, c->table) != 0) {
+        c->failed = 1;
+        return NULL;
+    }
+    c->lines = count_newlines(c->text, c->size);
+    return NULL;
+}
+
+/* Thread function that appends the table of c->merge_from to that of c. */
+static void *merge_chunk(void *arg) {
+    struct chunk *c = arg;
+    if (table_merge(c->table, c->merge_from->table, (int)c->lines) != 0) {
+        c->failed = 1;
+    }
+    return NULL;
+}
+
+/*
+ * Run func on every job, each in its own thread. The first job runs on the
+ * calling thread, as do jobs for which no thread could be created.
+ */
+static void run_jobs(void *(*func)(void *), struct chunk **jobs, int n_jobs) {
+    pthread_t *threads = malloc((size_t)n_jobs * sizeof(pthread_t));
+    int *started = calloc((size_t)n_jobs, sizeof(int));
+
+    for (int i = 1; i < n_jobs; i++) {
+        if (threads != NULL && started != NULL
+            && pthread_create(&threads[i], NULL, func, jobs[i]) == 0) {
+            started[i] = 1;
+        } else {
+            func(jobs[i]);
+        }
+    }
+    if (n_jobs > 0) {
+        func(jobs[0]);
+    }
+    for (int i = 1; i < n_jobs; i++) {
+        if (started != NULL && started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    free(threads);
+    free(started);
+}
+
+/*
+ * Cut the text into n parts of about equal size, each ending right after a
+ * newline or at the end of the text. Parts may be empty.
+ */
+static void split_text(const unsigned char *text, size_t size, struct chunk *chunks, int n) {
+    size_t start = 0;
+    for (int i = 0; i < n; i++) {
+        size_t end = i == n - 1 ? size : size / (size_t)n * (size_t)(i + 1);
+        if (end < start) {
+            end = start;
+        } else if (end < size) {
+            const unsigned char *nl = memchr(text + end, '\n', size - end);
+            end = nl == NULL ? size : (size_t)(nl - text) + 1;
+        }
+        chunks[i].text = text + start;
+        chunks[i].size = end - start;
+        start = end;
+    }
+}
+
+/*
+ * Build the word index of a text.
+ *
+ * text: The text, does not need to be NUL terminated.
+ * size: Number of bytes of text.
+ * threads: Number of threads to use, values below 1 mean 1.
+ * capacity, max_load_factor, hash_func, mode: Passed to table_init_mode for
+ * every table.
+ *
+ * Returns the index, or NULL on failure.
+ */
+struct table *index_build(const unsigned char *text, size_t size, int threads,
+                          unsigned long capacity, double max_load_factor,
+                          unsigned long (*hash_func)(const unsigned char *),
+                          int mode) {
+    struct build_params params = { capacity, max_load_factor, hash_func, mode };
+    int n = threads > 1 && size > 0 ? threads : 1;
+
+    struct chunk *chunks = calloc((size_t)n, sizeof(struct chunk));
+    struct chunk **jobs = malloc((size_t)n * sizeof(struct chunk *));
+    if (chunks == NULL || jobs == NULL) {
+        free(chunks);
+        free(jobs);
+        return NULL;
+    }
+
+    split_text(text, size, chunks, n);
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        chunks[i].params = &params;
+        jobs[i] = &chunks[i];
+    }
+    run_jobs(build_chunk, jobs, n);
+    for (int i = 0; i < n; i++) {
+        failed |= chunks[i].failed;
+    }
+
+    /* In the round with the given stride, chunk i takes over chunk i + stride
+     * for every i that is a multiple of twice the stride. */
+    for (int stride = 1; stride < n && !failed; stride *= 2) {
+        int n_jobs = 0;
+        for (int i = 0; i + stride < n; i += 2 * stride) {
+            chunks[i].merge_from = &chunks[i + stride];
+            jobs[n_jobs++] = &chunks[i];
+        }
+        run_jobs(merge_chunk, jobs, n_jobs);
+
+        for (int j = 0; j < n_jobs; j++) {
+            struct chunk *from = jobs[j]->merge_from;
+            failed |= jobs[j]->failed;
+            jobs[j]->lines += from->lines;
+            table_cleanup(from->table);
+            from->table = NULL;
+        }
+    }
+
+    struct table *index = chunks[0].table;
+    if (failed) {
+        for (int i = 0; i < n; i++) {
+            table_cleanup(chunks[i].table);
+        }
+        index = NULL;
+    }
+    free(chunks);
+    free(jobs);
+    return index;
+}
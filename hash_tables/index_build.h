@@ -0,0 +1,23 @@
+#ifndef INDEX_BUILD_H
+#define INDEX_BUILD_H
+
+#include <stddef.h>
+
+/* Building the word index of a text: a table with every word of the text as
+ * key and the numbers of the lines it occurs on as values, in increasing
+ * order and each line once. */
+
+struct table;
+
+/* Build the word index of size bytes of text, with the table created by
+ * table_init_mode from the other parameters. With more than one thread the
+ * text is split at line boundaries into one part per thread, every thread
+ * indexes its part into a table of its own and the tables are then merged in
+ * pairs, also in parallel, until one is left. The result is the same as with
+ * a single thread. Returns the table, or NULL on failure. */
+struct table *index_build(const unsigned char *text, size_t size, int threads,
+                          unsigned long capacity, double max_load_factor,
+                          unsigned long (*hash_func)(const unsigned char *),
+                          int mode);
+
+#endif /* INDEX_BUILD_H */
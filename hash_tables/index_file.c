@@ -0,0 +1,672 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file stores a word index in a file that is used in place after
+ * mapping it into memory, so a large index is ready as soon as the pages
+ * that a lookup touches are read. The file starts with a header, followed by
+ * one record per key, an open addressing array of slots and the order of the
+ * keys. A slot holds the full hash of a key and the offset of its record, or
+ * 0 if it is empty. The order lists the slots of all keys in strcmp order,
+ * so ordered queries on a loaded file need no sorting.
+ * A record holds the length of the key, the size of the image of its values,
+ * the NUL terminated key and the image, each padded to 8 bytes. Slots are
+ * placed and probed linearly with a seeded hash of the file itself, so a
+ * weak hash function of the table can not pile all keys into a few long
+ * runs. The hash function of the table is only checked. Opening a file
+ * checks a checksum of the header and the bounds of the slots, but reads no
+ * records, so a large index is opened in the time it takes to read its
+ * slots. The record of a key is checked against the file the first time a
+ * lookup reaches it, and the values are returned as a read-only view of its
+ * image, created at that moment in memory that is reserved at open.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "array_ext.h"
+#include "hash_table_ext.h"
+#include "index_file.h"
+#include "tokenize.h"
+
+#define INDEX_MAGIC "HTINDEX"
+#define INDEX_VERSION 4
+
+/* Seed of the key hash in files that are written now. The seed is stored in
+ * the header, so it can change without breaking files that exist. */
+#define INDEX_SEED 0x2545f4914f6cdd1dULL
+
+/* Key hashed to check that the file was written with the same hash
+ * function as the one used for lookups. */
+#define HASH_CHECK_KEY "index file hash check"
+
+struct index_header {
+    /* INDEX_MAGIC, NUL terminated */
+    char magic[8];
+    uint64_t version;
+    uint64_t n_keys;
+    /* Number of slots, a power of two */
+    uint64_t n_slots;
+    uint64_t slots_offset;
+    uint64_t file_size;
+    /* Hash of HASH_CHECK_KEY */
+    uint64_t hash_check;
+    /* Seed of the key hash the slots are placed with */
+    uint64_t seed;
+    /* Offset of the order, n_keys slot numbers right after the slots */
+    uint64_t order_offset;
+    /* Checksum of the fields above, see header_checksum */
+    uint64_t checksum;
+};
+
+struct index_slot {
+    /* Seeded key hash of the key */
+    uint64_t hash;
+    /* Offset of the record, 0 for an empty slot */
+    uint64_t record;
+};
+
+/* Start of a record, followed by the key and the image of the values. */
+struct index_record {
+    uint32_t key_len;
+    uint32_t image_size;
+};
+
+/* States of the view of a slot. */
+enum view_state {
+    VIEW_NONE,
+    /* A lookup is checking the record and creating the view */
+    VIEW_BUSY,
+    VIEW_READY,
+    /* The record does not fit in the file */
+    VIEW_DAMAGED
+};
+
+struct index_file {
+    struct mapped_file file;
+    const struct index_header *header;
+    const struct index_slot *slots;
+    /* Slot numbers of the keys in strcmp order */
+    const uint64_t *order;
+    /* Room for the view of every slot, one after another, followed by the
+     * states. It is zeroed memory from calloc, which the system only backs
+     * with pages once a view is written to them. */
+    unsigned char *views;
+    /* enum view_state of every slot. Lookups on a const handle change them,
+     * so they are atomic. */
+    _Atomic unsigned char *states;
+};
+
+/* An index file being written, see index_writer_open. */
+struct index_writer {
+    FILE *out;
+    /* Name of the file, and the temporary name it is written under */
+    char *filename;
+    char *tmp_name;
+    unsigned long (*hash_func)(const unsigned char *);
+    /* Hash and record offset of every key written so far, they are put in
+     * slots when the number of keys is known */
+    struct index_slot *keys;
+    uint64_t n_keys;
+    uint64_t keys_capacity;
+    /* Offset of the next record */
+    uint64_t offset;
+    /* Buffer the records are built in */
+    unsigned char *buffer;
+    size_t buffer_size;
+    /* Set while the keys come in strcmp order, with the last key so far */
+    int sorted;
+    char *last_key;
+    size_t last_key_size;
+    /* Set after a failed write, the file is then discarded on close */
+    int failed;
+};
+
+/* Finalizer of MurmurHash3, mixes all bits of x into all bits. */
+static uint64_t fmix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* Seeded 64 bit hash of a key: FNV-1a followed by a finalizer. */
+static uint64_t key_hash(const char *key, uint64_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (const unsigned char *c = (const unsigned char *)key; *c != '\0'; c++) {
+        h ^= *c;
+        h *= 0x100000001b3ULL;
+    }
+    return fmix64(h);
+}
+
+/* Return the checksum of all fields of a header before the checksum. */
+static uint64_t header_checksum(const struct index_header *h) {
+    uint64_t words[offsetof(struct index_header, checksum) / 8];
+    memcpy(words, h, sizeof(words));
+    uint64_t sum = 0;
+    for (size_t i = 0; i < sizeof(words) / 8; i++) {
+        sum = fmix64(sum ^ words[i]);
+    }
+    return sum;
+}
+
+/* Round n up to a multiple of 8. */
+static size_t pad8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+/*
+ * Start writing an index file.
+ *
+ * filename: The file to write.
+ * hash_func: The hash function lookups will use.
+ *
+ * Returns a handle to the writer, or NULL on failure.
+ */
+struct index_writer *index_writer_open(const char *filename,
+                                       unsigned long (*hash_func)(const unsigned char *)) {
+    struct index_writer *w = calloc(1, sizeof(struct index_writer));
+    if (w == NULL) {
+        return NULL;
+    }
+    w->hash_func = hash_func;
+    w->offset = sizeof(struct index_header);
+    w->sorted = 1;
+    w->filename = malloc(strlen(filename) + 1);
+    w->tmp_name = malloc(strlen(filename) + 5);
+    if (w->filename == NULL || w->tmp_name == NULL) {
+        free(w->filename);
+        free(w->tmp_name);
+        free(w);
+        return NULL;
+    }
+    strcpy(w->filename, filename);
+    sprintf(w->tmp_name, "%s.tmp", filename);
+
+    /* The header is written last, when all counts are known. */
+    struct index_header header;
+    memset(&header, 0, sizeof(header));
+    w->out = fopen(w->tmp_name, "wb");
+    if (w->out == NULL) {
+        free(w->filename);
+        free(w->tmp_name);
+        free(w);
+        return NULL;
+    }
+    w->failed = fwrite(&header, sizeof(header), 1, w->out) != 1;
+    return w;
+}
+
+/*
+ * Write the record of one key and remember where it is.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int index_writer_add(struct index_writer *w, const char *key, const struct array *values) {
+    size_t key_len = strlen(key);
+    size_t image_size = array_image_size(values);
+    size_t size = sizeof(struct index_record) + pad8(key_len + 1) + pad8(image_size);
+
+    if (w->failed) {
+        return 1;
+    }
+    if (w->n_keys == w->keys_capacity) {
+        uint64_t capacity = w->keys_capacity > 0 ? 2 * w->keys_capacity : 1024;
+        struct index_slot *bigger = realloc(w->keys, capacity * sizeof(struct index_slot));
+        if (bigger == NULL) {
+            w->failed = 1;
+            return 1;
+        }
+        w->keys = bigger;
+        w->keys_capacity = capacity;
+    }
+    if (size > w->buffer_size) {
+        unsigned char *bigger = realloc(w->buffer, size);
+        if (bigger == NULL) {
+            w->failed = 1;
+            return 1;
+        }
+        w->buffer = bigger;
+        w->buffer_size = size;
+    }
+
+    struct index_record record = { (uint32_t)key_len, (uint32_t)image_size };
+    unsigned char *key_start = w->buffer + sizeof(record);
+    unsigned char *image_start = key_start + pad8(key_len + 1);
+    memset(w->buffer, 0, size);
+    memcpy(w->buffer, &record, sizeof(record));
+    memcpy(key_start, key, key_len + 1);
+    array_image_write(values, image_start);
+    if (fwrite(w->buffer, 1, size, w->out) != size) {
+        w->failed = 1;
+        return 1;
+    }
+
+    /* Writers that add the keys in order, like the external build, spare
+     * write_slots sorting them. */
+    if (w->sorted && w->n_keys > 0 && strcmp(w->last_key, key) >= 0) {
+        w->sorted = 0;
+    }
+    if (w->sorted) {
+        if (key_len + 1 > w->last_key_size) {
+            char *bigger = realloc(w->last_key, key_len + 1);
+            if (bigger == NULL) {
+                w->failed = 1;
+                return 1;
+            }
+            w->last_key = bigger;
+            w->last_key_size = key_len + 1;
+        }
+        memcpy(w->last_key, key, key_len + 1);
+    }
+
+    w->keys[w->n_keys].hash = key_hash(key, INDEX_SEED);
+    w->keys[w->n_keys].record = w->offset;
+    w->n_keys++;
+    w->offset += size;
+    return 0;
+}
+
+/* A key of the file being written with the slot it was placed in. */
+struct order_entry {
+    const char *key;
+    uint64_t slot;
+};
+
+/* Compare two order entries by key for qsort. */
+static int compare_order(const void *a, const void *b) {
+    return strcmp(((const struct order_entry *)a)->key, ((const struct order_entry *)b)->key);
+}
+
+/*
+ * Turn the slot numbers of the keys, in the order they were added, into
+ * their strcmp order. Keys that were added in order already are in it,
+ * others are read back from the records written so far and sorted.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int sort_order(struct index_writer *w, uint64_t *order) {
+    if (w->sorted) {
+        return 0;
+    }
+    struct mapped_file file;
+    if (fflush(w->out) != 0 || map_file(w->tmp_name, &file) != 0) {
+        return 1;
+    }
+    struct order_entry *entries = malloc(w->n_keys * sizeof(struct order_entry));
+    if (entries == NULL) {
+        unmap_file(&file);
+        return 1;
+    }
+    for (uint64_t k = 0; k < w->n_keys; k++) {
+        entries[k].key = (const char *)file.data + w->keys[k].record + sizeof(struct index_record);
+        entries[k].slot = order[k];
+    }
+    qsort(entries, w->n_keys, sizeof(struct order_entry), compare_order);
+    for (uint64_t k = 0; k < w->n_keys; k++) {
+        order[k] = entries[k].slot;
+    }
+    free(entries);
+    unmap_file(&file);
+    return 0;
+}
+
+/*
+ * Write the slots, the order and the header, and put the file in place.
+ * Every key goes to the first free slot from the position of its key hash.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int write_slots(struct index_writer *w) {
+    /* At most half of the slots are used, which keeps probing short. */
+    uint64_t n_slots = 2;
+    while (n_slots < 2 * w->n_keys) {
+        n_slots *= 2;
+    }
+    struct index_slot *slots = calloc(n_slots, sizeof(struct index_slot));
+    uint64_t *order = malloc((w->n_keys > 0 ? w->n_keys : 1) * sizeof(uint64_t));
+    if (slots == NULL || order == NULL) {
+        free(slots);
+        free(order);
+        return 1;
+    }
+    for (uint64_t k = 0; k < w->n_keys; k++) {
+        uint64_t i = w->keys[k].hash & (n_slots - 1);
+        while (slots[i].record != 0) {
+            i = (i + 1) & (n_slots - 1);
+        }
+        slots[i] = w->keys[k];
+        order[k] = i;
+    }
+
+    struct index_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.n_keys = w->n_keys;
+    header.n_slots = n_slots;
+    header.slots_offset = w->offset;
+    header.order_offset = header.slots_offset + n_slots * sizeof(struct index_slot);
+    header.file_size = header.order_offset + w->n_keys * sizeof(uint64_t);
+    header.hash_check = w->hash_func((const unsigned char *)HASH_CHECK_KEY);
+    header.seed = INDEX_SEED;
+    header.checksum = header_checksum(&header);
+    int failed = sort_order(w, order) != 0
+                 || fwrite(slots, sizeof(struct index_slot), n_slots, w->out) != n_slots
+                 || fwrite(order, sizeof(uint64_t), w->n_keys, w->out) != w->n_keys
+                 || fseek(w->out, 0, SEEK_SET) != 0
+                 || fwrite(&header, sizeof(header), 1, w->out) != 1;
+    free(slots);
+    free(order);
+    return failed;
+}
+
+/*
+ * Finish an index file, or discard it.
+ *
+ * w: The writer, it is freed.
+ * keep: 1 to complete the file, 0 to remove it.
+ *
+ * Returns 0 if the file was completed, 1 otherwise.
+ */
+int index_writer_close(struct index_writer *w, int keep) {
+    int failed = w->failed || !keep || write_slots(w) != 0;
+    if (fclose(w->out) != 0) {
+        failed = 1;
+    }
+    failed = failed || rename(w->tmp_name, w->filename) != 0;
+    if (failed) {
+        remove(w->tmp_name);
+    }
+
+    free(w->filename);
+    free(w->tmp_name);
+    free(w->keys);
+    free(w->buffer);
+    free(w->last_key);
+    free(w);
+    return failed;
+}
+
+/* Write the record of a key of a table, ctx is the writer. */
+static int write_record(void *ctx, const char *key, struct array *values) {
+    return index_writer_add(ctx, key, values);
+}
+
+/*
+ * Write a table to an index file.
+ *
+ * filename: The file to write.
+ * t: The table, it is not changed.
+ * hash_func: The hash function of the table.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int index_write(const char *filename, const struct table *t,
+                unsigned long (*hash_func)(const unsigned char *)) {
+    struct index_writer *w = index_writer_open(filename, hash_func);
+    if (w == NULL) {
+        return 1;
+    }
+    int failed = table_foreach(t, write_record, w) != 0;
+    return index_writer_close(w, !failed) || failed;
+}
+
+/*
+ * Check that every full slot points between the header and the slots, and
+ * that the number of full slots matches the header. The records themselves
+ * are checked by the first lookup that reaches them.
+ *
+ * Returns 0 if all slots are valid, 1 otherwise.
+ */
+static int check_slots(const struct index_file *f) {
+    uint64_t records_end = f->header->slots_offset;
+    uint64_t n_keys = 0;
+
+    for (uint64_t i = 0; i < f->header->n_slots; i++) {
+        uint64_t offset = f->slots[i].record;
+        if (offset == 0) {
+            continue;
+        }
+        if (offset < sizeof(struct index_header) || offset % 8 != 0
+            || offset > records_end - sizeof(struct index_record)) {
+            return 1;
+        }
+        n_keys++;
+    }
+    return n_keys != f->header->n_keys;
+}
+
+/*
+ * Map an index file and check its header and slots.
+ *
+ * filename: The file to open.
+ * hash_func: Hash function used for lookups.
+ *
+ * Returns a handle to the file, or NULL on failure.
+ */
+struct index_file *index_open(const char *filename,
+                              unsigned long (*hash_func)(const unsigned char *)) {
+    struct index_file *f = malloc(sizeof(struct index_file));
+    if (f == NULL) {
+        return NULL;
+    }
+    if (map_file(filename, &f->file) != 0) {
+        free(f);
+        return NULL;
+    }
+
+    /* At least one slot has to be empty, so every search ends. */
+    const struct index_header *h = (const struct index_header *)f->file.data;
+    if (f->file.size < sizeof(struct index_header)
+        || memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0
+        || h->version != INDEX_VERSION || h->checksum != header_checksum(h)
+        || h->file_size != f->file.size
+        || h->n_slots == 0 || (h->n_slots & (h->n_slots - 1)) != 0
+        || h->n_keys >= h->n_slots
+        || h->slots_offset < sizeof(struct index_header) || h->slots_offset % 8 != 0
+        || h->slots_offset > f->file.size
+        || h->n_slots > (f->file.size - h->slots_offset) / sizeof(struct index_slot)
+        || h->order_offset != h->slots_offset + h->n_slots * sizeof(struct index_slot)
+        || (f->file.size - h->order_offset) / sizeof(uint64_t) != h->n_keys
+        || h->hash_check != hash_func((const unsigned char *)HASH_CHECK_KEY)) {
+        unmap_file(&f->file);
+        free(f);
+        return NULL;
+    }
+
+    f->header = h;
+    f->slots = (const struct index_slot *)(f->file.data + h->slots_offset);
+    f->order = (const uint64_t *)(const void *)(f->file.data + h->order_offset);
+    f->views = calloc(h->n_slots, array_footprint() + sizeof(*f->states));
+    if (f->views == NULL || check_slots(f) != 0) {
+        free(f->views);
+        unmap_file(&f->file);
+        free(f);
+        return NULL;
+    }
+    f->states = (_Atomic unsigned char *)(f->views + h->n_slots * array_footprint());
+    /* Lookups jump around the file, reading ahead does not help them. */
+    posix_madvise((void *)(uintptr_t)f->file.data, f->file.size, POSIX_MADV_RANDOM);
+
+    return f;
+}
+
+/* Return the key of a full slot whose record was checked. */
+static const char *slot_key(const struct index_file *f, uint64_t i) {
+    return (const char *)f->file.data + f->slots[i].record + sizeof(struct index_record);
+}
+
+/*
+ * Check the record of a full slot against the file and create the view of
+ * its values. The record has to end before the slots, with a NUL terminated
+ * key and a complete image.
+ *
+ * Returns the view, or NULL if the record is damaged.
+ */
+static struct array *open_record(const struct index_file *f, uint64_t i) {
+    uint64_t records_end = f->header->slots_offset;
+    uint64_t offset = f->slots[i].record;
+    struct index_record r;
+    memcpy(&r, f->file.data + offset, sizeof(r));
+
+    uint64_t key_start = offset + sizeof(r);
+    uint64_t image_start = key_start + pad8((size_t)r.key_len + 1);
+    if (image_start > records_end || r.image_size > records_end - image_start) {
+        return NULL;
+    }
+    const char *key = (const char *)f->file.data + key_start;
+    const unsigned char *image = f->file.data + image_start;
+    if (key[r.key_len] != '\0' || memchr(key, '\0', r.key_len) != NULL
+        || array_image_check(image, r.image_size) != 0) {
+        return NULL;
+    }
+    return array_view_at(f->views + i * array_footprint(), image);
+}
+
+/*
+ * Return the view of the values of a full slot, checking its record the
+ * first time. A lookup that finds another one checking the record waits
+ * for it, which takes as long as reading the record.
+ *
+ * Returns the view, or NULL if the record is damaged.
+ */
+static struct array *slot_values(const struct index_file *f, uint64_t i) {
+    unsigned char state = atomic_load_explicit(&f->states[i], memory_order_acquire);
+    if (state == VIEW_NONE
+        && atomic_compare_exchange_strong(&f->states[i], &state, VIEW_BUSY)) {
+        state = open_record(f, i) != NULL ? VIEW_READY : VIEW_DAMAGED;
+        atomic_store_explicit(&f->states[i], state, memory_order_release);
+    }
+    while (state == VIEW_BUSY) {
+        state = atomic_load_explicit(&f->states[i], memory_order_acquire);
+    }
+    return state == VIEW_READY ? (struct array *)(void *)(f->views + i * array_footprint())
+                               : NULL;
+}
+
+/*
+ * Return the seeded hash of a key, which index_find and index_prefetch take.
+ */
+unsigned long index_hash(const struct index_file *f, const char *key) {
+    return (unsigned long)key_hash(key, f->header->seed);
+}
+
+/*
+ * Look up a key. Keys are only compared once the hash matches and the
+ * record was checked.
+ *
+ * Returns the values stored for the key, or NULL if it is not present or
+ * its record is damaged.
+ */
+struct array *index_find(const struct index_file *f, const char *key,
+                         unsigned long hash) {
+    uint64_t mask = f->header->n_slots - 1;
+    for (uint64_t i = hash & mask; f->slots[i].record != 0; i = (i + 1) & mask) {
+        if (f->slots[i].hash == hash) {
+            struct array *values = slot_values(f, i);
+            if (values != NULL && strcmp(slot_key(f, i), key) == 0) {
+                return values;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Look up the key at a position of the strcmp order of the keys, which is
+ * checked like the records are, by the first lookup that reaches it.
+ *
+ * Returns the key and sets values, or returns NULL if rank is not below the
+ * number of keys or the key is damaged.
+ */
+const char *index_key_at(const struct index_file *f, unsigned long rank,
+                         struct array **values) {
+    if (rank >= f->header->n_keys) {
+        return NULL;
+    }
+    uint64_t i = f->order[rank];
+    if (i >= f->header->n_slots || f->slots[i].record == 0) {
+        return NULL;
+    }
+    *values = slot_values(f, i);
+    return *values != NULL ? slot_key(f, i) : NULL;
+}
+
+/*
+ * Prefetch the first slot probed for a hash.
+ */
+void index_prefetch(const struct index_file *f, unsigned long hash) {
+    __builtin_prefetch(&f->slots[hash & (f->header->n_slots - 1)]);
+}
+
+/*
+ * Call a function for every key in the file.
+ *
+ * Returns 0 if func returned 0 for all keys, otherwise its first non-zero
+ * return value, or 1 if a record is damaged.
+ */
+int index_foreach(const struct index_file *f,
+                  int (*func)(void *ctx, const char *key, struct array *value),
+                  void *ctx) {
+    for (uint64_t i = 0; i < f->header->n_slots; i++) {
+        if (f->slots[i].record != 0) {
+            struct array *values = slot_values(f, i);
+            if (values == NULL) {
+                return 1;
+            }
+            int res = func(ctx, slot_key(f, i), values);
+            if (res != 0) {
+                return res;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Returns the number of keys in the file.
+ */
+unsigned long index_size(const struct index_file *f) {
+    return (unsigned long)f->header->n_keys;
+}
+
+/*
+ * Returns the load factor of the slot array.
+ */
+double index_load_factor(const struct index_file *f) {
+    return (double)f->header->n_keys / (double)f->header->n_slots;
+}
+
+/*
+ * Returns the number of bytes of the handle, the mapped slots, their states
+ * and the views of the keys, which are only backed once they are looked up.
+ */
+unsigned long index_memory(const struct index_file *f) {
+    return (unsigned long)(sizeof(struct index_file)
+                           + f->header->n_slots * (sizeof(struct index_slot) + 1)
+                           + f->header->n_keys * array_footprint());
+}
+
+/*
+ * Free the views and unmap the file.
+ */
+void index_close(struct index_file *f) {
+    if (f == NULL) {
+        return;
+    }
+    free(f->views);
+    unmap_file(&f->file);
+    free(f);
+}
@@ -0,0 +1,98 @@
+#ifndef INDEX_FILE_H
+#define INDEX_FILE_H
+
+#include <stddef.h>
+
+/* Word index stored in a file, used as the TABLE_MAPPED backend of the hash
+ * table in hash_table.c. The file holds a hashed slot array, one record per
+ * key with the key and an image of its values (see array_image_write) and
+ * the strcmp order of the keys.
+ * The slots are placed with a seeded hash of the file's own, the hash
+ * function of the table is only recorded to check that a file is opened
+ * with the same one.
+ * Only offsets are stored, so the file is used in place after mapping it and
+ * processes that open the same file share its pages. Files are only
+ * portable between machines with the same byte order. */
+
+struct array;
+struct table;
+
+/* Handle to an opened index file. */
+struct index_file;
+
+/* Write the keys and values of table t to an index file, in which lookups
+ * will use the hash function of t. The file is written under a temporary
+ * name and renamed when it is complete. Returns 0 on success and 1 on
+ * failure. */
+int index_write(const char *filename, const struct table *t,
+                unsigned long (*hash_func)(const unsigned char *));
+
+/* Handle to an index file that is being written key by key, for building
+ * an index without a table holding all keys. */
+struct index_writer;
+
+/* Start writing an index file, in which lookups will use hash_func. Like
+ * index_write, the file is written under a temporary name. Returns NULL on
+ * failure. */
+struct index_writer *index_writer_open(const char *filename,
+                                       unsigned long (*hash_func)(const unsigned char *));
+
+/* Write key with its values to the file. Every key may only be added once.
+ * The writer keeps 16 bytes per key in memory until it is closed, when it
+ * needs 8 more per key, and 16 more to sort the keys unless they were added
+ * in strcmp order. Returns 0
+ * on success and 1 on failure, after which the file can only be discarded. */
+int index_writer_add(struct index_writer *w, const char *key, const struct array *values);
+
+/* Complete the file and rename it to its name if keep is 1 and no write
+ * failed, or remove it otherwise. Frees w. Returns 0 if the file was
+ * completed and 1 otherwise. */
+int index_writer_close(struct index_writer *w, int keep);
+
+/* Map an index file. Only the header and the slots are read and checked,
+ * the record of a key is checked by the first lookup that reaches it, so
+ * lookups are safe on a damaged file and never allocate. Fails if the file
+ * is not a complete index file or was written with another hash function
+ * than hash_func. Returns NULL on failure. */
+struct index_file *index_open(const char *filename,
+                              unsigned long (*hash_func)(const unsigned char *));
+
+/* Returns the hash of key that index_find and index_prefetch take. */
+unsigned long index_hash(const struct index_file *f, const char *key);
+
+/* Returns the values stored for key, or NULL if the key is not present or
+ * its record is damaged. The values are a read-only view of the file.
+ * Threads can share the handle. hash must be index_hash(f, key). */
+struct array *index_find(const struct index_file *f, const char *key,
+                         unsigned long hash);
+
+/* Returns the key at position rank of the strcmp order of the keys and sets
+ * values to its values, or returns NULL if rank is not below index_size or
+ * the key is damaged. The key is part of the mapped file. */
+const char *index_key_at(const struct index_file *f, unsigned long rank,
+                         struct array **values);
+
+/* Prefetches the slot where the search for hash starts. */
+void index_prefetch(const struct index_file *f, unsigned long hash);
+
+/* Calls func for every key with its values until func returns non-zero.
+ * Returns 0, the non-zero return value of func, or 1 if a record is
+ * damaged. */
+int index_foreach(const struct index_file *f,
+                  int (*func)(void *ctx, const char *key, struct array *value),
+                  void *ctx);
+
+/* Returns the number of keys. */
+unsigned long index_size(const struct index_file *f);
+
+/* Returns the number of keys / the number of slots. */
+double index_load_factor(const struct index_file *f);
+
+/* Returns the number of bytes of the handle, the slots and the views,
+ * without the keys and the data of the values. */
+unsigned long index_memory(const struct index_file *f);
+
+/* Unmaps the file and frees the views handed out by index_find. */
+void index_close(struct index_file *f);
+
+#endif /* INDEX_FILE_H */
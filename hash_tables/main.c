@@ -3,129 +3,201 @@
  * Program: BSc Informatics
  */
 
-#include <ctype.h>
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-#include "array.h"
+#include "array_ext.h"
 #include "hash_func.h"
-#include "hash_table.h"
+#include "external_build.h"
+#include "hash_table_ext.h"
+#include "index_build.h"
+#include "sorted_index.h"
+#include "tokenize.h"
 
 #define LINE_LENGTH 256
+/* Number of queries looked up together in batch mode */
+#define QUERY_BLOCK 64
+/* Maximum number of words of a query, further words are ignored */
+#define QUERY_WORDS 16
 
 #define TABLE_START_SIZE 256
 #define MAX_LOAD_FACTOR 0.6
 #define HASH_FUNCTION hash_too_simple
+#define TABLE_MODE (TABLE_CHAINING | TABLE_ARENA | TABLE_COMPRESSED)
 
 #define START_TESTS 2
 #define MAX_TESTS 2
-#define HASH_TESTS 1
+#define HASH_TESTS 4
 
 
 /* Replace every non-ascii char with a space and lowercase every char. */
 static void cleanup_string(char *line) {
-    for (char *c = line; *c != '\0'; c++) {
-        *c = (char) tolower(*c);
-        if (!isalpha(*c)) {
-            *c = ' ';
-        }
+    unsigned char *c = (unsigned char *)line;
+    size_t len = strlen(line);
+    for (size_t i = 0; i < len; i += 64) {
+        fold_letters(c + i, c + i, len - i < 64 ? len - i : 64, NULL);
     }
 }
 
-/* Return a pointer to a heap allocated string with all the characters we
- * use as word delimiters. Return NULL on failure. */
-static char *calc_delim(void) {
-    const size_t ascii_table_size = 128;
-    char *res = malloc(sizeof(char) * ascii_table_size);
-    if (!res) {
-        return NULL;
-    }
-
-    int res_index = 0;
-    for (unsigned char c = 1; c < ascii_table_size; c++) {
-        if (!isalpha(c)) {   /* if it's not an alpha it's a delimiter char. */
-            res[res_index++] = (char) c;
-        }
-    }
-    res[res_index] = '\0';
-    return res;
-}
-
 /* Creates a hash table with a word index for the specified file and
- * parameters. Return a pointer to hash table or NULL if an error occured.
+ * parameters, using the given number of threads. Return a pointer to hash
+ * table or NULL if an error occured.
  */
 static struct table *create_from_file(char *filename,
                                unsigned long start_size,
                                double max_load,
-                               unsigned long (*hash_func)(const unsigned char *)) {
-    FILE *fp = fopen(filename, "r");
-    if (fp == NULL)
+                               unsigned long (*hash_func)(const unsigned char *),
+                               int threads) {
+    struct mapped_file file;
+    if (map_file(filename, &file) != 0) {
         return NULL;
+    }
 
-    char *line = malloc(LINE_LENGTH * sizeof(char));
-    if (!line) {
-        fclose(fp);
+    struct table *hash_table = index_build(file.data, file.size, threads, start_size,
+                                           max_load, hash_func, TABLE_MODE);
+    unmap_file(&file);
+
+    return hash_table;
+}
+
+/* Builds the word index of a text file straight into an index file, with at
+ * most budget bytes for the words collected at a time, and loads it. Return
+ * a pointer to the read-only table or NULL if an error occured. */
+static struct table *create_external(char *filename, char *index_file, size_t budget) {
+    struct mapped_file file;
+    if (map_file(filename, &file) != 0) {
         return NULL;
     }
 
-    struct table *hash_table = table_init(start_size, max_load, hash_func);
-    if (!hash_table) {
-        fclose(fp);
-        free(line);
-        return NULL;
+    int failed = index_build_external(file.data, file.size, index_file, budget, HASH_FUNCTION);
+    unmap_file(&file);
+    return failed ? NULL : table_load(index_file, HASH_FUNCTION);
+}
+
+/* Splits a cleaned up line into the words of a query, at most QUERY_WORDS.
+ * Returns the number of words. */
+static size_t split_query(char *line, const char *words[]) {
+    size_t n = 0;
+    for (char *word = strtok(line, " "); word && n < QUERY_WORDS; word = strtok(NULL, " ")) {
+        words[n++] = word;
     }
+    return n;
+}
 
-    unsigned long line_number = 1;
-    while (fgets(line, LINE_LENGTH, fp)) {
+/* Prints the words of a query followed by the line numbers found for it. */
+static void print_result(const char *const words[], size_t n, const struct array *values) {
+    for (size_t i = 0; i < n; i++) {
+        printf("%s%s", words[i], i + 1 < n ? " " : "\n");
+    }
+    if (values) {
+        struct array_cursor c;
+        int value;
+        array_cursor_init(&c, values);
+        while (array_cursor_next(&c, &value)) {
+            printf("* %d\n", value);
+        }
+    }
+    printf("\n");
+}
+
+/* Prints the lines that contain all words of a query of more than one word.
+ * Return 0 if succesful and 1 on failure. */
+static int answer_and_query(struct table *hash_table, const char *const words[], size_t n) {
+    struct array *values = table_lookup_and(hash_table, words, n);
+    if (!values) {
+        return 1;
+    }
+    print_result(words, n, values);
+    array_cleanup(values);
+    return 0;
+}
+
+/* Reads queries from stdin, one per line, and prints the lines that contain
+ * all words of every query. Return 0 if succesful and 1 on failure. */
+static int stdin_lookup(struct table *hash_table) {
+    char *line = malloc(LINE_LENGTH * sizeof(char));
+    if (!line) {
+        return 1;
+    }
+
+    const char *words[QUERY_WORDS];
+    while (fgets(line, LINE_LENGTH, stdin)) {
         cleanup_string(line);
-        char *delim = calc_delim();
-        if (!delim) {
-            table_cleanup(hash_table);
-            fclose(fp);
+        size_t n = split_query(line, words);
+        if (n == 1) {
+            print_result(words, 1, table_lookup(hash_table, words[0]));
+        } else if (n > 1 && answer_and_query(hash_table, words, n) != 0) {
             free(line);
-            return NULL;
+            return 1;
         }
+    }
+    free(line);
+    return 0;
+}
 
-        char *word = strtok(line, delim);
-        while (word) {
-            struct array *values = table_lookup(hash_table, word);
+/* Like stdin_lookup, but reads up to QUERY_BLOCK queries before looking up
+ * the single word ones with a single batch lookup. Return 0 if succesful and
+ * 1 on failure. */
+static int stdin_lookup_batch(struct table *hash_table) {
+    char (*lines)[LINE_LENGTH] = malloc(QUERY_BLOCK * sizeof(*lines));
+    if (!lines) {
+        return 1;
+    }
 
-            int already_exists = 0;
-            if (values) {
-                for (size_t i = 0; i < array_size(values); i++) {
-                    if (array_get(values, i) == (int)line_number) {
-                        already_exists = 1;
-                        break;
-                    }
-                }
-            }
+    const char *queries[QUERY_BLOCK][QUERY_WORDS];
+    size_t counts[QUERY_BLOCK];
+    /* The word of every single word query, NULL for the other queries */
+    const char *words[QUERY_BLOCK];
+    struct array *results[QUERY_BLOCK];
+    int done = 0;
 
-            if (!already_exists) {
-                if (table_insert(hash_table, word, line_number) != 0) {
-                    table_cleanup(hash_table);
-                    fclose(fp);
-                    free(line);
-                    free(delim);
-                    return NULL;
-                }
+    while (!done) {
+        size_t n = 0;
+        while (n < QUERY_BLOCK) {
+            if (!fgets(lines[n], LINE_LENGTH, stdin)) {
+                done = 1;
+                break;
             }
+            cleanup_string(lines[n]);
+            counts[n] = split_query(lines[n], queries[n]);
+            if (counts[n] > 0) {
+                words[n] = counts[n] == 1 ? queries[n][0] : NULL;
+                n++;
+            }
+        }
 
-            word = strtok(NULL, delim);
+        if (table_lookup_batch(hash_table, words, n, results) != 0) {
+            free(lines);
+            return 1;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (counts[i] == 1) {
+                print_result(queries[i], 1, results[i]);
+            } else if (answer_and_query(hash_table, queries[i], counts[i]) != 0) {
+                free(lines);
+                return 1;
+            }
         }
-        free(delim);
-        line_number++;
     }
-    fclose(fp);
-    free(line);
+    free(lines);
+    return 0;
+}
 
-    return hash_table;
+/* Prints a word with its line numbers, while visiting the sorted index. */
+static int print_entry(void *ctx, const char *key, struct array *values) {
+    (void)ctx;
+    print_result(&key, 1, values);
+    return 0;
 }
 
-/* Reads words from stdin and prints line lookup results per word.
+/* Reads prefixes from stdin, one per line, and prints every word that starts
+ * with the prefix together with its line numbers, in alphabetical order.
  * Return 0 if succesful and 1 on failure. */
-static int stdin_lookup(struct table *hash_table) {
+static int stdin_prefix_lookup(const struct sorted_index *index) {
     char *line = malloc(LINE_LENGTH * sizeof(char));
     if (!line) {
         return 1;
@@ -133,47 +205,107 @@ static int stdin_lookup(struct table *hash_table) {
 
     while (fgets(line, LINE_LENGTH, stdin)) {
         cleanup_string(line);
-        char *word = strtok(line, " ");
-        if (!word) {
-            continue;
+        char *prefix = strtok(line, " ");
+        if (prefix) {
+            sorted_index_prefix(index, prefix, print_entry, NULL);
         }
+    }
+    free(line);
+    return 0;
+}
 
-        printf("%s\n", word);
+/* Answers the queries on stdin, or with dump set prints all words in
+ * alphabetical order instead. Prefix queries and the dump use a sorted index
+ * of the words. Return 0 if succesful and 1 on failure. */
+static int answer_queries(struct table *hash_table, int batch, int prefix, int dump) {
+    if (!prefix && !dump) {
+        return batch ? stdin_lookup_batch(hash_table) : stdin_lookup(hash_table);
+    }
 
-        struct array *values = table_lookup(hash_table, word);
-        if (values) {
-            for (size_t i = 0; i < array_size(values); i++) {
-                printf("* %d\n", array_get(values, i));
-            }
+    struct sorted_index *index = sorted_index_build(hash_table);
+    if (!index) {
+        return 1;
+    }
+    int failed = 0;
+    if (dump) {
+        sorted_index_range(index, NULL, NULL, print_entry, NULL);
+    } else {
+        failed = stdin_prefix_lookup(index);
+    }
+    sorted_index_cleanup(index);
+    return failed;
+}
+
+/* Prints the statistics of a table to stderr, so they do not mix with the
+ * lookup results. */
+static void print_stats(const char *when, const struct table *hash_table) {
+    struct table_stats stats;
+    if (table_stats(hash_table, &stats) != 0) {
+        return;
+    }
+
+    fprintf(stderr, "Table statistics %s:\n", when);
+    fprintf(stderr, "  keys: %lu\tload factor: %.2f\n", stats.keys, stats.load_factor);
+    if (stats.buckets > 0) {
+        fprintf(stderr, "  buckets: %lu\tused: %lu (%.2f%%)\tlongest chain: %lu\n",
+                stats.buckets, stats.used_buckets,
+                100.0 * (double)stats.used_buckets / (double)stats.buckets, stats.max_chain);
+        fprintf(stderr, "  chain lengths:");
+        for (int i = 0; i < TABLE_STATS_CHAINS; i++) {
+            fprintf(stderr, " %d%s:%lu", i, i == TABLE_STATS_CHAINS - 1 ? "+" : "",
+                    stats.chains[i]);
         }
-        printf("\n");
+        fprintf(stderr, "\n");
     }
-    free(line);
-    return 0;
+    fprintf(stderr, "  hits: %lu\tprobes avg: %.2f\tmax: %lu\n",
+            stats.hits, stats.avg_hit_probes, stats.max_hit_probes);
+    fprintf(stderr, "  misses: %lu\tprobes avg: %.2f\tmax: %lu\n",
+            stats.misses, stats.avg_miss_probes, stats.max_miss_probes);
+    fprintf(stderr, "  resizes: %lu\ttime: %.6f s\tmost buckets moved at once: %lu\n",
+            stats.resizes, stats.resize_seconds, stats.max_moved_buckets);
+    fprintf(stderr, "  bytes: table %zu\tnodes %zu\tkeys %zu\tvalues %zu\ttotal %zu\n",
+            stats.table_bytes, stats.node_bytes, stats.key_bytes, stats.value_bytes,
+            stats.table_bytes + stats.node_bytes + stats.key_bytes + stats.value_bytes);
 }
 
-static void timed_construction(char *filename) {
+/* Returns the time on the monotonic clock in milliseconds. */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static void timed_construction(char *filename, int threads) {
     /* Here you can edit the hash table testing parameters: Starting size,
      * maximum load factor and hash function used, and see the the effect
      * on the time it takes to build the table.
      * You can edit the tested values in the 3 arrays below. If you change
      * the number of elements in the array, change the defined constants
-     * at the top of the file too, to change the size of the arrays. */
+     * at the top of the file too, to change the size of the arrays.
+     * Every table is built once; use make bench for repeated measurements
+     * of the single operations. */
     unsigned long start_sizes[START_TESTS] = { 2, 65536 };
     double max_loads[MAX_TESTS] = { 0.2, 1.0 };
-    unsigned long (*hash_funcs[HASH_TESTS])(const unsigned char *) = { hash_too_simple };
+    unsigned long (*hash_funcs[HASH_TESTS])(const unsigned char *) = {
+        hash_too_simple, hash_fnv1a, hash_wy64, hash_murmur3
+    };
+    const char *hash_names[HASH_TESTS] = { "too_simple", "fnv1a", "wy64", "murmur3" };
 
     for (int i = 0; i < START_TESTS; i++) {
         for (int j = 0; j < MAX_TESTS; j++) {
             for (int k = 0; k < HASH_TESTS; k++) {
-                clock_t start = clock();
+                double start = now_ms();
                 struct table *hash_table =
-                create_from_file(filename, start_sizes[i], max_loads[j], hash_funcs[k]);
-                clock_t end = clock();
+                create_from_file(filename, start_sizes[i], max_loads[j], hash_funcs[k], threads);
+                double end = now_ms();
 
-                printf("Start: %ld\tMax: %.1f\tHash: %d\t -> Time: %ld "
-                       "microsecs\n",
-                       start_sizes[i], max_loads[j], k, end - start);
+                unsigned long max_chain = 0;
+                double stddev = 0;
+                table_chain_spread(hash_table, &max_chain, &stddev);
+                printf("Start: %ld\tMax: %.1f\tHash: %-10s\t -> Time: %.3f "
+                       "ms\tLongest chain: %lu\tChain stddev: %.2f\n",
+                       start_sizes[i], max_loads[j], hash_names[k], end - start,
+                       max_chain, stddev);
                 table_cleanup(hash_table);
             }
         }
@@ -181,21 +313,88 @@ static void timed_construction(char *filename) {
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("usage: %s text_file [-t]\n", argv[0]);
+    int timed = 0;
+    int batch = 0;
+    int load = 0;
+    int stats = 0;
+    int prefix = 0;
+    int dump = 0;
+    char *save_file = NULL;
+    size_t budget = 0;
+    int threads = 1;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-t")) {
+            timed = 1;
+        } else if (!strcmp(argv[i], "-b")) {
+            batch = 1;
+        } else if (!strcmp(argv[i], "-i")) {
+            load = 1;
+        } else if (!strcmp(argv[i], "-s")) {
+            stats = 1;
+        } else if (!strcmp(argv[i], "-p")) {
+            prefix = 1;
+        } else if (!strcmp(argv[i], "-a")) {
+            dump = 1;
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            save_file = argv[++i];
+        } else if (!strcmp(argv[i], "-j") && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc && atol(argv[i + 1]) > 0) {
+            budget = (size_t)atol(argv[++i]) * 1024 * 1024;
+        } else {
+            argc = 0;
+        }
+    }
+    if (argc < 2 || (budget > 0 && (save_file == NULL || load || timed))) {
+        printf("usage: %s text_file [-t] [-b | -p | -a] [-s] [-j threads] [-o index_file]\n"
+               "       %s text_file -m megabytes -o index_file [-b | -p | -a] [-s]\n"
+               "       %s index_file -i [-b | -p | -a] [-s]\n"
+               "  -p: every query is a prefix, print all words that start with it\n"
+               "  -a: print all words with their lines in alphabetical order\n"
+               "  -m: build the index file on disk, with this much memory for the words\n"
+               "  -s: print table statistics, the queries then run on the table as built\n"
+               "      instead of a frozen copy, so its probe counts can be measured\n",
+               argv[0], argv[0], argv[0]);
         return EXIT_FAILURE;
     }
 
-    if (argc == 3 && !strcmp(argv[2], "-t")) {
-        timed_construction(argv[1]);
+    if (timed) {
+        timed_construction(argv[1], threads);
     } else {
-        struct table *hash_table =
-        create_from_file(argv[1], TABLE_START_SIZE, MAX_LOAD_FACTOR, HASH_FUNCTION);
+        struct table *hash_table;
+        if (load) {
+            hash_table = table_load(argv[1], HASH_FUNCTION);
+        } else if (budget > 0) {
+            hash_table = create_external(argv[1], save_file, budget);
+        } else {
+            hash_table = create_from_file(argv[1], TABLE_START_SIZE, MAX_LOAD_FACTOR,
+                                          HASH_FUNCTION, threads);
+        }
         if (hash_table == NULL) {
             printf("An error occured creating the hash table, exiting..\n");
             return EXIT_FAILURE;
         }
-        if (stdin_lookup(hash_table) != 0) {
+        if (stats) {
+            print_stats(load || budget > 0 ? "after loading" : "after building", hash_table);
+            table_count_lookups(hash_table, 1);
+        }
+        /* The index does not change while answering queries, a frozen table
+         * answers them with a single probe. */
+        if (!load && budget == 0 && !stats && table_freeze(hash_table) != 0) {
+            printf("An error occured freezing the hash table, exiting..\n");
+            table_cleanup(hash_table);
+            return EXIT_FAILURE;
+        }
+        if (save_file != NULL && budget == 0 && table_save(hash_table, save_file) != 0) {
+            printf("An error occured saving the index to %s, exiting..\n", save_file);
+            table_cleanup(hash_table);
+            return EXIT_FAILURE;
+        }
+        int failed = answer_queries(hash_table, batch, prefix, dump);
+        if (stats) {
+            print_stats("after the lookups", hash_table);
+        }
+        if (failed) {
             table_cleanup(hash_table);
             return EXIT_FAILURE;
         }
@@ -0,0 +1,302 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file implements an open addressing hash table with linear probing and
+ * Robin Hood displacement. On insert, an entry that is further away from its
+ * home slot than the entry it probes takes that slot, so probe lengths stay
+ * short and a lookup can stop as soon as it meets an entry that is closer to
+ * home than the key would be. Deletion shifts the following entries back
+ * instead of leaving tombstones behind.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "robin_hood.h"
+
+/* Used instead of the requested load factor when that one is too high for
+ * open addressing. */
+#define ROBIN_MAX_LOAD 0.9
+
+struct robin_slot {
+    /* Copy of the key, NULL if the slot is empty */
+    char *key;
+    /* Values stored for this key */
+    struct array *value;
+    /* Full hash of the key, so resizing never needs the hash function */
+    unsigned long hash;
+    /* Distance from the slot the hash maps to */
+    unsigned long dist;
+};
+
+struct robin_table {
+    /* Flat array of slots that is probed linearly */
+    struct robin_slot *slots;
+    /* Maximum load factor after which the slot array is resized */
+    double max_load_factor;
+    /* Number of slots */
+    unsigned long capacity;
+    /* Number of occupied slots */
+    unsigned long load;
+};
+
+/*
+ * Place an entry in the slot array, displacing entries that are closer to
+ * their home slot. The entry must not be present yet and there must be at
+ * least one free slot.
+ */
+static void place_entry(struct robin_slot *slots, unsigned long capacity,
+                        struct robin_slot entry) {
+    unsigned long i = entry.hash % capacity;
+    entry.dist = 0;
+
+    while (slots[i].key != NULL) {
+        if (slots[i].dist < entry.dist) {
+            struct robin_slot tmp = slots[i];
+            slots[i] = entry;
+            entry = tmp;
+        }
+        entry.dist++;
+        i = (i + 1) % capacity;
+    }
+    slots[i] = entry;
+}
+
+/*
+ * Move all entries to a new slot array with new_capacity slots, which must
+ * be larger than the number of entries.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int robin_rebuild(struct robin_table *r, unsigned long new_capacity) {
+    struct robin_slot *new_slots = calloc(new_capacity, sizeof(struct robin_slot));
+    if (new_slots == NULL) {
+        return 1;
+    }
+
+    for (unsigned long i = 0; i < r->capacity; i++) {
+        if (r->slots[i].key != NULL) {
+            place_entry(new_slots, new_capacity, r->slots[i]);
+        }
+    }
+    free(r->slots);
+    r->slots = new_slots;
+    r->capacity = new_capacity;
+
+    return 0;
+}
+
+/*
+ * Resize the slot array to twice its current capacity.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int robin_resize(struct robin_table *r) {
+    return robin_rebuild(r, r->capacity * 2);
+}
+
+/*
+ * Find the slot index of a key.
+ *
+ * Returns the index, or r->capacity if the key is not present.
+ */
+static unsigned long find_index(const struct robin_table *r, const char *key,
+                                unsigned long hash) {
+    unsigned long i = hash % r->capacity;
+
+    for (unsigned long dist = 0; dist < r->capacity; dist++) {
+        const struct robin_slot *slot = &r->slots[i];
+        /* A poorer entry would have taken this slot from us. */
+        if (slot->key == NULL || slot->dist < dist) {
+            break;
+        }
+        if (slot->hash == hash && strcmp(slot->key, key) == 0) {
+            return i;
+        }
+        i = (i + 1) % r->capacity;
+    }
+
+    return r->capacity;
+}
+
+/*
+ * Initialize a Robin Hood table.
+ *
+ * capacity: Initial number of slots.
+ * max_load_factor: Maximum load factor before resizing.
+ *
+ * Returns a pointer to the table, or NULL on failure.
+ */
+struct robin_table *robin_init(unsigned long capacity, double max_load_factor) {
+    if (capacity == 0 || max_load_factor <= 0) {
+        return NULL;
+    }
+
+    struct robin_table *r = malloc(sizeof(struct robin_table));
+    if (r == NULL) {
+        return NULL;
+    }
+
+    r->slots = calloc(capacity, sizeof(struct robin_slot));
+    if (r->slots == NULL) {
+        free(r);
+        return NULL;
+    }
+    r->max_load_factor = max_load_factor < ROBIN_MAX_LOAD ? max_load_factor : ROBIN_MAX_LOAD;
+    r->capacity = capacity;
+    r->load = 0;
+
+    return r;
+}
+
+/*
+ * Look up a key.
+ *
+ * Returns the values stored for the key, or NULL if it is not present.
+ */
+struct array *robin_find(const struct robin_table *r, const char *key,
+                         unsigned long hash) {
+    unsigned long i = find_index(r, key, hash);
+    if (i == r->capacity) {
+        return NULL;
+    }
+    return r->slots[i].value;
+}
+
+/*
+ * Prefetch the home slot of a hash.
+ */
+void robin_prefetch(const struct robin_table *r, unsigned long hash) {
+    __builtin_prefetch(&r->slots[hash % r->capacity]);
+}
+
+/*
+ * Copy and insert a key that is not present yet, resizing first when the
+ * extra entry would exceed the maximum load factor.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int robin_insert(struct robin_table *r, const char *key, unsigned long hash,
+                 struct array *value) {
+    while ((double)(r->load + 1) / (double)r->capacity > r->max_load_factor
+           || r->load + 1 >= r->capacity) {
+        if (robin_resize(r) != 0) {
+            return 1;
+        }
+    }
+
+    struct robin_slot entry;
+    entry.key = malloc(strlen(key) + 1);
+    if (entry.key == NULL) {
+        return 1;
+    }
+    strcpy(entry.key, key);
+    entry.value = value;
+    entry.hash = hash;
+    entry.dist = 0;
+
+    place_entry(r->slots, r->capacity, entry);
+    r->load++;
+
+    return 0;
+}
+
+/*
+ * Remove a key and clean up its values. The entries after it that are not in
+ * their home slot are shifted back by one, which keeps probe sequences
+ * unbroken without tombstones.
+ *
+ * Returns 0 if the key was removed, 1 if it was not present.
+ */
+int robin_remove(struct robin_table *r, const char *key, unsigned long hash) {
+    unsigned long i = find_index(r, key, hash);
+    if (i == r->capacity) {
+        return 1;
+    }
+
+    array_cleanup(r->slots[i].value);
+    free(r->slots[i].key);
+
+    unsigned long next = (i + 1) % r->capacity;
+    while (r->slots[next].key != NULL && r->slots[next].dist > 0) {
+        r->slots[i] = r->slots[next];
+        r->slots[i].dist--;
+        i = next;
+        next = (next + 1) % r->capacity;
+    }
+    r->slots[i].key = NULL;
+    r->slots[i].value = NULL;
+    r->slots[i].dist = 0;
+    r->load--;
+
+    return 0;
+}
+
+/*
+ * Rebuild the table with the fewest slots that keep it within its maximum
+ * load factor, plus one free slot.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int robin_compact(struct robin_table *r) {
+    unsigned long capacity = (unsigned long)((double)r->load / r->max_load_factor) + 1;
+    if (capacity == r->capacity) {
+        return 0;
+    }
+    return robin_rebuild(r, capacity);
+}
+
+/*
+ * Returns the load factor of the table.
+ */
+double robin_load_factor(const struct robin_table *r) {
+    return (double)r->load / (double)r->capacity;
+}
+
+/*
+ * Returns the number of bytes of the table and its slot array.
+ */
+unsigned long robin_memory(const struct robin_table *r) {
+    return (unsigned long)(sizeof(struct robin_table) + r->capacity * sizeof(struct robin_slot));
+}
+
+/*
+ * Call a function for every key in the table.
+ *
+ * Returns 0 if func returned 0 for all keys, otherwise its first non-zero
+ * return value.
+ */
+int robin_foreach(const struct robin_table *r,
+                  int (*func)(void *ctx, const char *key, struct array *value),
+                  void *ctx) {
+    for (unsigned long i = 0; i < r->capacity; i++) {
+        if (r->slots[i].key != NULL) {
+            int res = func(ctx, r->slots[i].key, r->slots[i].value);
+            if (res != 0) {
+                return res;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Clean up the table and free all keys and values.
+ */
+void robin_cleanup(struct robin_table *r) {
+    if (r == NULL) {
+        return;
+    }
+
+    for (unsigned long i = 0; i < r->capacity; i++) {
+        if (r->slots[i].key != NULL) {
+            array_cleanup(r->slots[i].value);
+            free(r->slots[i].key);
+        }
+    }
+    free(r->slots);
+    free(r);
+}
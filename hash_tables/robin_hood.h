@@ -0,0 +1,58 @@
+#ifndef ROBIN_HOOD_H
+#define ROBIN_HOOD_H
+
+/* Open addressing table with Robin Hood displacement, used as a backend for
+ * the hash table in hash_table.c. Keys are copied on insert, values are
+ * owned by the table and cleaned up together with their key.
+ * All functions take the precomputed hash of the key, the table itself
+ * never calls a hash function. */
+
+struct array;
+
+/* Handle to the Robin Hood table. */
+struct robin_table;
+
+/* Initialise a table with the given starting capacity and maximum load
+ * factor. Load factors of 1 or higher are clamped, an open addressing table
+ * always needs at least one free slot. Returns NULL on failure. */
+struct robin_table *robin_init(unsigned long capacity, double max_load_factor);
+
+/* Returns the value stored for key, or NULL if the key is not present. */
+struct array *robin_find(const struct robin_table *r, const char *key,
+                         unsigned long hash);
+
+/* Prefetches the slot where the probe sequence of hash starts, for a
+ * robin_find of it shortly after. */
+void robin_prefetch(const struct robin_table *r, unsigned long hash);
+
+/* Copies and inserts a key that is not yet present, together with its value.
+ * The table takes ownership of value. Returns 0 on success, 1 otherwise. */
+int robin_insert(struct robin_table *r, const char *key, unsigned long hash,
+                 struct array *value);
+
+/* Removes key and cleans up its value using backward shift deletion.
+ * Returns 0 if the key was removed and 1 if it was not present. */
+int robin_remove(struct robin_table *r, const char *key, unsigned long hash);
+
+/* Calls func for every key with its value, in slot order, until func returns
+ * non-zero. Returns 0 or the non-zero return value of func. */
+int robin_foreach(const struct robin_table *r,
+                  int (*func)(void *ctx, const char *key, struct array *value),
+                  void *ctx);
+
+/* Rebuilds the table with the fewest slots that hold its keys within the
+ * maximum load factor. Returns 0 on success, 1 on failure, in which case the
+ * table is unchanged. */
+int robin_compact(struct robin_table *r);
+
+/* Returns the number of keys stored / the number of slots. */
+double robin_load_factor(const struct robin_table *r);
+
+/* Returns the number of bytes of the table and its slots, without the keys
+ * and values. */
+unsigned long robin_memory(const struct robin_table *r);
+
+/* Cleans up the table together with all keys and values. */
+void robin_cleanup(struct robin_table *r);
+
+#endif /* ROBIN_HOOD_H */
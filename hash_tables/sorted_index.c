@@ -0,0 +1,240 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file implements an ordered index over the keys of a hash table: an
+ * array of entries sorted once when the index is built, searched with binary
+ * search. Every entry keeps the first 8 bytes of its key as a big endian
+ * integer next to the key pointer. Comparing those decides almost every step
+ * of the sort and of a search without following the pointer, and only keys
+ * with the same first 8 bytes are compared with strcmp. Tables loaded from
+ * an index file keep the order of their keys in the file, table_save sorted
+ * them once. The index then uses that order in place: building it sorts and
+ * copies nothing, and a search only reads the keys it compares.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorted_index.h"
+
+struct sorted_entry {
+    /* First 8 bytes of the key, big endian and padded with zero bytes */
+    uint64_t head;
+    const char *key;
+    struct array *values;
+};
+
+struct sorted_index {
+    /* Sorted entries, NULL if the keys are in the order stored with table */
+    struct sorted_entry *entries;
+    /* Table whose stored order is used, NULL if there are entries */
+    const struct table *table;
+    unsigned long n;
+    /* Entries filled in while building */
+    unsigned long used;
+};
+
+/* Return the first 8 bytes of a key as a big endian integer, so comparing
+ * heads orders keys like strcmp does. */
+static uint64_t key_head(const char *key) {
+    uint64_t head = 0;
+    for (int i = 0; i < 8; i++) {
+        head <<= 8;
+        if (*key != '\0') {
+            head |= (unsigned char)*key++;
+        }
+    }
+    return head;
+}
+
+/* Compare an entry with a key and its head, like strcmp. */
+static int compare_key(const struct sorted_entry *e, const char *key, uint64_t head) {
+    if (e->head != head) {
+        return e->head < head ? -1 : 1;
+    }
+    return strcmp(e->key, key);
+}
+
+/* Compare two entries for qsort. */
+static int compare_entries(const void *a, const void *b) {
+    const struct sorted_entry *y = b;
+    return compare_key(a, y->key, y->head);
+}
+
+/* Count a key of the table, to size the entry array. */
+static int count_entry(void *ctx, const char *key, struct array *values) {
+    (void)key;
+    (void)values;
+    (*(unsigned long *)ctx)++;
+    return 0;
+}
+
+/* Add a key of the table to the index. */
+static int add_entry(void *ctx, const char *key, struct array *values) {
+    struct sorted_index *s = ctx;
+    if (s->used == s->n) {
+        return 1;
+    }
+    s->entries[s->used].head = key_head(key);
+    s->entries[s->used].key = key;
+    s->entries[s->used].values = values;
+    s->used++;
+    return 0;
+}
+
+/*
+ * Get the key and values at a position of the index.
+ *
+ * Returns 0 on success, 1 if the key is damaged in the file of the table.
+ */
+static int entry_at(const struct sorted_index *s, unsigned long i, const char **key,
+                    struct array **values) {
+    if (s->entries == NULL) {
+        return table_sorted_key(s->table, i, key, values);
+    }
+    *key = s->entries[i].key;
+    *values = s->entries[i].values;
+    return 0;
+}
+
+/*
+ * Compare the key at a position of the index with key, like strcmp. A
+ * damaged key of a file counts as smaller than any key.
+ */
+static int compare_at(const struct sorted_index *s, unsigned long i, const char *key,
+                      uint64_t head) {
+    if (s->entries != NULL) {
+        return compare_key(&s->entries[i], key, head);
+    }
+    const char *stored;
+    struct array *values;
+    return entry_at(s, i, &stored, &values) != 0 ? -1 : strcmp(stored, key);
+}
+
+/*
+ * Return the index of the first entry that is not smaller than key.
+ */
+static unsigned long lower_bound(const struct sorted_index *s, const char *key) {
+    uint64_t head = key_head(key);
+    unsigned long lo = 0;
+    unsigned long hi = s->n;
+    while (lo < hi) {
+        unsigned long mid = lo + (hi - lo) / 2;
+        if (compare_at(s, mid, key, head) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * Build the sorted index of the keys of a table, or use the order the table
+ * stores.
+ *
+ * t: The table, which must not change while the index is used.
+ *
+ * Returns a pointer to the index, or NULL on failure.
+ */
+struct sorted_index *sorted_index_build(const struct table *t) {
+    if (t == NULL) {
+        return NULL;
+    }
+    struct sorted_index *s = malloc(sizeof(struct sorted_index));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->entries = NULL;
+    s->table = t;
+    if (table_key_order(t, &s->n)) {
+        return s;
+    }
+
+    unsigned long n = 0;
+    if (table_foreach(t, count_entry, &n) != 0) {
+        free(s);
+        return NULL;
+    }
+    s->entries = malloc((n > 0 ? n : 1) * sizeof(struct sorted_entry));
+    s->table = NULL;
+    s->n = n;
+    s->used = 0;
+    if (s->entries == NULL || table_foreach(t, add_entry, s) != 0 || s->used != n) {
+        sorted_index_cleanup(s);
+        return NULL;
+    }
+
+    qsort(s->entries, n, sizeof(struct sorted_entry), compare_entries);
+    return s;
+}
+
+/*
+ * Returns the number of keys in the index.
+ */
+unsigned long sorted_index_size(const struct sorted_index *s) {
+    return s->n;
+}
+
+/*
+ * Visit all keys that start with a prefix, which follow each other in the
+ * sorted array from the first key that is not smaller than the prefix.
+ *
+ * Returns 0 or the first non-zero return value of func.
+ */
+int sorted_index_prefix(const struct sorted_index *s, const char *prefix,
+                        table_visit_func func, void *ctx) {
+    size_t len = strlen(prefix);
+    for (unsigned long i = lower_bound(s, prefix); i < s->n; i++) {
+        const char *key;
+        struct array *values;
+        if (entry_at(s, i, &key, &values) != 0) {
+            continue;
+        }
+        if (strncmp(key, prefix, len) != 0) {
+            break;
+        }
+        int res = func(ctx, key, values);
+        if (res != 0) {
+            return res;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Visit all keys from first up to last, where NULL means an open end.
+ *
+ * Returns 0 or the first non-zero return value of func.
+ */
+int sorted_index_range(const struct sorted_index *s, const char *first, const char *last,
+                       table_visit_func func, void *ctx) {
+    unsigned long start = first != NULL ? lower_bound(s, first) : 0;
+    unsigned long end = last != NULL ? lower_bound(s, last) : s->n;
+    for (unsigned long i = start; i < end; i++) {
+        const char *key;
+        struct array *values;
+        if (entry_at(s, i, &key, &values) != 0) {
+            continue;
+        }
+        int res = func(ctx, key, values);
+        if (res != 0) {
+            return res;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Free the index.
+ */
+void sorted_index_cleanup(struct sorted_index *s) {
+    if (s == NULL) {
+        return;
+    }
+    free(s->entries);
+    free(s);
+}
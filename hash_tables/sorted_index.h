@@ -0,0 +1,42 @@
+#ifndef SORTED_INDEX_H
+#define SORTED_INDEX_H
+
+/* Ordered secondary index over the keys of a hash table, for the queries a
+ * hash table can not answer without a full scan: all keys with a prefix, all
+ * keys in a range and all keys in alphabetical order. The index is a sorted
+ * array that points to the keys and values inside the table, so it must not
+ * outlive the table and has to be rebuilt after the table changes. Read-only
+ * tables, frozen or loaded from a file, never change. For a table loaded
+ * from a file the index uses the order table_save stored in it, so nothing
+ * is sorted at query time. */
+
+#include "hash_table_ext.h"
+
+/* Handle to the index. */
+struct sorted_index;
+
+/* Build the index of all keys of t, in strcmp order, or take the stored
+ * order of a table loaded from a file. Keys whose record in the file is
+ * damaged are skipped by the queries. Returns NULL on failure. */
+struct sorted_index *sorted_index_build(const struct table *t);
+
+/* Returns the number of keys in the index. */
+unsigned long sorted_index_size(const struct sorted_index *s);
+
+/* Call func for every key that starts with prefix, in order, until func
+ * returns non-zero. The empty prefix visits all keys. Returns 0 or the
+ * non-zero return value of func. */
+int sorted_index_prefix(const struct sorted_index *s, const char *prefix,
+                        table_visit_func func, void *ctx);
+
+/* Call func for every key from first up to but not including last, in
+ * order, until func returns non-zero. first NULL starts at the first key and
+ * last NULL ends after the last key. Returns 0 or the non-zero return value
+ * of func. */
+int sorted_index_range(const struct sorted_index *s, const char *first, const char *last,
+                       table_visit_func func, void *ctx);
+
+/* Free the index, the table is not changed. */
+void sorted_index_cleanup(struct sorted_index *s);
+
+#endif /* SORTED_INDEX_H */
@@ -0,0 +1,413 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file implements an open addressing hash table in the style of the
+ * SwissTable design (https://abseil.io/about/design/swisstables). The slots
+ * are split in groups of 16. For every slot a control byte stores whether it
+ * is empty or deleted, or otherwise the low 7 bits of the hash. A lookup
+ * compares the tag with all 16 control bytes of a group at once using SSE2,
+ * and only calls strcmp on slots whose tag matches. Probing stops at the first
+ * group that still has an empty slot.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "array.h"
+#include "swiss_table.h"
+
+#define GROUP_SIZE 16
+
+/* Control byte values. Full slots store a tag in 0..127, so the high bit is
+ * only set for empty and deleted slots. */
+#define CTRL_EMPTY ((signed char) -128)
+#define CTRL_DELETED ((signed char) -2)
+
+/* Maximum load factor, counting deleted slots as used. */
+#define SWISS_MAX_LOAD 0.875
+
+struct swiss_slot {
+    /* Copy of the key, only valid if the control byte is a tag */
+    char *key;
+    /* Values stored for this key */
+    struct array *value;
+    /* Full hash of the key, so resizing never needs the hash function */
+    unsigned long hash;
+};
+
+struct swiss_table {
+    /* One control byte per slot */
+    signed char *ctrl;
+    /* The slots themselves, only touched after a tag match */
+    struct swiss_slot *slots;
+    /* Maximum load factor after which the table is rebuilt */
+    double max_load_factor;
+    /* Number of groups, always a power of two */
+    unsigned long groups;
+    /* Number of full slots */
+    unsigned long load;
+    /* Number of deleted slots, these still lengthen probe sequences */
+    unsigned long deleted;
+};
+
+/* Spread the bits of a hash, so weak hash functions still use all groups
+ * and tags. Multiplier from Fibonacci hashing. */
+static unsigned long mix_hash(unsigned long hash) {
+    hash *= 0x9e3779b97f4a7c15UL;
+    return hash ^ (hash >> 32);
+}
+
+/* The 7 bit tag stored in the control byte. */
+static signed char hash_tag(unsigned long mixed) {
+    return (signed char) (mixed & 0x7f);
+}
+
+/* The group at which probing starts. */
+static unsigned long hash_group(unsigned long mixed, unsigned long groups) {
+    return (mixed >> 7) & (groups - 1);
+}
+
+/* Return a bitmask with bit i set if control byte i of the group equals c. */
+static unsigned int group_match(const signed char *group, signed char c) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+    return (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(c)));
+#else
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i < GROUP_SIZE; i++) {
+        if (group[i] == c) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+/* Return a bitmask with bit i set if slot i of the group is empty or
+ * deleted, which are exactly the control bytes with the high bit set. */
+static unsigned int group_match_free(const signed char *group) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+    return (unsigned int) _mm_movemask_epi8(ctrl);
+#else
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i < GROUP_SIZE; i++) {
+        if (group[i] < 0) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+/* Return the index of the lowest set bit, mask may not be 0. */
+static unsigned int lowest_bit(unsigned int mask) {
+    return (unsigned int) __builtin_ctz(mask);
+}
+
+/*
+ * Find the slot index of a key.
+ *
+ * Returns the index, or the total number of slots if the key is not present.
+ */
+static unsigned long find_index(const struct swiss_table *s, const char *key,
+                                unsigned long hash) {
+    unsigned long mixed = mix_hash(hash);
+    signed char tag = hash_tag(mixed);
+    unsigned long g = hash_group(mixed, s->groups);
+
+    /* Triangular probing visits every group once for power of two sizes. */
+    for (unsigned long step = 1; step <= s->groups; step++) {
+        const signed char *group = s->ctrl + g * GROUP_SIZE;
+
+        for (unsigned int mask = group_match(group, tag); mask != 0; mask &= mask - 1) {
+            unsigned long i = g * GROUP_SIZE + lowest_bit(mask);
+            if (s->slots[i].hash == hash && strcmp(s->slots[i].key, key) == 0) {
+                return i;
+            }
+        }
+        if (group_match(group, CTRL_EMPTY) != 0) {
+            break;
+        }
+        g = (g + step) & (s->groups - 1);
+    }
+
+    return s->groups * GROUP_SIZE;
+}
+
+/*
+ * Put an entry in the first free slot of its probe sequence. The entry must
+ * not be present and the table must have a free slot.
+ *
+ * Returns 1 if the used slot was empty, 0 if it was a deleted slot.
+ */
+static int place_entry(struct swiss_table *s, struct swiss_slot entry) {
+    unsigned long mixed = mix_hash(entry.hash);
+    unsigned long g = hash_group(mixed, s->groups);
+
+    for (unsigned long step = 1;; step++) {
+        unsigned int mask = group_match_free(s->ctrl + g * GROUP_SIZE);
+        if (mask != 0) {
+            unsigned long i = g * GROUP_SIZE + lowest_bit(mask);
+            int was_empty = s->ctrl[i] == CTRL_EMPTY;
+            s->ctrl[i] = hash_tag(mixed);
+            s->slots[i] = entry;
+            return was_empty;
+        }
+        g = (g + step) & (s->groups - 1);
+    }
+}
+
+/*
+ * Allocate empty control and slot arrays for the given number of groups.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int alloc_groups(struct swiss_table *s, unsigned long groups) {
+    s->ctrl = malloc(groups * GROUP_SIZE);
+    s->slots = malloc(groups * GROUP_SIZE * sizeof(struct swiss_slot));
+    if (s->ctrl == NULL || s->slots == NULL) {
+        free(s->ctrl);
+        free(s->slots);
+        return 1;
+    }
+    memset(s->ctrl, CTRL_EMPTY, groups * GROUP_SIZE);
+    s->groups = groups;
+    return 0;
+}
+
+/*
+ * Rebuild the table with new_groups groups, which also drops all deleted
+ * slots.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int swiss_rebuild(struct swiss_table *s, unsigned long new_groups) {
+    signed char *old_ctrl = s->ctrl;
+    struct swiss_slot *old_slots = s->slots;
+    unsigned long old_groups = s->groups;
+
+    if (alloc_groups(s, new_groups) != 0) {
+        s->ctrl = old_ctrl;
+        s->slots = old_slots;
+        return 1;
+    }
+
+    for (unsigned long i = 0; i < old_groups * GROUP_SIZE; i++) {
+        if (old_ctrl[i] >= 0) {
+            place_entry(s, old_slots[i]);
+        }
+    }
+    s->deleted = 0;
+    free(old_ctrl);
+    free(old_slots);
+
+    return 0;
+}
+
+/*
+ * Rebuild the table to make room for an insert. The size is only doubled if
+ * the table is actually full of keys, not of deleted slots.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int swiss_rehash(struct swiss_table *s) {
+    unsigned long new_groups = s->groups;
+    if ((double)(s->load + 1) > s->max_load_factor * (double)(s->groups * GROUP_SIZE) / 2) {
+        new_groups *= 2;
+    }
+    return swiss_rebuild(s, new_groups);
+}
+
+/*
+ * Initialize a group probing table.
+ *
+ * capacity: Minimum initial number of slots.
+ * max_load_factor: Maximum load factor before rebuilding.
+ *
+ * Returns a pointer to the table, or NULL on failure.
+ */
+struct swiss_table *swiss_init(unsigned long capacity, double max_load_factor) {
+    if (capacity == 0 || max_load_factor <= 0) {
+        return NULL;
+    }
+
+    struct swiss_table *s = malloc(sizeof(struct swiss_table));
+    if (s == NULL) {
+        return NULL;
+    }
+
+    unsigned long groups = 1;
+    while (groups * GROUP_SIZE < capacity) {
+        groups *= 2;
+    }
+    if (alloc_groups(s, groups) != 0) {
+        free(s);
+        return NULL;
+    }
+    s->max_load_factor = max_load_factor < SWISS_MAX_LOAD ? max_load_factor : SWISS_MAX_LOAD;
+    s->load = 0;
+    s->deleted = 0;
+
+    return s;
+}
+
+/*
+ * Look up a key.
+ *
+ * Returns the values stored for the key, or NULL if it is not present.
+ */
+struct array *swiss_find(const struct swiss_table *s, const char *key,
+                         unsigned long hash) {
+    unsigned long i = find_index(s, key, hash);
+    if (i == s->groups * GROUP_SIZE) {
+        return NULL;
+    }
+    return s->slots[i].value;
+}
+
+/*
+ * Prefetch the first group of the probe sequence of a hash. A tag match
+ * usually lands in that group, so its slots are fetched too.
+ */
+void swiss_prefetch(const struct swiss_table *s, unsigned long hash) {
+    unsigned long g = hash_group(mix_hash(hash), s->groups);
+    __builtin_prefetch(s->ctrl + g * GROUP_SIZE);
+    __builtin_prefetch(&s->slots[g * GROUP_SIZE]);
+}
+
+/*
+ * Copy and insert a key that is not present yet, rebuilding the table first
+ * when the extra entry would exceed the maximum load factor.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int swiss_insert(struct swiss_table *s, const char *key, unsigned long hash,
+                 struct array *value) {
+    unsigned long used = s->load + s->deleted + 1;
+    if ((double) used > s->max_load_factor * (double)(s->groups * GROUP_SIZE)) {
+        if (swiss_rehash(s) != 0) {
+            return 1;
+        }
+    }
+
+    struct swiss_slot entry;
+    entry.key = malloc(strlen(key) + 1);
+    if (entry.key == NULL) {
+        return 1;
+    }
+    strcpy(entry.key, key);
+    entry.value = value;
+    entry.hash = hash;
+
+    if (!place_entry(s, entry)) {
+        s->deleted--;
+    }
+    s->load++;
+
+    return 0;
+}
+
+/*
+ * Remove a key and clean up its values. If the group of the slot still has
+ * an empty slot no probe sequence continues past this group, so the slot can
+ * be marked empty again instead of deleted.
+ *
+ * Returns 0 if the key was removed, 1 if it was not present.
+ */
+int swiss_remove(struct swiss_table *s, const char *key, unsigned long hash) {
+    unsigned long i = find_index(s, key, hash);
+    if (i == s->groups * GROUP_SIZE) {
+        return 1;
+    }
+
+    array_cleanup(s->slots[i].value);
+    free(s->slots[i].key);
+
+    if (group_match(s->ctrl + (i / GROUP_SIZE) * GROUP_SIZE, CTRL_EMPTY) != 0) {
+        s->ctrl[i] = CTRL_EMPTY;
+    } else {
+        s->ctrl[i] = CTRL_DELETED;
+        s->deleted++;
+    }
+    s->load--;
+
+    return 0;
+}
+
+/*
+ * Call a function for every key in the table.
+ *
+ * Returns 0 if func returned 0 for all keys, otherwise its first non-zero
+ * return value.
+ */
+int swiss_foreach(const struct swiss_table *s,
+                  int (*func)(void *ctx, const char *key, struct array *value),
+                  void *ctx) {
+    for (unsigned long i = 0; i < s->groups * GROUP_SIZE; i++) {
+        if (s->ctrl[i] >= 0) {
+            int res = func(ctx, s->slots[i].key, s->slots[i].value);
+            if (res != 0) {
+                return res;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Returns the load factor of the table.
+ */
+double swiss_load_factor(const struct swiss_table *s) {
+    return (double)s->load / (double)(s->groups * GROUP_SIZE);
+}
+
+/*
+ * Rebuild the table with the fewest groups that hold its keys within the
+ * maximum load factor, without deleted slots.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int swiss_compact(struct swiss_table *s) {
+    unsigned long groups = 1;
+    while ((double)s->load > s->max_load_factor * (double)(groups * GROUP_SIZE)) {
+        groups *= 2;
+    }
+    if (groups == s->groups && s->deleted == 0) {
+        return 0;
+    }
+    return swiss_rebuild(s, groups);
+}
+
+/*
+ * Returns the number of bytes of the table, its control bytes and slots.
+ */
+unsigned long swiss_memory(const struct swiss_table *s) {
+    return (unsigned long)(sizeof(struct swiss_table)
+                           + s->groups * GROUP_SIZE * (1 + sizeof(struct swiss_slot)));
+}
+
+/*
+ * Clean up the table and free all keys and values.
+ */
+void swiss_cleanup(struct swiss_table *s) {
+    if (s == NULL) {
+        return;
+    }
+
+    for (unsigned long i = 0; i < s->groups * GROUP_SIZE; i++) {
+        if (s->ctrl[i] >= 0) {
+            array_cleanup(s->slots[i].value);
+            free(s->slots[i].key);
+        }
+    }
+    free(s->ctrl);
+    free(s->slots);
+    free(s);
+}
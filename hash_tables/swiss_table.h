@@ -0,0 +1,58 @@
+#ifndef SWISS_TABLE_H
+#define SWISS_TABLE_H
+
+/* Open addressing table that keeps a 7 bit tag of every hash in a separate
+ * control byte array and probes groups of 16 slots at a time, used as a
+ * backend for the hash table in hash_table.c. Keys are only compared when
+ * their tag matches. The interface mirrors robin_hood.h: keys are copied on
+ * insert, values are owned by the table and all functions take the
+ * precomputed hash of the key. */
+
+struct array;
+
+/* Handle to the group probing table. */
+struct swiss_table;
+
+/* Initialise a table with room for at least capacity slots and the given
+ * maximum load factor, which is clamped to 7/8. Returns NULL on failure. */
+struct swiss_table *swiss_init(unsigned long capacity, double max_load_factor);
+
+/* Returns the value stored for key, or NULL if the key is not present. */
+struct array *swiss_find(const struct swiss_table *s, const char *key,
+                         unsigned long hash);
+
+/* Prefetches the control bytes and slots of the first group probed for
+ * hash, for a swiss_find of it shortly after. */
+void swiss_prefetch(const struct swiss_table *s, unsigned long hash);
+
+/* Copies and inserts a key that is not yet present, together with its value.
+ * The table takes ownership of value. Returns 0 on success, 1 otherwise. */
+int swiss_insert(struct swiss_table *s, const char *key, unsigned long hash,
+                 struct array *value);
+
+/* Removes key and cleans up its value.
+ * Returns 0 if the key was removed and 1 if it was not present. */
+int swiss_remove(struct swiss_table *s, const char *key, unsigned long hash);
+
+/* Calls func for every key with its value, in slot order, until func returns
+ * non-zero. Returns 0 or the non-zero return value of func. */
+int swiss_foreach(const struct swiss_table *s,
+                  int (*func)(void *ctx, const char *key, struct array *value),
+                  void *ctx);
+
+/* Rebuilds the table with the fewest groups that hold its keys within the
+ * maximum load factor, dropping all deleted slots. Returns 0 on success, 1 on
+ * failure, in which case the table is unchanged. */
+int swiss_compact(struct swiss_table *s);
+
+/* Returns the number of keys stored / the number of slots. */
+double swiss_load_factor(const struct swiss_table *s);
+
+/* Returns the number of bytes of the table, its control bytes and its slots,
+ * without the keys and values. */
+unsigned long swiss_memory(const struct swiss_table *s);
+
+/* Cleans up the table together with all keys and values. */
+void swiss_cleanup(struct swiss_table *s);
+
+#endif /* SWISS_TABLE_H */
@@ -0,0 +1,253 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file splits text into lowercased words for the word index. Input files
+ * are mapped into memory instead of read line by line, so lines of any length
+ * are handled and the text is never copied as a whole. The text is classified
+ * in blocks of 64 bytes with SIMD compares, which lowercase the letters and
+ * produce bitmasks of the letter and newline positions that the tokenizer
+ * walks to find the words.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "tokenize.h"
+
+/* Initial size of the buffer a word is lowercased into, it grows as needed. */
+#define WORD_BUFFER_SIZE 64
+
+/*
+ * Map a file into memory, read-only.
+ *
+ * filename: The file to map.
+ * f: Set to the mapping.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+int map_file(const char *filename, struct mapped_file *f) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    f->data = NULL;
+    f->size = (size_t)st.st_size;
+    if (f->size > 0) {
+        void *data = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return 1;
+        }
+        posix_madvise(data, f->size, POSIX_MADV_SEQUENTIAL);
+        f->data = data;
+    }
+    /* The mapping stays valid after closing the file. */
+    close(fd);
+
+    return 0;
+}
+
+/*
+ * Unmap a file mapped with map_file.
+ */
+void unmap_file(struct mapped_file *f) {
+    if (f->data != NULL) {
+        munmap((void *)(uintptr_t)f->data, f->size);
+    }
+    f->data = NULL;
+    f->size = 0;
+}
+
+/*
+ * Classify up to 64 bytes in one pass: lowercase the ASCII letters, replace
+ * every other byte by a space and record which bytes were letters and which
+ * were newlines. Uses AVX2 or SSE2 when the compiler targets them, with a
+ * scalar loop for the tail. Letters are exactly the bytes that fall in 'a'..'z'
+ * after setting bit 0x20; the signed compares of SSE2 treat bytes of 0x80
+ * and up as negative, so those never count as letters.
+ *
+ * src: The bytes to classify.
+ * dst: Receives the folded bytes, may be equal to src.
+ * n: Number of bytes, at most 64.
+ * newlines: If not NULL, set to the mask of newline positions.
+ *
+ * Returns a mask with bit i set if byte i is a letter.
+ */
+uint64_t fold_letters(const unsigned char *src, unsigned char *dst, size_t n,
+                      uint64_t *newlines) {
+    uint64_t letters = 0;
+    uint64_t nl = 0;
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i before_a = _mm256_set1_epi8('a' - 1);
+    const __m256i after_z = _mm256_set1_epi8('z' + 1);
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; i + 32 <= n; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i lower = _mm256_or_si256(bytes, case_bit);
+        __m256i is_letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, before_a),
+                                             _mm256_cmpgt_epi8(after_z, lower));
+        __m256i folded = _mm256_blendv_epi8(space, lower, is_letter);
+        _mm256_storeu_si256((__m256i *)(dst + i), folded);
+        letters |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_letter) << i;
+        nl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)) << i;
+    }
+#elif defined(__SSE2__)
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i before_a = _mm_set1_epi8('a' - 1);
+    const __m128i after_z = _mm_set1_epi8('z' + 1);
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lower = _mm_or_si128(bytes, case_bit);
+        __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(lower, before_a),
+                                          _mm_cmpgt_epi8(after_z, lower));
+        __m128i folded = _mm_or_si128(_mm_and_si128(is_letter, lower),
+                                      _mm_andnot_si128(is_letter, space));
+        _mm_storeu_si128((__m128i *)(dst + i), folded);
+        letters |= (uint64_t)_mm_movemask_epi8(is_letter) << i;
+        nl |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)) << i;
+    }
+#endif
+
+    for (; i < n; i++) {
+        unsigned char lower = src[i] | 0x20;
+        if (src[i] == '\n') {
+            nl |= (uint64_t)1 << i;
+        }
+        if (lower >= 'a' && lower <= 'z') {
+            dst[i] = lower;
+            letters |= (uint64_t)1 << i;
+        } else {
+            dst[i] = ' ';
+        }
+    }
+
+    if (newlines != NULL) {
+        *newlines = nl;
+    }
+    return letters;
+}
+
+/* Return a mask of the bits from position pos upwards. */
+static uint64_t bits_from(size_t pos) {
+    return pos >= 64 ? 0 : ~(uint64_t)0 << pos;
+}
+
+/*
+ * Append folded letters to the word buffer, growing it when needed.
+ *
+ * Returns 0 on success, 1 on failure.
+ */
+static int word_append(char **word, size_t *len, size_t *capacity,
+                       const unsigned char *letters, size_t n) {
+    while (*len + n + 1 > *capacity) {
+        char *bigger = realloc(*word, *capacity * 2);
+        if (bigger == NULL) {
+            return 1;
+        }
+        *word = bigger;
+        *capacity *= 2;
+    }
+    memcpy(*word + *len, letters, n);
+    *len += n;
+    return 0;
+}
+
+/*
+ * Split text into words and pass them to func one by one. The text is
+ * classified 64 bytes at a time with fold_letters, after which the words are
+ * found as runs of set bits in the letter mask and lines are counted with the
+ * newline mask.
+ *
+ * text: The text to split, does not need to be NUL terminated.
+ * size: Number of bytes of text.
+ * first_line: Line number of the first line of text.
+ * func: Called for every word.
+ * ctx: Passed to func.
+ *
+ * Returns 0 on success, the return value of func if it was not 0, or -1 on
+ * allocation failure.
+ */
+int tokenize(const unsigned char *text, size_t size, unsigned long first_line,
+             word_func func, void *ctx) {
+    size_t capacity = WORD_BUFFER_SIZE;
+    char *word = malloc(capacity);
+    if (word == NULL) {
+        return -1;
+    }
+
+    unsigned char folded[64];
+    unsigned long line_number = first_line;
+    size_t len = 0;
+    int res = 0;
+
+    for (size_t block = 0; block < size && res == 0; block += 64) {
+        size_t n = size - block < 64 ? size - block : 64;
+        uint64_t newlines;
+        uint64_t letters = fold_letters(text + block, folded, n, &newlines);
+        size_t pos = 0;
+
+        while (pos < n && res == 0) {
+            if (len == 0) {
+                /* Skip to the next word, counting the lines on the way. */
+                uint64_t ahead = letters & bits_from(pos);
+                size_t start = ahead ? (size_t)__builtin_ctzll(ahead) : n;
+                line_number += (unsigned long)__builtin_popcountll(newlines & bits_from(pos)
+                                                                   & ~bits_from(start));
+                pos = start;
+                if (pos == n) {
+                    break;
+                }
+            }
+
+            /* Take the run of letters from pos, the word may continue in
+             * the next block. */
+            uint64_t gaps = ~letters & bits_from(pos);
+            size_t end = gaps ? (size_t)__builtin_ctzll(gaps) : 64;
+            if (end > n) {
+                end = n;
+            }
+            if (word_append(&word, &len, &capacity, folded + pos, end - pos) != 0) {
+                free(word);
+                return -1;
+            }
+            pos = end;
+
+            if (pos < n || block + n == size) {
+                word[len] = '\0';
+                res = func(ctx, word, len, line_number);
+                len = 0;
+            }
+        }
+    }
+
+    free(word);
+    return res;
+}
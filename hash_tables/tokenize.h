@@ -0,0 +1,44 @@
+#ifndef TOKENIZE_H
+#define TOKENIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Splitting text files into words for the word index. A word is a maximal
+ * run of ASCII letters, words are lowercased and every other byte is a
+ * delimiter. Lines are counted from 1 and end at a newline. */
+
+/* A file mapped read-only into memory. */
+struct mapped_file {
+    const unsigned char *data;
+    size_t size;
+};
+
+/* Map the file at filename into memory. Returns 0 on success and 1 on
+ * failure. An empty file gives data NULL and size 0. */
+int map_file(const char *filename, struct mapped_file *f);
+
+/* Unmap a file mapped by map_file. */
+void unmap_file(struct mapped_file *f);
+
+/* Lowercase the ASCII letters among the first n bytes of src, with n at most
+ * 64, and write them to dst with every other byte replaced by a space. dst may
+ * be equal to src. Returns a mask with bit i set if byte i is a letter, and
+ * stores the mask of newlines in newlines unless it is NULL. */
+uint64_t fold_letters(const unsigned char *src, unsigned char *dst, size_t n,
+                      uint64_t *newlines);
+
+/* Called for every word with the lowercased, NUL terminated word, its length
+ * and its line number. The word is only valid during the call. A non-zero
+ * return value stops the tokenizer. */
+typedef int (*word_func)(void *ctx, const char *word, size_t len,
+                         unsigned long line_number);
+
+/* Split size bytes of text into words and call func for each of them, with
+ * the first line of text numbered first_line. Returns 0 if all words were
+ * handled, the non-zero return value of func if it stopped early, and -1 on
+ * allocation failure. */
+int tokenize(const unsigned char *text, size_t size, unsigned long first_line,
+             word_func func, void *ctx);
+
+#endif /* TOKENIZE_H */
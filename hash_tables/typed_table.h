@@ -0,0 +1,304 @@
+#ifndef TYPED_TABLE_H
+#define TYPED_TABLE_H
+
+/* Hash tables specialised at compile time for one key type, for keys that
+ * are no strings such as numeric ids. Like the string table every key maps
+ * to a resizing integer array of values, but the hash and equality of the
+ * key type are plain functions that the compiler inlines into every probe,
+ * instead of a call through hash_func followed by strcmp. Keys are stored
+ * by value in the slots, so nothing is allocated per key besides its array.
+ *
+ * TYPED_TABLE_DECLARE(name, key_type) declares the handle struct name and
+ * its functions, for a header:
+ *
+ *   struct name *name_init(unsigned long capacity, double max_load_factor);
+ *   int name_insert(struct name *t, key_type key, int value);
+ *   struct array *name_lookup(const struct name *t, key_type key);
+ *   int name_delete(struct name *t, key_type key);
+ *   int name_foreach(const struct name *t,
+ *                    int (*func)(void *ctx, key_type key, struct array *values),
+ *                    void *ctx);
+ *   unsigned long name_size(const struct name *t);
+ *   double name_load_factor(const struct name *t);
+ *   void name_cleanup(struct name *t);
+ *
+ * which behave like table_init, table_insert, table_lookup, table_delete,
+ * table_foreach and so on. TYPED_TABLE_DEFINE(name, key_type, hash, equal)
+ * defines them in one source file, with hash a function or macro that takes
+ * a key and returns a well mixed uint64_t and equal one that takes two keys
+ * and returns non-zero if they are equal. The tables use open addressing
+ * with Robin Hood displacement, like robin_hood.c, over a power of two
+ * number of slots. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+
+/* Used instead of the requested load factor when that one is too high for
+ * open addressing. */
+#define TYPED_MAX_LOAD 0.9
+
+/* Finalizer of MurmurHash3, mixes all bits of x into all bits. */
+static inline uint64_t typed_mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64_t typed_hash_u32(uint32_t key) {
+    return typed_mix64(key);
+}
+
+static inline uint64_t typed_hash_u64(uint64_t key) {
+    return typed_mix64(key);
+}
+
+static inline int typed_equal_int(uint64_t a, uint64_t b) {
+    return a == b;
+}
+
+/* Hash of n bytes, read 8 at a time. With n a constant the loop is unrolled
+ * and the reads become plain loads. */
+static inline uint64_t typed_hash_bytes(const unsigned char *bytes, size_t n) {
+    uint64_t h = n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        h = typed_mix64(h ^ word) + i;
+    }
+    if (i < n) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, n - i);
+        h = typed_mix64(h ^ word);
+    }
+    return typed_mix64(h);
+}
+
+/* Declare struct name, a key type of n bytes with the field bytes, together
+ * with its hash and equality for TYPED_TABLE_DEFINE, name_hash and
+ * name_equal. */
+#define TYPED_BYTES_KEY(name, n)                                                    \
+    struct name {                                                                   \
+        unsigned char bytes[n];                                                     \
+    };                                                                              \
+    static inline uint64_t name##_hash(struct name key) {                           \
+        return typed_hash_bytes(key.bytes, n);                                      \
+    }                                                                               \
+    static inline int name##_equal(struct name a, struct name b) {                  \
+        return memcmp(a.bytes, b.bytes, n) == 0;                                    \
+    }
+
+#define TYPED_TABLE_DECLARE(name, key_type)                                         \
+    struct name;                                                                    \
+    struct name *name##_init(unsigned long capacity, double max_load_factor);       \
+    int name##_insert(struct name *t, key_type key, int value);                     \
+    struct array *name##_lookup(const struct name *t, key_type key);                \
+    int name##_delete(struct name *t, key_type key);                                \
+    int name##_foreach(const struct name *t,                                        \
+                       int (*func)(void *ctx, key_type key, struct array *values),  \
+                       void *ctx);                                                  \
+    unsigned long name##_size(const struct name *t);                                \
+    double name##_load_factor(const struct name *t);                                \
+    void name##_cleanup(struct name *t);
+
+#define TYPED_TABLE_DEFINE(name, key_type, hash, equal)                             \
+    struct name##_slot {                                                            \
+        key_type key;                                                               \
+        /* Values of the key, NULL if the slot is empty */                          \
+        struct array *values;                                                       \
+        /* Distance from the slot the hash maps to */                               \
+        unsigned long dist;                                                         \
+    };                                                                              \
+                                                                                    \
+    struct name {                                                                   \
+        struct name##_slot *slots;                                                  \
+        double max_load_factor;                                                     \
+        /* Number of slots minus one, the number of slots is a power of two */      \
+        unsigned long mask;                                                         \
+        unsigned long load;                                                         \
+    };                                                                              \
+                                                                                    \
+    /* Place an entry that is not present yet, displacing entries that are */       \
+    /* closer to their home slot. There must be a free slot. */                     \
+    static void name##_place(struct name##_slot *slots, unsigned long mask,         \
+                             struct name##_slot entry) {                            \
+        unsigned long i = (unsigned long)hash(entry.key) & mask;                    \
+        entry.dist = 0;                                                             \
+        while (slots[i].values != NULL) {                                           \
+            if (slots[i].dist < entry.dist) {                                       \
+                struct name##_slot tmp = slots[i];                                  \
+                slots[i] = entry;                                                   \
+                entry = tmp;                                                        \
+            }                                                                       \
+            entry.dist++;                                                           \
+            i = (i + 1) & mask;                                                     \
+        }                                                                           \
+        slots[i] = entry;                                                           \
+    }                                                                               \
+                                                                                    \
+    /* Move all entries to a slot array of twice the size. */                       \
+    static int name##_grow(struct name *t) {                                        \
+        unsigned long mask = t->mask * 2 + 1;                                       \
+        struct name##_slot *slots = calloc(mask + 1, sizeof(struct name##_slot));   \
+        if (slots == NULL) {                                                        \
+            return 1;                                                               \
+        }                                                                           \
+        for (unsigned long i = 0; i <= t->mask; i++) {                              \
+            if (t->slots[i].values != NULL) {                                       \
+                name##_place(slots, mask, t->slots[i]);                             \
+            }                                                                       \
+        }                                                                           \
+        free(t->slots);                                                             \
+        t->slots = slots;                                                           \
+        t->mask = mask;                                                             \
+        return 0;                                                                   \
+    }                                                                               \
+                                                                                    \
+    /* Return the slot index of key, or mask + 1 if it is not present. */           \
+    static inline unsigned long name##_find(const struct name *t, key_type key) {   \
+        unsigned long i = (unsigned long)hash(key) & t->mask;                       \
+        for (unsigned long dist = 0;; dist++) {                                     \
+            const struct name##_slot *slot = &t->slots[i];                          \
+            /* A poorer entry would have taken this slot from us. */                \
+            if (slot->values == NULL || slot->dist < dist) {                        \
+                return t->mask + 1;                                                 \
+            }                                                                       \
+            if (equal(slot->key, key)) {                                            \
+                return i;                                                           \
+            }                                                                       \
+            i = (i + 1) & t->mask;                                                  \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    struct name *name##_init(unsigned long capacity, double max_load_factor) {      \
+        if (capacity == 0 || max_load_factor <= 0) {                                \
+            return NULL;                                                            \
+        }                                                                           \
+        struct name *t = malloc(sizeof(struct name));                               \
+        if (t == NULL) {                                                            \
+            return NULL;                                                            \
+        }                                                                           \
+        unsigned long slots = 2;                                                    \
+        while (slots < capacity) {                                                  \
+            slots *= 2;                                                             \
+        }                                                                           \
+        t->slots = calloc(slots, sizeof(struct name##_slot));                       \
+        if (t->slots == NULL) {                                                     \
+            free(t);                                                                \
+            return NULL;                                                            \
+        }                                                                           \
+        t->max_load_factor = max_load_factor < TYPED_MAX_LOAD                       \
+            ? max_load_factor : TYPED_MAX_LOAD;                                     \
+        t->mask = slots - 1;                                                        \
+        t->load = 0;                                                                \
+        return t;                                                                   \
+    }                                                                               \
+                                                                                    \
+    int name##_insert(struct name *t, key_type key, int value) {                    \
+        if (t == NULL) {                                                            \
+            return 1;                                                               \
+        }                                                                           \
+        unsigned long i = name##_find(t, key);                                      \
+        if (i <= t->mask) {                                                         \
+            return array_append(t->slots[i].values, value);                         \
+        }                                                                           \
+        while ((double)(t->load + 1) > t->max_load_factor * (double)(t->mask + 1)   \
+               || t->load + 1 > t->mask) {                                          \
+            if (name##_grow(t) != 0) {                                              \
+                return 1;                                                           \
+            }                                                                       \
+        }                                                                           \
+        struct name##_slot entry;                                                   \
+        entry.key = key;                                                            \
+        entry.values = array_init(1);                                               \
+        if (entry.values == NULL) {                                                 \
+            return 1;                                                               \
+        }                                                                           \
+        if (array_append(entry.values, value) != 0) {                               \
+            array_cleanup(entry.values);                                            \
+            return 1;                                                               \
+        }                                                                           \
+        name##_place(t->slots, t->mask, entry);                                     \
+        t->load++;                                                                  \
+        return 0;                                                                   \
+    }                                                                               \
+                                                                                    \
+    struct array *name##_lookup(const struct name *t, key_type key) {               \
+        if (t == NULL) {                                                            \
+            return NULL;                                                            \
+        }                                                                           \
+        unsigned long i = name##_find(t, key);                                      \
+        return i <= t->mask ? t->slots[i].values : NULL;                            \
+    }                                                                               \
+                                                                                    \
+    /* Removes a key with backward shift deletion, like robin_remove. */            \
+    int name##_delete(struct name *t, key_type key) {                               \
+        if (t == NULL) {                                                            \
+            return -1;                                                              \
+        }                                                                           \
+        unsigned long i = name##_find(t, key);                                      \
+        if (i > t->mask) {                                                          \
+            return 1;                                                               \
+        }                                                                           \
+        array_cleanup(t->slots[i].values);                                          \
+        unsigned long next = (i + 1) & t->mask;                                     \
+        while (t->slots[next].values != NULL && t->slots[next].dist > 0) {          \
+            t->slots[i] = t->slots[next];                                           \
+            t->slots[i].dist--;                                                     \
+            i = next;                                                               \
+            next = (next + 1) & t->mask;                                            \
+        }                                                                           \
+        t->slots[i].values = NULL;                                                  \
+        t->slots[i].dist = 0;                                                       \
+        t->load--;                                                                  \
+        return 0;                                                                   \
+    }                                                                               \
+                                                                                    \
+    int name##_foreach(const struct name *t,                                        \
+                       int (*func)(void *ctx, key_type key, struct array *values),  \
+                       void *ctx) {                                                 \
+        if (t == NULL) {                                                            \
+            return 1;                                                               \
+        }                                                                           \
+        for (unsigned long i = 0; i <= t->mask; i++) {                              \
+            if (t->slots[i].values != NULL) {                                       \
+                int res = func(ctx, t->slots[i].key, t->slots[i].values);           \
+                if (res != 0) {                                                     \
+                    return res;                                                     \
+                }                                                                   \
+            }                                                                       \
+        }                                                                           \
+        return 0;                                                                   \
+    }                                                                               \
+                                                                                    \
+    unsigned long name##_size(const struct name *t) {                               \
+        return t != NULL ? t->load : 0;                                             \
+    }                                                                               \
+                                                                                    \
+    double name##_load_factor(const struct name *t) {                               \
+        if (t == NULL) {                                                            \
+            return -1.0;                                                            \
+        }                                                                           \
+        return (double)t->load / (double)(t->mask + 1);                             \
+    }                                                                               \
+                                                                                    \
+    void name##_cleanup(struct name *t) {                                           \
+        if (t == NULL) {                                                            \
+            return;                                                                 \
+        }                                                                           \
+        for (unsigned long i = 0; i <= t->mask; i++) {                              \
+            if (t->slots[i].values != NULL) {                                       \
+                array_cleanup(t->slots[i].values);                                  \
+            }                                                                       \
+        }                                                                           \
+        free(t->slots);                                                             \
+        free(t);                                                                    \
+    }
+
+#endif /* TYPED_TABLE_H */
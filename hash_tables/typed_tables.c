@@ -0,0 +1,17 @@
+/* Name: Mats Vink
+ * UvAnetID: 15874648
+ * Program: BSc Informatics
+ *
+ * Description:
+ * This file instantiates the tables of typed_table.h that typed_tables.h
+ * declares. Each instance is compiled with its own hash and equality, which
+ * the compiler inlines into the probe loops.
+ */
+
+#include "typed_tables.h"
+
+TYPED_TABLE_DEFINE(u32_table, uint32_t, typed_hash_u32, typed_equal_int)
+
+TYPED_TABLE_DEFINE(u64_table, uint64_t, typed_hash_u64, typed_equal_int)
+
+TYPED_TABLE_DEFINE(key16_table, struct key16, key16_hash, key16_equal)
@@ -0,0 +1,25 @@
+#ifndef TYPED_TABLES_H
+#define TYPED_TABLES_H
+
+/* The tables of typed_table.h for the common key types: 32 and 64 bit
+ * integers such as numeric ids, and 16 byte keys such as UUIDs or MD5
+ * digests. Other key types get a table of their own with the macros of
+ * typed_table.h. */
+
+#include <stdint.h>
+
+#include "typed_table.h"
+
+/* A key of 16 bytes, compared with memcmp. */
+TYPED_BYTES_KEY(key16, 16)
+
+/* struct u32_table with u32_table_init, u32_table_insert and so on. */
+TYPED_TABLE_DECLARE(u32_table, uint32_t)
+
+/* struct u64_table with u64_table_init, u64_table_insert and so on. */
+TYPED_TABLE_DECLARE(u64_table, uint64_t)
+
+/* struct key16_table with key16_table_init, key16_table_insert and so on. */
+TYPED_TABLE_DECLARE(key16_table, struct key16)
+
+#endif /* TYPED_TABLES_H */